@@ -0,0 +1,359 @@
+#include <glad/glad.h>
+#include <mesche.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "atlas.h"
+#include "log.h"
+#include "render_state.h"
+#include "texture.h"
+
+#define ATLAS_DEFAULT_PAGE_SIZE 2048
+
+SubstAtlas *subst_atlas_create(uint32_t page_size,
+                               SubstTextureOptions *options) {
+  SubstAtlas *atlas = malloc(sizeof(SubstAtlas));
+  atlas->page_size = page_size;
+  atlas->use_smoothing = options == NULL || options->use_smoothing;
+  atlas->page_count = 0;
+  atlas->pages = NULL;
+
+  // Filtered sampling reads neighboring texels so keep packed images apart
+  atlas->padding = atlas->use_smoothing ? 2 : 1;
+
+  return atlas;
+}
+
+static void atlas_page_texture_release(SubstAtlasPageTexture *page_texture) {
+  page_texture->ref_count--;
+  if (page_texture->ref_count == 0) {
+    subst_render_state_texture_forget(page_texture->texture_id);
+    glDeleteTextures(1, &page_texture->texture_id);
+    free(page_texture);
+  }
+}
+
+void subst_atlas_free(SubstAtlas *atlas) {
+  for (uint32_t i = 0; i < atlas->page_count; i++) {
+    atlas_page_texture_release(atlas->pages[i].page_texture);
+    free(atlas->pages[i].nodes);
+  }
+
+  free(atlas->pages);
+  free(atlas);
+}
+
+static SubstAtlasPage *atlas_page_add(SubstAtlas *atlas) {
+  atlas->pages =
+      realloc(atlas->pages, sizeof(SubstAtlasPage) * (atlas->page_count + 1));
+
+  SubstAtlasPage *page = &atlas->pages[atlas->page_count];
+  atlas->page_count++;
+
+  // The skyline starts as a single flat segment across the whole page
+  page->node_capacity = 16;
+  page->node_count = 1;
+  page->nodes = malloc(sizeof(SubstAtlasNode) * page->node_capacity);
+  page->nodes[0].x = 0;
+  page->nodes[0].y = 0;
+  page->nodes[0].width = atlas->page_size;
+
+  // Clear the page so that padding between images is transparent
+  unsigned char *clear_bytes = calloc(atlas->page_size * atlas->page_size, 4);
+
+  // The atlas holds the first reference until it is freed
+  page->page_texture = malloc(sizeof(SubstAtlasPageTexture));
+  page->page_texture->ref_count = 1;
+  glGenTextures(1, &page->page_texture->texture_id);
+  subst_render_state_texture_bind(0, page->page_texture->texture_id);
+  if (atlas->use_smoothing) {
+    // Mipmaps would bleed neighboring images together so they are skipped
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  } else {
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  }
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, atlas->page_size, atlas->page_size,
+               0, GL_RGBA, GL_UNSIGNED_BYTE, clear_bytes);
+
+  free(clear_bytes);
+
+  return page;
+}
+
+static bool atlas_page_fit(SubstAtlasPage *page, uint32_t page_size,
+                           uint32_t index, uint32_t width, uint32_t height,
+                           uint32_t *fit_y) {
+  uint32_t x = page->nodes[index].x;
+  uint32_t y = 0;
+  uint32_t remaining = width;
+
+  if (x + width > page_size) {
+    return false;
+  }
+
+  // The rect has to sit on top of the highest segment that it spans
+  for (uint32_t i = index; remaining > 0; i++) {
+    SubstAtlasNode *node = &page->nodes[i];
+    if (node->y > y) {
+      y = node->y;
+    }
+
+    if (y + height > page_size) {
+      return false;
+    }
+
+    remaining -= node->width < remaining ? node->width : remaining;
+  }
+
+  *fit_y = y;
+  return true;
+}
+
+static void atlas_page_node_remove(SubstAtlasPage *page, uint32_t index) {
+  memmove(&page->nodes[index], &page->nodes[index + 1],
+          sizeof(SubstAtlasNode) * (page->node_count - index - 1));
+  page->node_count--;
+}
+
+static void atlas_page_node_insert(SubstAtlasPage *page, uint32_t index,
+                                   uint32_t x, uint32_t y, uint32_t width) {
+  if (page->node_count == page->node_capacity) {
+    page->node_capacity *= 2;
+    page->nodes =
+        realloc(page->nodes, sizeof(SubstAtlasNode) * page->node_capacity);
+  }
+
+  memmove(&page->nodes[index + 1], &page->nodes[index],
+          sizeof(SubstAtlasNode) * (page->node_count - index));
+  page->nodes[index].x = x;
+  page->nodes[index].y = y;
+  page->nodes[index].width = width;
+  page->node_count++;
+
+  // Trim or remove the segments that are now covered by the new one
+  for (uint32_t i = index + 1; i < page->node_count;) {
+    SubstAtlasNode *previous = &page->nodes[i - 1];
+    SubstAtlasNode *node = &page->nodes[i];
+    uint32_t previous_end = previous->x + previous->width;
+
+    if (node->x >= previous_end) {
+      break;
+    }
+
+    uint32_t overlap = previous_end - node->x;
+    if (node->width <= overlap) {
+      atlas_page_node_remove(page, i);
+    } else {
+      node->x += overlap;
+      node->width -= overlap;
+      break;
+    }
+  }
+
+  // Merge neighboring segments at the same height
+  for (uint32_t i = 0; i + 1 < page->node_count;) {
+    if (page->nodes[i].y == page->nodes[i + 1].y) {
+      page->nodes[i].width += page->nodes[i + 1].width;
+      atlas_page_node_remove(page, i + 1);
+    } else {
+      i++;
+    }
+  }
+}
+
+static bool atlas_page_pack(SubstAtlasPage *page, uint32_t page_size,
+                            uint32_t width, uint32_t height, uint32_t *out_x,
+                            uint32_t *out_y) {
+  int best_index = -1;
+  uint32_t best_top = UINT32_MAX;
+  uint32_t best_width = UINT32_MAX;
+  uint32_t best_y = 0;
+
+  // Find the bottom-left-most position, preferring narrower segments to
+  // break ties so that wide gaps are saved for wide images
+  for (uint32_t i = 0; i < page->node_count; i++) {
+    uint32_t y;
+    if (atlas_page_fit(page, page_size, i, width, height, &y)) {
+      uint32_t top = y + height;
+      if (top < best_top ||
+          (top == best_top && page->nodes[i].width < best_width)) {
+        best_index = i;
+        best_top = top;
+        best_width = page->nodes[i].width;
+        best_y = y;
+      }
+    }
+  }
+
+  if (best_index == -1) {
+    return false;
+  }
+
+  *out_x = page->nodes[best_index].x;
+  *out_y = best_y;
+  atlas_page_node_insert(page, best_index, *out_x, best_top, width);
+
+  return true;
+}
+
+static SubstTexture *atlas_texture_make(SubstAtlasPageTexture *page_texture,
+                                        uint32_t width, uint32_t height,
+                                        uint32_t x, uint32_t y,
+                                        uint32_t page_width,
+                                        uint32_t page_height) {
+  SubstAtlasTexture *atlas_texture = malloc(sizeof(SubstAtlasTexture));
+  atlas_texture->page_texture = page_texture;
+  page_texture->ref_count++;
+
+  SubstTexture *texture = &atlas_texture->texture;
+  texture->width = width;
+  texture->height = height;
+  texture->texture_id = page_texture->texture_id;
+  texture->region_x = x;
+  texture->region_y = y;
+  texture->page_width = page_width;
+  texture->page_height = page_height;
+
+  return texture;
+}
+
+void subst_atlas_texture_free(SubstTexture *texture) {
+  SubstAtlasTexture *atlas_texture = (SubstAtlasTexture *)texture;
+  atlas_page_texture_release(atlas_texture->page_texture);
+  free(atlas_texture);
+}
+
+SubstTexture *subst_atlas_image_add(SubstAtlas *atlas,
+                                    const unsigned char *image_data,
+                                    uint32_t width, uint32_t height) {
+  SubstAtlasPage *page = NULL;
+  uint32_t x = 0, y = 0;
+  uint32_t packed_width = width + atlas->padding;
+  uint32_t packed_height = height + atlas->padding;
+
+  // Images that can never fit on a page get their own texture
+  if (packed_width > atlas->page_size || packed_height > atlas->page_size) {
+    subst_log("Image of size %dx%d is too large for atlas pages of size %d\n",
+              width, height, atlas->page_size);
+
+    // The texture is the only owner of its GL texture so that it is deleted
+    // along with it like any other atlas texture
+    SubstTextureOptions options = {.use_smoothing = atlas->use_smoothing};
+    SubstTexture *single =
+        subst_texture_create(image_data, width, height, &options);
+    SubstAtlasPageTexture *page_texture =
+        malloc(sizeof(SubstAtlasPageTexture));
+    page_texture->texture_id = single->texture_id;
+    page_texture->ref_count = 0;
+
+    SubstTexture *texture =
+        atlas_texture_make(page_texture, width, height, 0, 0, width, height);
+    free(single);
+
+    return texture;
+  }
+
+  // Try the existing pages before starting a new one
+  for (uint32_t i = 0; i < atlas->page_count; i++) {
+    if (atlas_page_pack(&atlas->pages[i], atlas->page_size, packed_width,
+                        packed_height, &x, &y)) {
+      page = &atlas->pages[i];
+      break;
+    }
+  }
+
+  if (page == NULL) {
+    page = atlas_page_add(atlas);
+    atlas_page_pack(page, atlas->page_size, packed_width, packed_height, &x,
+                    &y);
+  }
+
+  // Copy the image into its spot on the page
+  subst_render_state_texture_bind(0, page->page_texture->texture_id);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, GL_RGBA,
+                  GL_UNSIGNED_BYTE, image_data);
+  subst_render_state_texture_bind(0, 0);
+
+  // Hand back a lightweight texture that refers to the page region
+  return atlas_texture_make(page->page_texture, width, height, x, y,
+                            atlas->page_size, atlas->page_size);
+}
+
+SubstTexture *subst_atlas_png_load(SubstAtlas *atlas, char *file_path) {
+  uint32_t width, height;
+  unsigned char *image_bytes = NULL;
+  SubstTexture *texture = NULL;
+
+  image_bytes = subst_texture_png_decode(file_path, &width, &height);
+  texture = subst_atlas_image_add(atlas, image_bytes, width, height);
+  free(image_bytes);
+
+  return texture;
+}
+
+void atlas_free_func(MescheMemory *mem, void *obj) {
+  subst_atlas_free((SubstAtlas *)obj);
+}
+
+const ObjectPointerType SubstAtlasType = {.name = "texture-atlas",
+                                          .free_func = atlas_free_func};
+
+void atlas_texture_free_func(MescheMemory *mem, void *obj) {
+  subst_atlas_texture_free((SubstTexture *)obj);
+}
+
+const ObjectPointerType SubstAtlasTextureType = {
+    .name = "atlas-texture", .free_func = atlas_texture_free_func};
+
+Value subst_atlas_create_msc(VM *vm, int arg_count, Value *args) {
+  if (arg_count != 2) {
+    subst_log("Function requires 2 parameters.");
+  }
+
+  uint32_t page_size = ATLAS_DEFAULT_PAGE_SIZE;
+  if (IS_NUMBER(args[0])) {
+    page_size = AS_NUMBER(args[0]);
+  }
+
+  SubstTextureOptions options = {.use_smoothing = !IS_FALSE(args[1])};
+  SubstAtlas *atlas = subst_atlas_create(page_size, &options);
+
+  return OBJECT_VAL(
+      mesche_object_make_pointer_type(vm, atlas, &SubstAtlasType));
+}
+
+Value subst_atlas_texture_load_msc(VM *vm, int arg_count, Value *args) {
+  if (arg_count != 2) {
+    subst_log("Function requires 2 parameters.");
+  }
+
+  SubstAtlas *atlas = (SubstAtlas *)AS_POINTER(args[0])->ptr;
+  ObjectString *file_path = AS_STRING(args[1]);
+  SubstTexture *texture = subst_atlas_png_load(atlas, file_path->chars);
+
+  return OBJECT_VAL(
+      mesche_object_make_pointer_type(vm, texture, &SubstAtlasTextureType));
+}
+
+Value subst_atlas_page_count_msc(VM *vm, int arg_count, Value *args) {
+  if (arg_count != 1) {
+    subst_log("Function requires 1 parameter.");
+  }
+
+  SubstAtlas *atlas = (SubstAtlas *)AS_POINTER(args[0])->ptr;
+  return NUMBER_VAL(atlas->page_count);
+}
+
+void subst_atlas_module_init(VM *vm) {
+  mesche_vm_define_native_funcs(
+      vm, "substratic texture",
+      (MescheNativeFuncDetails[]){
+          {"atlas-create-internal", subst_atlas_create_msc, true},
+          {"atlas-texture-load", subst_atlas_texture_load_msc, true},
+          {"atlas-page-count", subst_atlas_page_count_msc, true},
+          {NULL, NULL, false}});
+}
@@ -0,0 +1,59 @@
+#ifndef __subst_atlas_h
+#define __subst_atlas_h
+
+#include <glad/glad.h>
+#include <inttypes.h>
+#include <mesche.h>
+
+#include "texture.h"
+
+// A horizontal segment of the skyline, the top edge of everything that has
+// been packed below it
+typedef struct {
+  uint32_t x, y;
+  uint32_t width;
+} SubstAtlasNode;
+
+// The GL texture behind a page.  It is shared by the atlas and every texture
+// packed onto the page, and is deleted once the last of them is freed.
+typedef struct {
+  GLuint texture_id;
+  uint32_t ref_count;
+} SubstAtlasPageTexture;
+
+typedef struct {
+  SubstAtlasPageTexture *page_texture;
+  uint32_t node_count;
+  uint32_t node_capacity;
+  SubstAtlasNode *nodes;
+} SubstAtlasPage;
+
+typedef struct {
+  uint32_t page_size;
+  uint32_t padding;
+  bool use_smoothing;
+  uint32_t page_count;
+  SubstAtlasPage *pages;
+} SubstAtlas;
+
+// A texture packed onto an atlas page.  The texture comes first so that it
+// can be used anywhere that a SubstTexture is expected.
+typedef struct {
+  SubstTexture texture;
+  SubstAtlasPageTexture *page_texture;
+} SubstAtlasTexture;
+
+SubstAtlas *subst_atlas_create(uint32_t page_size,
+                               SubstTextureOptions *options);
+// Textures loaded from the atlas keep their pages alive after it is freed
+void subst_atlas_free(SubstAtlas *atlas);
+
+SubstTexture *subst_atlas_image_add(SubstAtlas *atlas,
+                                    const unsigned char *image_data,
+                                    uint32_t width, uint32_t height);
+SubstTexture *subst_atlas_png_load(SubstAtlas *atlas, char *file_path);
+void subst_atlas_texture_free(SubstTexture *texture);
+
+void subst_atlas_module_init(VM *vm);
+
+#endif
@@ -0,0 +1,180 @@
+#include <cglm/cglm.h>
+#include <glad/glad.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "batch.h"
+#include "render_state.h"
+#include "shader.h"
+#include "util.h"
+
+SubstBatch *subst_batch_create(void) {
+  SubstBatch *batch = malloc(sizeof(SubstBatch));
+  memset(batch, 0, sizeof(SubstBatch));
+
+  batch->vertices =
+      malloc(sizeof(SubstBatchVertex) * 4 * SUBST_BATCH_MAX_QUADS);
+  if (batch->vertices == NULL) {
+    PANIC("Could not allocate sprite batch vertex storage!\n");
+  }
+
+  batch->matrix_version = 1;
+  glm_mat4_identity(batch->projection_matrix);
+  glm_mat4_identity(batch->view_matrix);
+
+  // Compile the default shader used when a draw doesn't specify one
+  const SubstShaderFile shader_files[] = {
+      {GL_VERTEX_SHADER, TexturedVertexShaderText},
+      {GL_FRAGMENT_SHADER, TexturedFragmentShaderText},
+  };
+  batch->default_shader = subst_shader_compile(shader_files, 2);
+
+  // Create a 1x1 white texture so that untextured quads can share the batch
+  const unsigned char white_pixel[] = {255, 255, 255, 255};
+  glGenTextures(1, &batch->white_texture_id);
+  subst_render_state_texture_bind(0, batch->white_texture_id);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+               white_pixel);
+
+  // The index pattern is the same for every quad so it only gets built once
+  unsigned int *indices =
+      malloc(sizeof(unsigned int) * 6 * SUBST_BATCH_MAX_QUADS);
+  for (unsigned int i = 0; i < SUBST_BATCH_MAX_QUADS; i++) {
+    indices[i * 6 + 0] = i * 4 + 0;
+    indices[i * 6 + 1] = i * 4 + 1;
+    indices[i * 6 + 2] = i * 4 + 2;
+    indices[i * 6 + 3] = i * 4 + 2;
+    indices[i * 6 + 4] = i * 4 + 3;
+    indices[i * 6 + 5] = i * 4 + 0;
+  }
+
+  glGenVertexArrays(1, &batch->vertex_array);
+  glGenBuffers(1, &batch->vertex_buffer);
+  glGenBuffers(1, &batch->element_buffer);
+
+  subst_render_state_vertex_array_bind(batch->vertex_array);
+
+  glBindBuffer(GL_ARRAY_BUFFER, batch->vertex_buffer);
+  glBufferData(GL_ARRAY_BUFFER,
+               sizeof(SubstBatchVertex) * 4 * SUBST_BATCH_MAX_QUADS, NULL,
+               GL_STREAM_DRAW);
+
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, batch->element_buffer);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+               sizeof(unsigned int) * 6 * SUBST_BATCH_MAX_QUADS, indices,
+               GL_STATIC_DRAW);
+
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(SubstBatchVertex),
+                        (const void *)offsetof(SubstBatchVertex, x));
+
+  glEnableVertexAttribArray(1);
+  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(SubstBatchVertex),
+                        (const void *)offsetof(SubstBatchVertex, u));
+
+  glEnableVertexAttribArray(2);
+  glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(SubstBatchVertex),
+                        (const void *)offsetof(SubstBatchVertex, r));
+
+  free(indices);
+
+  return batch;
+}
+
+void subst_batch_free(SubstBatch *batch) {
+  glDeleteBuffers(1, &batch->vertex_buffer);
+  glDeleteBuffers(1, &batch->element_buffer);
+  glDeleteVertexArrays(1, &batch->vertex_array);
+  subst_render_state_texture_forget(batch->white_texture_id);
+  glDeleteTextures(1, &batch->white_texture_id);
+  subst_shader_free(batch->default_shader);
+  free(batch->vertices);
+  free(batch);
+}
+
+void subst_batch_matrices_set(SubstBatch *batch, mat4 projection, mat4 view) {
+  // Nothing needs to be re-uploaded if the matrices didn't actually change
+  if (memcmp(projection, batch->projection_matrix, sizeof(mat4)) == 0 &&
+      memcmp(view, batch->view_matrix, sizeof(mat4)) == 0) {
+    return;
+  }
+
+  // Queued quads were submitted against the previous matrices
+  subst_batch_flush(batch);
+
+  glm_mat4_copy(projection, batch->projection_matrix);
+  glm_mat4_copy(view, batch->view_matrix);
+  batch->matrix_version++;
+}
+
+void subst_batch_quad_add(SubstBatch *batch, SubstShader *shader,
+                          GLuint texture_id, const SubstBatchVertex *quad) {
+  if (shader == NULL) {
+    shader = batch->default_shader;
+  }
+
+  if (texture_id == 0) {
+    texture_id = batch->white_texture_id;
+  }
+
+  // Start a new run if the draw state changes or the buffer is full
+  if (batch->quad_count > 0 &&
+      (batch->shader != shader ||
+       batch->texture_id != texture_id ||
+       batch->quad_count == SUBST_BATCH_MAX_QUADS)) {
+    subst_batch_flush(batch);
+  }
+
+  batch->shader = shader;
+  batch->texture_id = texture_id;
+
+  memcpy(&batch->vertices[batch->quad_count * 4], quad,
+         sizeof(SubstBatchVertex) * 4);
+  batch->quad_count++;
+  batch->stats.sprites_submitted++;
+}
+
+void subst_batch_flush(SubstBatch *batch) {
+  if (batch->quad_count == 0) {
+    return;
+  }
+
+  SubstShader *shader = batch->shader;
+  subst_render_state_program_use(shader->program);
+  subst_render_state_vertex_array_bind(batch->vertex_array);
+
+  // Orphan the previous buffer storage so that we don't wait on the GPU to
+  // finish reading it before uploading the new vertices
+  glBindBuffer(GL_ARRAY_BUFFER, batch->vertex_buffer);
+  glBufferData(GL_ARRAY_BUFFER,
+               sizeof(SubstBatchVertex) * 4 * SUBST_BATCH_MAX_QUADS, NULL,
+               GL_STREAM_DRAW);
+  glBufferSubData(GL_ARRAY_BUFFER, 0,
+                  sizeof(SubstBatchVertex) * 4 * batch->quad_count,
+                  batch->vertices);
+
+  // Model transforms are already baked into the vertices and the model
+  // uniform is left as identity, so only the matrices may need an update
+  subst_shader_matrices_apply(shader, batch->projection_matrix,
+                              batch->view_matrix, batch->matrix_version);
+  subst_render_state_texture_bind(0, batch->texture_id);
+
+  // Draw every queued quad at once
+  glDrawElements(GL_TRIANGLES, 6 * batch->quad_count, GL_UNSIGNED_INT, 0);
+
+  batch->stats.draws_issued++;
+  batch->quad_count = 0;
+}
+
+void subst_batch_frame_end(SubstBatch *batch) {
+  subst_batch_flush(batch);
+
+  // Keep the finished frame's numbers around for reporting
+  batch->last_frame_stats = batch->stats;
+  batch->stats.sprites_submitted = 0;
+  batch->stats.sprites_culled = 0;
+  batch->stats.draws_issued = 0;
+}
@@ -0,0 +1,56 @@
+#ifndef __subst_batch_h
+#define __subst_batch_h
+
+#include <cglm/cglm.h>
+#include <glad/glad.h>
+#include <inttypes.h>
+
+#include "shader.h"
+
+#define SUBST_BATCH_MAX_QUADS 2048
+
+typedef struct {
+  float x, y;
+  float u, v;
+  float r, g, b, a;
+} SubstBatchVertex;
+
+typedef struct {
+  uint32_t sprites_submitted;
+  uint32_t sprites_culled;
+  uint32_t draws_issued;
+} SubstBatchStats;
+
+typedef struct {
+  GLuint vertex_array;
+  GLuint vertex_buffer;
+  GLuint element_buffer;
+  SubstShader *default_shader;
+  GLuint white_texture_id;
+
+  // The shader and texture of the quads currently queued
+  SubstShader *shader;
+  GLuint texture_id;
+
+  // Bumped every time the matrices change so shaders know to re-upload
+  uint32_t matrix_version;
+  mat4 projection_matrix;
+  mat4 view_matrix;
+
+  uint32_t quad_count;
+  SubstBatchVertex *vertices;
+
+  SubstBatchStats stats;
+  SubstBatchStats last_frame_stats;
+} SubstBatch;
+
+SubstBatch *subst_batch_create(void);
+void subst_batch_free(SubstBatch *batch);
+
+void subst_batch_matrices_set(SubstBatch *batch, mat4 projection, mat4 view);
+void subst_batch_quad_add(SubstBatch *batch, SubstShader *shader,
+                          GLuint texture_id, const SubstBatchVertex *quad);
+void subst_batch_flush(SubstBatch *batch);
+void subst_batch_frame_end(SubstBatch *batch);
+
+#endif
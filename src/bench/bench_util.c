@@ -0,0 +1,54 @@
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "bench_util.h"
+
+static atomic_size_t bench_allocation_count;
+static atomic_size_t bench_allocation_bytes;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void *__real_aligned_alloc(size_t alignment, size_t size);
+
+static inline void bench_allocation_add(size_t size) {
+  atomic_fetch_add(&bench_allocation_count, 1);
+  atomic_fetch_add(&bench_allocation_bytes, size);
+}
+
+void *__wrap_malloc(size_t size) {
+  bench_allocation_add(size);
+  return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+  bench_allocation_add(count * size);
+  return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+  bench_allocation_add(size);
+  return __real_realloc(ptr, size);
+}
+
+void *__wrap_aligned_alloc(size_t alignment, size_t size) {
+  bench_allocation_add(size);
+  return __real_aligned_alloc(alignment, size);
+}
+
+void bench_allocations_reset(void) {
+  atomic_store(&bench_allocation_count, 0);
+  atomic_store(&bench_allocation_bytes, 0);
+}
+
+void bench_allocations_get(size_t *count, size_t *bytes) {
+  *count = atomic_load(&bench_allocation_count);
+  *bytes = atomic_load(&bench_allocation_bytes);
+}
+
+double bench_time_ns(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1e9 + now.tv_nsec;
+}
@@ -0,0 +1,14 @@
+#ifndef __subst_bench_util_h
+#define __subst_bench_util_h
+
+#include <stddef.h>
+
+// Benchmarks that use these are linked with --wrap for the allocation
+// functions so that every allocation made by the engine is counted
+void bench_allocations_reset(void);
+void bench_allocations_get(size_t *count, size_t *bytes);
+
+// A monotonic clock reading in nanoseconds
+double bench_time_ns(void);
+
+#endif
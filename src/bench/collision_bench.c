@@ -0,0 +1,209 @@
+// Measures how fast a collision world finds contacts while its colliders
+// move around, over a fixed number of frames.  The narrowphase is also timed
+// on its own so that pair testing can be reported per pair.  Each scenario
+// prints one line of JSON to stdout so that runs can be compared by scripts.
+//
+// Allocations made by the engine during the timed frames are counted through
+// the allocator wrappers in bench_util.c.
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../collision.h"
+#include "../random.h"
+#include "bench_util.h"
+
+typedef struct {
+  const char *name;
+  int collider_count;
+  float box_ratio;
+  float min_size;
+  float max_size;
+  float area_size;
+  float cell_size;
+} BenchScenario;
+
+typedef struct {
+  int frame_count;
+  float time_delta;
+  uint64_t seed;
+} BenchOptions;
+
+static const BenchScenario bench_default_scenarios[] = {
+    {"spheres", 10000, 0.f, 4.f, 12.f, 2000.f, 32.f},
+    {"mixed", 10000, 0.3f, 4.f, 16.f, 2000.f, 32.f},
+    {"boxes", 10000, 1.f, 4.f, 16.f, 2000.f, 32.f},
+    {"dense", 20000, 0.3f, 4.f, 12.f, 1000.f, 32.f},
+};
+
+typedef struct {
+  uint32_t id;
+  bool is_box;
+  float x, y;
+  float vel_x, vel_y;
+} BenchCollider;
+
+static void bench_scenario_run(const BenchScenario *scenario,
+                               const BenchOptions *options) {
+  SubstRandom random;
+  subst_random_seed(&random, options->seed);
+
+  SubstCollisionWorld *world =
+      subst_collision_world_create(scenario->cell_size);
+  BenchCollider *colliders =
+      malloc(sizeof(BenchCollider) * scenario->collider_count);
+  for (int i = 0; i < scenario->collider_count; i++) {
+    BenchCollider *collider = &colliders[i];
+    float size =
+        subst_random_range(&random, scenario->min_size, scenario->max_size);
+    collider->x = subst_random_range(&random, 0, scenario->area_size);
+    collider->y = subst_random_range(&random, 0, scenario->area_size);
+    collider->vel_x = subst_random_range(&random, -60.f, 60.f);
+    collider->vel_y = subst_random_range(&random, -60.f, 60.f);
+    collider->is_box =
+        subst_random_range(&random, 0.f, 1.f) < scenario->box_ratio;
+    collider->id =
+        collider->is_box
+            ? subst_collision_world_box_add(world, collider->x, collider->y,
+                                            size * 2.f, size * 1.5f)
+            : subst_collision_world_add(world, collider->x, collider->y,
+                                        size);
+  }
+
+  // One untimed frame so that the candidate and contact buffers are sized
+  subst_collision_world_pairs_find(world);
+
+  double move_ns = 0, find_ns = 0, narrowphase_ns = 0;
+  uint64_t candidate_count = 0, contact_count = 0;
+  bench_allocations_reset();
+
+  for (int frame = 0; frame < options->frame_count; frame++) {
+    // Drift every collider and bounce it off the edges of the area
+    double start = bench_time_ns();
+    for (int i = 0; i < scenario->collider_count; i++) {
+      BenchCollider *collider = &colliders[i];
+      collider->x += collider->vel_x * options->time_delta;
+      collider->y += collider->vel_y * options->time_delta;
+      if (collider->x < 0 || collider->x > scenario->area_size) {
+        collider->vel_x = -collider->vel_x;
+      }
+      if (collider->y < 0 || collider->y > scenario->area_size) {
+        collider->vel_y = -collider->vel_y;
+      }
+
+      subst_collision_world_move(world, collider->id, collider->x,
+                                 collider->y);
+    }
+    move_ns += bench_time_ns() - start;
+
+    start = bench_time_ns();
+    contact_count += subst_collision_world_pairs_find(world);
+    find_ns += bench_time_ns() - start;
+
+    // Run the narrowphase again over the same candidates to time it alone
+    start = bench_time_ns();
+    world->contacts.count = 0;
+    subst_narrowphase_spheres(&world->sphere_candidates, &world->contacts);
+    subst_narrowphase_sphere_boxes(&world->sphere_box_candidates,
+                                   &world->contacts);
+    subst_narrowphase_boxes(&world->box_candidates, &world->contacts);
+    narrowphase_ns += bench_time_ns() - start;
+
+    candidate_count += world->sphere_candidates.count +
+                       world->sphere_box_candidates.count +
+                       world->box_candidates.count;
+  }
+
+  size_t allocation_count, allocation_bytes;
+  bench_allocations_get(&allocation_count, &allocation_bytes);
+
+  printf("{\"scenario\": \"%s\", \"colliders\": %d, \"box_ratio\": %g, "
+         "\"frames\": %d, \"candidates_per_frame\": %.1f, "
+         "\"contacts_per_frame\": %.1f, \"move_ms_per_frame\": %.4f, "
+         "\"pairs_find_ms_per_frame\": %.4f, "
+         "\"narrowphase_ns_per_pair\": %.3f, \"allocations\": %zu, "
+         "\"allocated_bytes\": %zu}\n",
+         scenario->name, scenario->collider_count, scenario->box_ratio,
+         options->frame_count,
+         (double)candidate_count / options->frame_count,
+         (double)contact_count / options->frame_count,
+         move_ns / 1e6 / options->frame_count,
+         find_ns / 1e6 / options->frame_count,
+         candidate_count > 0 ? narrowphase_ns / candidate_count : 0,
+         allocation_count, allocation_bytes);
+  fflush(stdout);
+
+  subst_collision_world_free(world);
+  free(colliders);
+}
+
+static void bench_usage(const char *program) {
+  fprintf(stderr,
+          "Usage: %s [options]\n"
+          "  --frames N          Timed frames per scenario (default 600)\n"
+          "  --dt SECONDS        Time step per frame (default 1/60)\n"
+          "  --seed N            Seed for placing the colliders\n"
+          "Any of these replaces the default suite with a single scenario:\n"
+          "  --colliders N --box-ratio FRACTION --min-size N --max-size N\n"
+          "  --area N --cell-size N\n",
+          program);
+}
+
+int main(int argc, char **argv) {
+  BenchOptions options = {
+      .frame_count = 600, .time_delta = 1.f / 60.f, .seed = 1};
+  BenchScenario custom = {"custom", 10000, 0.3f, 4.f, 16.f, 2000.f, 32.f};
+  bool use_custom = false;
+
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+
+    if (value == NULL) {
+      bench_usage(argv[0]);
+      return 1;
+    } else if (strcmp(arg, "--frames") == 0) {
+      options.frame_count = atoi(value), i++;
+    } else if (strcmp(arg, "--dt") == 0) {
+      options.time_delta = atof(value), i++;
+    } else if (strcmp(arg, "--seed") == 0) {
+      options.seed = strtoull(value, NULL, 10), i++;
+    } else if (strcmp(arg, "--colliders") == 0) {
+      custom.collider_count = atoi(value), use_custom = true, i++;
+    } else if (strcmp(arg, "--box-ratio") == 0) {
+      custom.box_ratio = atof(value), use_custom = true, i++;
+    } else if (strcmp(arg, "--min-size") == 0) {
+      custom.min_size = atof(value), use_custom = true, i++;
+    } else if (strcmp(arg, "--max-size") == 0) {
+      custom.max_size = atof(value), use_custom = true, i++;
+    } else if (strcmp(arg, "--area") == 0) {
+      custom.area_size = atof(value), use_custom = true, i++;
+    } else if (strcmp(arg, "--cell-size") == 0) {
+      custom.cell_size = atof(value), use_custom = true, i++;
+    } else {
+      bench_usage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (options.frame_count <= 0 || options.time_delta <= 0 ||
+      custom.collider_count <= 0) {
+    bench_usage(argv[0]);
+    return 1;
+  }
+
+  if (use_custom) {
+    bench_scenario_run(&custom, &options);
+  } else {
+    for (size_t i = 0; i < sizeof(bench_default_scenarios) /
+                               sizeof(bench_default_scenarios[0]);
+         i++) {
+      bench_scenario_run(&bench_default_scenarios[i], &options);
+    }
+  }
+
+  return 0;
+}
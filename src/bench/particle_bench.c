@@ -0,0 +1,291 @@
+// Measures how fast particle systems update, and optionally render into a
+// headless window, over a fixed number of frames.  Each scenario prints one
+// line of JSON to stdout so that runs can be compared by scripts.
+//
+// Allocations made by the engine during the timed frames are counted through
+// the allocator wrappers in bench_util.c.
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../particle.h"
+#include "../renderer.h"
+#include "../window.h"
+#include "bench_util.h"
+
+#define BENCH_SCREEN_WIDTH 1280
+#define BENCH_SCREEN_HEIGHT 720
+
+typedef struct {
+  const char *name;
+  int system_count;
+  int source_count;
+  int max_particles;
+  float interval;
+  float lifetime;
+  bool use_forces;
+} BenchScenario;
+
+typedef struct {
+  int frame_count;
+  float time_delta;
+  bool is_parallel;
+  bool use_render;
+  uint64_t seed;
+} BenchOptions;
+
+static const BenchScenario bench_default_scenarios[] = {
+    {"single-source", 1, 1, 10000, 0.0001f, 1.f, false},
+    {"many-systems", 256, 2, 256, 0.01f, 2.f, false},
+    {"large-source", 1, 1, 200000, 0.00001f, 2.f, false},
+    {"forces", 1, 1, 10000, 0.0001f, 1.f, true},
+};
+
+static SubstParticleSystem *bench_system_create(const BenchScenario *scenario,
+                                                uint64_t seed, int index) {
+  SubstParticleSourceConfig *configs =
+      calloc(scenario->source_count, sizeof(SubstParticleSourceConfig));
+
+  for (int i = 0; i < scenario->source_count; i++) {
+    SubstParticleSourceConfig *config = &configs[i];
+    config->max_particles = scenario->max_particles;
+    config->geometry = 8.f;
+    config->size = (SubstParticleFactor){2.f, 4.f};
+    config->interval = (SubstParticleFactor){scenario->interval * 0.5f,
+                                             scenario->interval * 1.5f};
+    config->lifetime = (SubstParticleFactor){scenario->lifetime * 0.75f,
+                                             scenario->lifetime};
+    config->vel_x = (SubstParticleFactor){-40.f, 40.f};
+    config->vel_y = (SubstParticleFactor){-80.f, -20.f};
+    config->color = (SubstColor){1.f, 0.7f, 0.25f, 1.f};
+    config->end_color = (SubstColor){1.f, 0.2f, 0.1f, 1.f};
+    config->color_curve = (SubstParticleCurve){
+        .start = 0.f, .end = 1.f, .ease = glm_ease_linear};
+    config->size_curve = (SubstParticleCurve){
+        .start = 1.f, .end = 0.25f, .ease = glm_ease_quad_in};
+    config->alpha_curve = (SubstParticleCurve){
+        .start = 1.f, .end = 0.f, .ease = glm_ease_linear};
+  }
+
+  SubstParticleSystem *system =
+      subst_particle_system_create(configs, scenario->source_count);
+  subst_particle_system_seed(system, seed + index);
+  free(configs);
+
+  // Spread the systems over the screen so that all of them get drawn
+  system->origin_x = 40 + (index * 97) % (BENCH_SCREEN_WIDTH - 80);
+  system->origin_y = 120 + (index * 53) % (BENCH_SCREEN_HEIGHT - 160);
+
+  if (scenario->use_forces) {
+    SubstParticleForce forces[] = {
+        {.type = SUBST_PARTICLE_FORCE_GRAVITY, .y = 60.f},
+        {.type = SUBST_PARTICLE_FORCE_DRAG, .strength = 0.3f},
+        {.type = SUBST_PARTICLE_FORCE_VORTEX,
+         .x = system->origin_x,
+         .y = system->origin_y - 40.f,
+         .strength = 30.f,
+         .radius = 120.f},
+    };
+    for (size_t i = 0; i < sizeof(forces) / sizeof(forces[0]); i++) {
+      subst_particle_system_force_add(system, &forces[i]);
+    }
+  }
+
+  return system;
+}
+
+static void bench_systems_update(SubstParticleSystem **systems,
+                                 int system_count,
+                                 const BenchOptions *options) {
+  if (options->is_parallel) {
+    subst_particle_systems_update_all(systems, system_count,
+                                      options->time_delta);
+  } else {
+    for (int i = 0; i < system_count; i++) {
+      subst_particle_system_update(systems[i], options->time_delta);
+    }
+  }
+}
+
+static void bench_scenario_run(const BenchScenario *scenario,
+                               const BenchOptions *options,
+                               SubstRenderer *renderer) {
+  SubstSphere sphere = {BENCH_SCREEN_WIDTH / 2.f, BENCH_SCREEN_HEIGHT / 2.f,
+                        0.f, 60.f};
+  SubstParticleSystem **systems =
+      malloc(sizeof(SubstParticleSystem *) * scenario->system_count);
+  for (int i = 0; i < scenario->system_count; i++) {
+    systems[i] = bench_system_create(scenario, options->seed, i);
+    if (scenario->use_forces) {
+      SubstParticleCollider collider = {.sphere = sphere,
+                                        .response =
+                                            SUBST_PARTICLE_COLLISION_BOUNCE,
+                                        .restitution = 0.5f};
+      subst_particle_system_collider_add(systems[i], &collider);
+    }
+  }
+
+  // Run until the oldest particles have died so that the timed frames see
+  // the systems at their steady state
+  int warmup_frames =
+      (int)ceilf(scenario->lifetime / options->time_delta) + 1;
+  for (int i = 0; i < warmup_frames; i++) {
+    bench_systems_update(systems, scenario->system_count, options);
+  }
+
+  double update_ns = 0, render_ns = 0;
+  uint64_t particle_updates = 0;
+  bench_allocations_reset();
+
+  for (int frame = 0; frame < options->frame_count; frame++) {
+    double start = bench_time_ns();
+    bench_systems_update(systems, scenario->system_count, options);
+    update_ns += bench_time_ns() - start;
+
+    for (int i = 0; i < scenario->system_count; i++) {
+      particle_updates += subst_particle_system_live_count(systems[i]);
+    }
+
+    // Wait for the GPU so that the time covers the whole draw
+    if (renderer) {
+      start = bench_time_ns();
+      glClear(GL_COLOR_BUFFER_BIT);
+      for (int i = 0; i < scenario->system_count; i++) {
+        subst_particle_system_render(systems[i], renderer);
+      }
+      subst_renderer_flush(renderer);
+      glFinish();
+      render_ns += bench_time_ns() - start;
+    }
+  }
+
+  size_t allocation_count, allocation_bytes;
+  bench_allocations_get(&allocation_count, &allocation_bytes);
+  double particles_per_frame = (double)particle_updates / options->frame_count;
+  double ns_per_particle =
+      particle_updates > 0 ? update_ns / particle_updates : 0;
+  double particles_per_sec =
+      update_ns > 0 ? particle_updates / (update_ns / 1e9) : 0;
+
+  printf("{\"scenario\": \"%s\", \"systems\": %d, \"sources\": %d, "
+         "\"max_particles\": %d, \"interval\": %g, \"lifetime\": %g, "
+         "\"forces\": %s, \"parallel\": %s, \"frames\": %d, "
+         "\"particles_per_frame\": %.1f, \"update_ms_per_frame\": %.4f, "
+         "\"ns_per_particle\": %.3f, \"particles_per_sec\": %.0f, "
+         "\"allocations\": %zu, \"allocated_bytes\": %zu",
+         scenario->name, scenario->system_count, scenario->source_count,
+         scenario->max_particles, scenario->interval, scenario->lifetime,
+         scenario->use_forces ? "true" : "false",
+         options->is_parallel ? "true" : "false", options->frame_count,
+         particles_per_frame, update_ns / 1e6 / options->frame_count,
+         ns_per_particle, particles_per_sec, allocation_count,
+         allocation_bytes);
+  if (renderer) {
+    printf(", \"render_ms_per_frame\": %.4f",
+           render_ns / 1e6 / options->frame_count);
+  }
+  printf("}\n");
+  fflush(stdout);
+
+  for (int i = 0; i < scenario->system_count; i++) {
+    subst_particle_system_free(systems[i]);
+  }
+  free(systems);
+}
+
+static void bench_usage(const char *program) {
+  fprintf(stderr,
+          "Usage: %s [options]\n"
+          "  --frames N          Timed frames per scenario (default 600)\n"
+          "  --dt SECONDS        Time step per frame (default 1/60)\n"
+          "  --seed N            Base seed for the systems' generators\n"
+          "  --parallel          Update systems on the worker pool\n"
+          "  --render            Also time drawing into a headless window\n"
+          "Any of these replaces the default suite with a single scenario:\n"
+          "  --systems N --sources N --max-particles N\n"
+          "  --interval SECONDS --lifetime SECONDS --forces\n",
+          program);
+}
+
+int main(int argc, char **argv) {
+  BenchOptions options = {.frame_count = 600,
+                          .time_delta = 1.f / 60.f,
+                          .is_parallel = false,
+                          .use_render = false,
+                          .seed = 1};
+  BenchScenario custom = {"custom", 1, 1, 10000, 0.0001f, 1.f, false};
+  bool use_custom = false;
+
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+
+    if (strcmp(arg, "--parallel") == 0) {
+      options.is_parallel = true;
+    } else if (strcmp(arg, "--render") == 0) {
+      options.use_render = true;
+    } else if (strcmp(arg, "--forces") == 0) {
+      custom.use_forces = use_custom = true;
+    } else if (value == NULL) {
+      bench_usage(argv[0]);
+      return 1;
+    } else if (strcmp(arg, "--frames") == 0) {
+      options.frame_count = atoi(value), i++;
+    } else if (strcmp(arg, "--dt") == 0) {
+      options.time_delta = atof(value), i++;
+    } else if (strcmp(arg, "--seed") == 0) {
+      options.seed = strtoull(value, NULL, 10), i++;
+    } else if (strcmp(arg, "--systems") == 0) {
+      custom.system_count = atoi(value), use_custom = true, i++;
+    } else if (strcmp(arg, "--sources") == 0) {
+      custom.source_count = atoi(value), use_custom = true, i++;
+    } else if (strcmp(arg, "--max-particles") == 0) {
+      custom.max_particles = atoi(value), use_custom = true, i++;
+    } else if (strcmp(arg, "--interval") == 0) {
+      custom.interval = atof(value), use_custom = true, i++;
+    } else if (strcmp(arg, "--lifetime") == 0) {
+      custom.lifetime = atof(value), use_custom = true, i++;
+    } else {
+      bench_usage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (options.frame_count <= 0 || options.time_delta <= 0) {
+    bench_usage(argv[0]);
+    return 1;
+  }
+
+  SubstWindow *window = NULL;
+  SubstRenderer *renderer = NULL;
+  if (options.use_render) {
+    window = subst_window_create_ex(BENCH_SCREEN_WIDTH, BENCH_SCREEN_HEIGHT,
+                                    "Particle Benchmark", true);
+    if (window == NULL) {
+      fprintf(stderr, "Could not create a headless window to render into.\n");
+      return 1;
+    }
+
+    renderer = subst_renderer_create(window);
+  }
+
+  if (use_custom) {
+    bench_scenario_run(&custom, &options, renderer);
+  } else {
+    for (size_t i = 0; i < sizeof(bench_default_scenarios) /
+                               sizeof(bench_default_scenarios[0]);
+         i++) {
+      bench_scenario_run(&bench_default_scenarios[i], &options, renderer);
+    }
+  }
+
+  if (window) {
+    subst_window_destroy(window);
+    subst_renderer_end();
+  }
+
+  return 0;
+}
@@ -0,0 +1,978 @@
+#include <math.h>
+#include <mesche.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "body.h"
+#include "log.h"
+
+#define BODY_INITIAL_CAPACITY 64
+#define BODY_DEFAULT_TIME_STEP (1.f / 60.f)
+#define BODY_DEFAULT_VELOCITY_ITERATIONS 8
+
+// Updates that fall this many steps behind drop the rest of the time rather
+// than spending ever longer catching up
+#define BODY_MAX_STEPS_PER_UPDATE 8
+
+// Overlap that is left alone so that resting contacts don't jitter, and how
+// much of the remaining overlap is pushed out each step
+#define BODY_POSITION_SLOP 0.5f
+#define BODY_POSITION_CORRECTION 0.4f
+
+// Contacts closing slower than this don't bounce so that stacks can settle
+#define BODY_RESTITUTION_THRESHOLD 10.f
+
+#define BODY_DEFAULT_RESTITUTION 0.f
+#define BODY_DEFAULT_FRICTION 0.3f
+
+SubstBodyWorld *subst_body_world_create(float time_step, float cell_size) {
+  SubstBodyWorld *world = malloc(sizeof(SubstBodyWorld));
+  memset(world, 0, sizeof(SubstBodyWorld));
+
+  world->time_step = time_step > 0 ? time_step : BODY_DEFAULT_TIME_STEP;
+  world->velocity_iterations = BODY_DEFAULT_VELOCITY_ITERATIONS;
+  world->colliders = subst_collision_world_create(cell_size);
+
+  return world;
+}
+
+void subst_body_world_free(SubstBodyWorld *world) {
+  subst_collision_world_free(world->colliders);
+  free(world->ids);
+  free(world->position_x);
+  free(world->position_y);
+  free(world->previous_x);
+  free(world->previous_y);
+  free(world->velocity_x);
+  free(world->velocity_y);
+  free(world->force_x);
+  free(world->force_y);
+  free(world->inverse_mass);
+  free(world->restitution);
+  free(world->friction);
+  free(world->body_indices);
+  free(world->contacts);
+  free(world->impulses);
+  free(world);
+}
+
+static void body_world_reserve(SubstBodyWorld *world) {
+  if (world->count < world->capacity) {
+    return;
+  }
+
+  world->capacity =
+      world->capacity == 0 ? BODY_INITIAL_CAPACITY : world->capacity * 2;
+  size_t size = sizeof(float) * world->capacity;
+  world->ids = realloc(world->ids, sizeof(uint32_t) * world->capacity);
+  world->position_x = realloc(world->position_x, size);
+  world->position_y = realloc(world->position_y, size);
+  world->previous_x = realloc(world->previous_x, size);
+  world->previous_y = realloc(world->previous_y, size);
+  world->velocity_x = realloc(world->velocity_x, size);
+  world->velocity_y = realloc(world->velocity_y, size);
+  world->force_x = realloc(world->force_x, size);
+  world->force_y = realloc(world->force_y, size);
+  world->inverse_mass = realloc(world->inverse_mass, size);
+  world->restitution = realloc(world->restitution, size);
+  world->friction = realloc(world->friction, size);
+}
+
+bool subst_body_world_contains(SubstBodyWorld *world, uint32_t id) {
+  return id < world->body_index_capacity &&
+         world->body_indices[id] != SUBST_COLLISION_INVALID_ID;
+}
+
+// Finds how far a collider's center is from the corner it is positioned by
+static void body_world_center_offset(SubstBodyWorld *world, uint32_t id,
+                                     float *x, float *y) {
+  SubstCollisionWorld *colliders = world->colliders;
+  uint32_t index = colliders->id_indices[id];
+  if (colliders->shapes[index] == SUBST_COLLISION_SHAPE_BOX) {
+    *x = colliders->half_width[index];
+    *y = colliders->half_height[index];
+  } else {
+    *x = 0;
+    *y = 0;
+  }
+}
+
+static uint32_t body_world_body_add(SubstBodyWorld *world, uint32_t id,
+                                    float mass) {
+  if (id >= world->body_index_capacity) {
+    uint32_t capacity = world->colliders->id_capacity;
+    world->body_indices =
+        realloc(world->body_indices, sizeof(uint32_t) * capacity);
+    for (uint32_t i = world->body_index_capacity; i < capacity; i++) {
+      world->body_indices[i] = SUBST_COLLISION_INVALID_ID;
+    }
+    world->body_index_capacity = capacity;
+  }
+
+  body_world_reserve(world);
+
+  SubstCollisionWorld *colliders = world->colliders;
+  uint32_t collider = colliders->id_indices[id];
+  uint32_t index = world->count++;
+  world->body_indices[id] = index;
+  world->ids[index] = id;
+  world->position_x[index] = colliders->center_x[collider];
+  world->position_y[index] = colliders->center_y[collider];
+  world->previous_x[index] = world->position_x[index];
+  world->previous_y[index] = world->position_y[index];
+  world->velocity_x[index] = 0;
+  world->velocity_y[index] = 0;
+  world->force_x[index] = 0;
+  world->force_y[index] = 0;
+  world->inverse_mass[index] = mass > 0 ? 1.f / mass : 0;
+  world->restitution[index] = BODY_DEFAULT_RESTITUTION;
+  world->friction[index] = BODY_DEFAULT_FRICTION;
+
+  return id;
+}
+
+uint32_t subst_body_world_sphere_add(SubstBodyWorld *world, float x, float y,
+                                     float radius, float mass) {
+  return body_world_body_add(
+      world, subst_collision_world_add(world->colliders, x, y, radius), mass);
+}
+
+uint32_t subst_body_world_box_add(SubstBodyWorld *world, float x, float y,
+                                  float width, float height, float mass) {
+  return body_world_body_add(
+      world,
+      subst_collision_world_box_add(world->colliders, x, y, width, height),
+      mass);
+}
+
+void subst_body_world_remove(SubstBodyWorld *world, uint32_t id) {
+  if (!subst_body_world_contains(world, id)) {
+    return;
+  }
+
+  subst_collision_world_remove(world->colliders, id);
+
+  // Move the last body into the hole to keep the arrays packed
+  uint32_t index = world->body_indices[id];
+  uint32_t last = --world->count;
+  if (index != last) {
+    world->ids[index] = world->ids[last];
+    world->position_x[index] = world->position_x[last];
+    world->position_y[index] = world->position_y[last];
+    world->previous_x[index] = world->previous_x[last];
+    world->previous_y[index] = world->previous_y[last];
+    world->velocity_x[index] = world->velocity_x[last];
+    world->velocity_y[index] = world->velocity_y[last];
+    world->force_x[index] = world->force_x[last];
+    world->force_y[index] = world->force_y[last];
+    world->inverse_mass[index] = world->inverse_mass[last];
+    world->restitution[index] = world->restitution[last];
+    world->friction[index] = world->friction[last];
+    world->body_indices[world->ids[index]] = index;
+  }
+
+  world->body_indices[id] = SUBST_COLLISION_INVALID_ID;
+}
+
+uint32_t subst_body_world_static_sphere_add(SubstBodyWorld *world, float x,
+                                            float y, float radius) {
+  return subst_collision_world_add(world->colliders, x, y, radius);
+}
+
+uint32_t subst_body_world_static_box_add(SubstBodyWorld *world, float x,
+                                         float y, float width, float height) {
+  return subst_collision_world_box_add(world->colliders, x, y, width, height);
+}
+
+bool subst_body_world_static_remove(SubstBodyWorld *world, uint32_t id) {
+  if (subst_body_world_contains(world, id) ||
+      !subst_collision_world_contains(world->colliders, id)) {
+    return false;
+  }
+
+  subst_collision_world_remove(world->colliders, id);
+
+  return true;
+}
+
+void subst_body_world_position_set(SubstBodyWorld *world, uint32_t id,
+                                   float x, float y) {
+  if (!subst_body_world_contains(world, id)) {
+    return;
+  }
+
+  float offset_x, offset_y;
+  body_world_center_offset(world, id, &offset_x, &offset_y);
+
+  uint32_t index = world->body_indices[id];
+  world->position_x[index] = x + offset_x;
+  world->position_y[index] = y + offset_y;
+  world->previous_x[index] = world->position_x[index];
+  world->previous_y[index] = world->position_y[index];
+  subst_collision_world_move(world->colliders, id, x, y);
+}
+
+void subst_body_world_velocity_set(SubstBodyWorld *world, uint32_t id,
+                                   float x, float y) {
+  if (!subst_body_world_contains(world, id)) {
+    return;
+  }
+
+  uint32_t index = world->body_indices[id];
+  world->velocity_x[index] = x;
+  world->velocity_y[index] = y;
+}
+
+void subst_body_world_mass_set(SubstBodyWorld *world, uint32_t id,
+                               float mass) {
+  if (!subst_body_world_contains(world, id)) {
+    return;
+  }
+
+  world->inverse_mass[world->body_indices[id]] = mass > 0 ? 1.f / mass : 0;
+}
+
+void subst_body_world_material_set(SubstBodyWorld *world, uint32_t id,
+                                   float restitution, float friction) {
+  if (!subst_body_world_contains(world, id)) {
+    return;
+  }
+
+  uint32_t index = world->body_indices[id];
+  world->restitution[index] = restitution;
+  world->friction[index] = friction;
+}
+
+void subst_body_world_impulse_apply(SubstBodyWorld *world, uint32_t id,
+                                    float x, float y) {
+  if (!subst_body_world_contains(world, id)) {
+    return;
+  }
+
+  uint32_t index = world->body_indices[id];
+  world->velocity_x[index] += x * world->inverse_mass[index];
+  world->velocity_y[index] += y * world->inverse_mass[index];
+}
+
+void subst_body_world_force_apply(SubstBodyWorld *world, uint32_t id, float x,
+                                  float y) {
+  if (!subst_body_world_contains(world, id)) {
+    return;
+  }
+
+  uint32_t index = world->body_indices[id];
+  world->force_x[index] += x;
+  world->force_y[index] += y;
+}
+
+void subst_body_world_render_position(SubstBodyWorld *world, uint32_t id,
+                                      float *x, float *y) {
+  if (!subst_body_world_contains(world, id)) {
+    *x = 0;
+    *y = 0;
+    return;
+  }
+
+  float offset_x, offset_y;
+  body_world_center_offset(world, id, &offset_x, &offset_y);
+
+  uint32_t index = world->body_indices[id];
+  float alpha = world->interpolation;
+  *x = world->previous_x[index] +
+       (world->position_x[index] - world->previous_x[index]) * alpha -
+       offset_x;
+  *y = world->previous_y[index] +
+       (world->position_y[index] - world->previous_y[index]) * alpha -
+       offset_y;
+}
+
+static inline uint32_t body_world_contact_body(SubstBodyWorld *world,
+                                               uint32_t id) {
+  return id < world->body_index_capacity ? world->body_indices[id]
+                                         : SUBST_COLLISION_INVALID_ID;
+}
+
+static inline float body_world_inverse_mass(SubstBodyWorld *world,
+                                            uint32_t index) {
+  return index != SUBST_COLLISION_INVALID_ID ? world->inverse_mass[index] : 0;
+}
+
+static inline float body_world_velocity(const float *velocities,
+                                        uint32_t index) {
+  return index != SUBST_COLLISION_INVALID_ID ? velocities[index] : 0;
+}
+
+static inline uint64_t body_world_pair_key(uint32_t a, uint32_t b) {
+  return a < b ? (uint64_t)a << 32 | b : (uint64_t)b << 32 | a;
+}
+
+static SubstBodyImpulse *body_world_impulse_slot(SubstBodyImpulse *impulses,
+                                                 uint32_t capacity,
+                                                 uint64_t pair_key) {
+  // Keys are never 0 since a collider can't touch itself, so 0 marks an
+  // empty slot
+  uint32_t mask = capacity - 1;
+  uint32_t index =
+      (uint32_t)((pair_key * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+  while (impulses[index].pair_key != 0 &&
+         impulses[index].pair_key != pair_key) {
+    index = (index + 1) & mask;
+  }
+
+  return &impulses[index];
+}
+
+static void body_world_impulses_store(SubstBodyWorld *world,
+                                      uint32_t contact_count) {
+  uint32_t capacity = world->impulse_capacity > 0 ? world->impulse_capacity
+                                                  : BODY_INITIAL_CAPACITY;
+  while (capacity < contact_count * 2) {
+    capacity *= 2;
+  }
+  if (capacity != world->impulse_capacity) {
+    world->impulses =
+        realloc(world->impulses, sizeof(SubstBodyImpulse) * capacity);
+    world->impulse_capacity = capacity;
+  }
+
+  memset(world->impulses, 0, sizeof(SubstBodyImpulse) * capacity);
+  for (uint32_t i = 0; i < contact_count; i++) {
+    SubstBodyContact *contact = &world->contacts[i];
+    SubstBodyImpulse *impulse = body_world_impulse_slot(
+        world->impulses, capacity, contact->pair_key);
+    impulse->pair_key = contact->pair_key;
+    impulse->normal_impulse = contact->normal_impulse;
+    impulse->tangent_impulse = contact->tangent_impulse;
+  }
+}
+
+// Turns the collision world's contacts into solver contacts, skipping the
+// ones where neither side can be pushed
+static uint32_t body_world_contacts_prepare(SubstBodyWorld *world) {
+  SubstContactSet *found = &world->colliders->contacts;
+  if (found->count > world->contact_capacity) {
+    world->contact_capacity = found->capacity;
+    world->contacts = realloc(world->contacts,
+                              sizeof(SubstBodyContact) * found->capacity);
+  }
+
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < found->count; i++) {
+    uint32_t first = body_world_contact_body(world, found->first[i]);
+    uint32_t second = body_world_contact_body(world, found->second[i]);
+    float inverse_mass = body_world_inverse_mass(world, first) +
+                         body_world_inverse_mass(world, second);
+    if (inverse_mass <= 0) {
+      continue;
+    }
+
+    SubstBodyContact *contact = &world->contacts[count++];
+    contact->pair_key =
+        body_world_pair_key(found->first[i], found->second[i]);
+    contact->first = first;
+    contact->second = second;
+    contact->normal_x = found->normal_x[i];
+    contact->normal_y = found->normal_y[i];
+    contact->depth = found->depth[i];
+    contact->normal_mass = 1.f / inverse_mass;
+    contact->normal_impulse = 0;
+    contact->tangent_impulse = 0;
+    if (world->impulse_capacity > 0) {
+      SubstBodyImpulse *impulse = body_world_impulse_slot(
+          world->impulses, world->impulse_capacity, contact->pair_key);
+      if (impulse->pair_key == contact->pair_key) {
+        contact->normal_impulse = impulse->normal_impulse;
+        contact->tangent_impulse = impulse->tangent_impulse;
+      }
+    }
+
+    // Colliders without a body take on the material of the body they touch
+    uint32_t body = first != SUBST_COLLISION_INVALID_ID ? first : second;
+    float restitution = world->restitution[body];
+    contact->friction = world->friction[body];
+    if (first != SUBST_COLLISION_INVALID_ID &&
+        second != SUBST_COLLISION_INVALID_ID) {
+      restitution =
+          fmaxf(world->restitution[first], world->restitution[second]);
+      contact->friction =
+          sqrtf(world->friction[first] * world->friction[second]);
+    }
+
+    // Bounce off of the speed the bodies were closing at before solving
+    float closing_speed =
+        (body_world_velocity(world->velocity_x, second) -
+         body_world_velocity(world->velocity_x, first)) *
+            contact->normal_x +
+        (body_world_velocity(world->velocity_y, second) -
+         body_world_velocity(world->velocity_y, first)) *
+            contact->normal_y;
+    contact->velocity_bias = closing_speed < -BODY_RESTITUTION_THRESHOLD
+                                 ? -restitution * closing_speed
+                                 : 0;
+  }
+
+  return count;
+}
+
+static inline void body_world_impulse_push(SubstBodyWorld *world,
+                                           const SubstBodyContact *contact,
+                                           float impulse_x, float impulse_y) {
+  if (contact->first != SUBST_COLLISION_INVALID_ID) {
+    float inverse_mass = world->inverse_mass[contact->first];
+    world->velocity_x[contact->first] -= impulse_x * inverse_mass;
+    world->velocity_y[contact->first] -= impulse_y * inverse_mass;
+  }
+  if (contact->second != SUBST_COLLISION_INVALID_ID) {
+    float inverse_mass = world->inverse_mass[contact->second];
+    world->velocity_x[contact->second] += impulse_x * inverse_mass;
+    world->velocity_y[contact->second] += impulse_y * inverse_mass;
+  }
+}
+
+// Applies the impulses carried over from the last step, which is most of
+// what resting contacts need
+static void body_world_contacts_warm_start(SubstBodyWorld *world,
+                                           uint32_t contact_count) {
+  for (uint32_t i = 0; i < contact_count; i++) {
+    SubstBodyContact *contact = &world->contacts[i];
+    body_world_impulse_push(
+        world, contact,
+        contact->normal_x * contact->normal_impulse -
+            contact->normal_y * contact->tangent_impulse,
+        contact->normal_y * contact->normal_impulse +
+            contact->normal_x * contact->tangent_impulse);
+  }
+}
+
+// One pass of sequential impulses over every contact.  The total impulse of
+// each contact is clamped rather than each pass's share so that later passes
+// can take back what earlier ones overdid.
+static void body_world_contacts_solve(SubstBodyWorld *world,
+                                      uint32_t contact_count) {
+  for (uint32_t i = 0; i < contact_count; i++) {
+    SubstBodyContact *contact = &world->contacts[i];
+    float normal_x = contact->normal_x, normal_y = contact->normal_y;
+
+    float relative_x =
+        body_world_velocity(world->velocity_x, contact->second) -
+        body_world_velocity(world->velocity_x, contact->first);
+    float relative_y =
+        body_world_velocity(world->velocity_y, contact->second) -
+        body_world_velocity(world->velocity_y, contact->first);
+    float speed = relative_x * normal_x + relative_y * normal_y;
+
+    float impulse =
+        contact->normal_mass * (contact->velocity_bias - speed);
+    float total = fmaxf(contact->normal_impulse + impulse, 0);
+    impulse = total - contact->normal_impulse;
+    contact->normal_impulse = total;
+    body_world_impulse_push(world, contact, normal_x * impulse,
+                            normal_y * impulse);
+
+    // Friction can only hold back as much as the contact is pressing
+    relative_x = body_world_velocity(world->velocity_x, contact->second) -
+                 body_world_velocity(world->velocity_x, contact->first);
+    relative_y = body_world_velocity(world->velocity_y, contact->second) -
+                 body_world_velocity(world->velocity_y, contact->first);
+    float tangent_x = -normal_y, tangent_y = normal_x;
+    float slide = relative_x * tangent_x + relative_y * tangent_y;
+
+    float limit = contact->friction * contact->normal_impulse;
+    float tangent_impulse = -contact->normal_mass * slide;
+    float tangent_total =
+        fminf(fmaxf(contact->tangent_impulse + tangent_impulse, -limit),
+              limit);
+    tangent_impulse = tangent_total - contact->tangent_impulse;
+    contact->tangent_impulse = tangent_total;
+    body_world_impulse_push(world, contact, tangent_x * tangent_impulse,
+                            tangent_y * tangent_impulse);
+  }
+}
+
+// Bodies that move further in a step than their own size can pass straight
+// through thin static colliders, so they are swept from where they started
+// and stopped where they first touch one.  Boxes are swept as the largest
+// circle that fits inside them.
+static void body_world_continuous_resolve(SubstBodyWorld *world) {
+  SubstCollisionWorld *colliders = world->colliders;
+  float time_step = world->time_step;
+
+  for (uint32_t i = 0; i < world->count; i++) {
+    if (world->inverse_mass[i] <= 0) {
+      continue;
+    }
+
+    uint32_t id = world->ids[i];
+    uint32_t collider = colliders->id_indices[id];
+    float radius = fminf(colliders->half_width[collider],
+                         colliders->half_height[collider]);
+    float velocity_x = world->velocity_x[i], velocity_y = world->velocity_y[i];
+    float travel = sqrtf(velocity_x * velocity_x + velocity_y * velocity_y) *
+                   time_step;
+    if (travel <= radius) {
+      continue;
+    }
+
+    SubstCast cast;
+    subst_cast_init(&cast, world->previous_x[i], world->previous_y[i],
+                    velocity_x, velocity_y, travel, radius);
+    cast.ignore_id = id;
+    uint32_t hit_count = subst_collision_world_cast(colliders, &cast, false);
+
+    // Colliders the body already touches are left to the solver
+    for (uint32_t h = 0; h < hit_count; h++) {
+      SubstCastHit *hit = &colliders->cast_hits.hits[h];
+      uint32_t other = body_world_contact_body(world, hit->id);
+      if (hit->distance <= 0 || body_world_inverse_mass(world, other) > 0) {
+        continue;
+      }
+
+      world->position_x[i] = cast.origin_x + cast.direction_x * hit->distance;
+      world->position_y[i] = cast.origin_y + cast.direction_y * hit->distance;
+
+      // Remove the part of the velocity that heads into the collider, and
+      // bounce it back out if the body is springy
+      float speed = velocity_x * hit->normal_x + velocity_y * hit->normal_y;
+      if (speed < 0) {
+        float bounce = 1.f + world->restitution[i];
+        world->velocity_x[i] -= hit->normal_x * speed * bounce;
+        world->velocity_y[i] -= hit->normal_y * speed * bounce;
+      }
+      break;
+    }
+  }
+}
+
+// Pushes overlapping bodies apart directly, since the velocity solver only
+// stops them from sinking further in.  The overlap found at the start of the
+// step is adjusted by how far the bodies have moved along the normal since.
+static void body_world_positions_correct(SubstBodyWorld *world,
+                                         uint32_t contact_count) {
+  for (uint32_t i = 0; i < contact_count; i++) {
+    SubstBodyContact *contact = &world->contacts[i];
+    uint32_t first = contact->first, second = contact->second;
+
+    float moved_x = 0, moved_y = 0;
+    if (first != SUBST_COLLISION_INVALID_ID) {
+      moved_x -= world->position_x[first] - world->previous_x[first];
+      moved_y -= world->position_y[first] - world->previous_y[first];
+    }
+    if (second != SUBST_COLLISION_INVALID_ID) {
+      moved_x += world->position_x[second] - world->previous_x[second];
+      moved_y += world->position_y[second] - world->previous_y[second];
+    }
+
+    float depth = contact->depth -
+                  (moved_x * contact->normal_x + moved_y * contact->normal_y);
+    float correction = (depth - BODY_POSITION_SLOP) *
+                       BODY_POSITION_CORRECTION * contact->normal_mass;
+    if (correction <= 0) {
+      continue;
+    }
+
+    if (first != SUBST_COLLISION_INVALID_ID) {
+      float inverse_mass = world->inverse_mass[first];
+      world->position_x[first] -= contact->normal_x * correction * inverse_mass;
+      world->position_y[first] -= contact->normal_y * correction * inverse_mass;
+    }
+    if (second != SUBST_COLLISION_INVALID_ID) {
+      float inverse_mass = world->inverse_mass[second];
+      world->position_x[second] +=
+          contact->normal_x * correction * inverse_mass;
+      world->position_y[second] +=
+          contact->normal_y * correction * inverse_mass;
+    }
+  }
+}
+
+static void body_world_colliders_sync(SubstBodyWorld *world) {
+  for (uint32_t i = 0; i < world->count; i++) {
+    float offset_x, offset_y;
+    body_world_center_offset(world, world->ids[i], &offset_x, &offset_y);
+    subst_collision_world_move(world->colliders, world->ids[i],
+                               world->position_x[i] - offset_x,
+                               world->position_y[i] - offset_y);
+  }
+}
+
+void subst_body_world_step(SubstBodyWorld *world) {
+  uint32_t count = world->count;
+  float time_step = world->time_step;
+
+  memcpy(world->previous_x, world->position_x, sizeof(float) * count);
+  memcpy(world->previous_y, world->position_y, sizeof(float) * count);
+
+  // Gravity only pulls on bodies that have mass
+  float *velocity_x = world->velocity_x, *velocity_y = world->velocity_y;
+  const float *inverse_mass = world->inverse_mass;
+  for (uint32_t i = 0; i < count; i++) {
+    float gravity_scale = inverse_mass[i] > 0 ? time_step : 0;
+    velocity_x[i] += world->gravity_x * gravity_scale +
+                     world->force_x[i] * inverse_mass[i] * time_step;
+    velocity_y[i] += world->gravity_y * gravity_scale +
+                     world->force_y[i] * inverse_mass[i] * time_step;
+  }
+  memset(world->force_x, 0, sizeof(float) * count);
+  memset(world->force_y, 0, sizeof(float) * count);
+
+  subst_collision_world_pairs_find(world->colliders);
+  uint32_t contact_count = body_world_contacts_prepare(world);
+  body_world_contacts_warm_start(world, contact_count);
+  for (uint32_t i = 0; i < world->velocity_iterations; i++) {
+    body_world_contacts_solve(world, contact_count);
+  }
+  body_world_impulses_store(world, contact_count);
+
+  float *position_x = world->position_x, *position_y = world->position_y;
+  for (uint32_t i = 0; i < count; i++) {
+    position_x[i] += velocity_x[i] * time_step;
+    position_y[i] += velocity_y[i] * time_step;
+  }
+
+  body_world_continuous_resolve(world);
+  body_world_positions_correct(world, contact_count);
+  body_world_colliders_sync(world);
+}
+
+uint32_t subst_body_world_update(SubstBodyWorld *world, float time_delta) {
+  uint32_t step_count = 0;
+  world->time_accumulator += time_delta;
+  while (world->time_accumulator >= world->time_step) {
+    if (step_count == BODY_MAX_STEPS_PER_UPDATE) {
+      world->time_accumulator = fmodf(world->time_accumulator,
+                                      world->time_step);
+      break;
+    }
+
+    subst_body_world_step(world);
+    world->time_accumulator -= world->time_step;
+    step_count++;
+  }
+
+  world->interpolation = world->time_accumulator / world->time_step;
+  return step_count;
+}
+
+void body_world_free_func(MescheMemory *mem, void *obj) {
+  subst_body_world_free((SubstBodyWorld *)obj);
+}
+
+const ObjectPointerType SubstBodyWorldType = {
+    .name = "body-world", .free_func = body_world_free_func};
+
+Value subst_body_world_create_msc(VM *vm, int arg_count, Value *args) {
+  if (arg_count != 3) {
+    subst_log("Function requires 3 parameters.");
+  }
+
+  SubstBodyWorld *world =
+      subst_body_world_create(IS_NUMBER(args[0]) ? AS_NUMBER(args[0]) : 0,
+                              IS_NUMBER(args[1]) ? AS_NUMBER(args[1]) : 0);
+  if (IS_NUMBER(args[2]) && AS_NUMBER(args[2]) > 0) {
+    world->velocity_iterations = AS_NUMBER(args[2]);
+  }
+
+  return OBJECT_VAL(
+      mesche_object_make_pointer_type(vm, world, &SubstBodyWorldType));
+}
+
+// Applies the mass, restitution and friction arguments that trail the add
+// natives' arguments, leaving the defaults for any that aren't numbers
+static uint32_t body_world_body_args_apply(SubstBodyWorld *world, uint32_t id,
+                                           Value *args) {
+  if (IS_NUMBER(args[0])) {
+    subst_body_world_mass_set(world, id, AS_NUMBER(args[0]));
+  }
+
+  uint32_t index = world->body_indices[id];
+  subst_body_world_material_set(
+      world, id,
+      IS_NUMBER(args[1]) ? AS_NUMBER(args[1]) : world->restitution[index],
+      IS_NUMBER(args[2]) ? AS_NUMBER(args[2]) : world->friction[index]);
+
+  return id;
+}
+
+Value subst_body_world_sphere_add_msc(VM *vm, int arg_count, Value *args) {
+  if (arg_count != 7) {
+    subst_log("Function requires 7 parameters.");
+  }
+
+  SubstBodyWorld *world = (SubstBodyWorld *)AS_POINTER(args[0])->ptr;
+  uint32_t id = subst_body_world_sphere_add(
+      world, AS_NUMBER(args[1]), AS_NUMBER(args[2]), AS_NUMBER(args[3]), 1.f);
+
+  return NUMBER_VAL(body_world_body_args_apply(world, id, &args[4]));
+}
+
+Value subst_body_world_box_add_msc(VM *vm, int arg_count, Value *args) {
+  if (arg_count != 8) {
+    subst_log("Function requires 8 parameters.");
+  }
+
+  SubstBodyWorld *world = (SubstBodyWorld *)AS_POINTER(args[0])->ptr;
+  uint32_t id = subst_body_world_box_add(world, AS_NUMBER(args[1]),
+                                         AS_NUMBER(args[2]), AS_NUMBER(args[3]),
+                                         AS_NUMBER(args[4]), 1.f);
+
+  return NUMBER_VAL(body_world_body_args_apply(world, id, &args[5]));
+}
+
+Value subst_body_world_remove_msc(VM *vm, int arg_count, Value *args) {
+  if (arg_count != 2) {
+    subst_log("Function requires 2 parameters.");
+  }
+
+  SubstBodyWorld *world = (SubstBodyWorld *)AS_POINTER(args[0])->ptr;
+  uint32_t id = AS_NUMBER(args[1]);
+  if (!subst_body_world_contains(world, id)) {
+    return FALSE_VAL;
+  }
+
+  subst_body_world_remove(world, id);
+
+  return TRUE_VAL;
+}
+
+Value subst_body_world_count_msc(VM *vm, int arg_count, Value *args) {
+  if (arg_count != 1) {
+    subst_log("Function requires 1 parameter.");
+  }
+
+  SubstBodyWorld *world = (SubstBodyWorld *)AS_POINTER(args[0])->ptr;
+  return NUMBER_VAL(world->count);
+}
+
+Value subst_body_world_update_msc(VM *vm, int arg_count, Value *args) {
+  if (arg_count != 2) {
+    subst_log("Function requires 2 parameters.");
+  }
+
+  SubstBodyWorld *world = (SubstBodyWorld *)AS_POINTER(args[0])->ptr;
+  return NUMBER_VAL(subst_body_world_update(world, AS_NUMBER(args[1])));
+}
+
+Value subst_body_world_step_msc(VM *vm, int arg_count, Value *args) {
+  if (arg_count != 1) {
+    subst_log("Function requires 1 parameter.");
+  }
+
+  SubstBodyWorld *world = (SubstBodyWorld *)AS_POINTER(args[0])->ptr;
+  subst_body_world_step(world);
+
+  return TRUE_VAL;
+}
+
+Value subst_body_world_gravity_set_msc(VM *vm, int arg_count, Value *args) {
+  if (arg_count != 3) {
+    subst_log("Function requires 3 parameters.");
+  }
+
+  SubstBodyWorld *world = (SubstBodyWorld *)AS_POINTER(args[0])->ptr;
+  world->gravity_x = AS_NUMBER(args[1]);
+  world->gravity_y = AS_NUMBER(args[2]);
+
+  return TRUE_VAL;
+}
+
+Value subst_body_world_x_msc(VM *vm, int arg_count, Value *args) {
+  if (arg_count != 2) {
+    subst_log("Function requires 2 parameters.");
+  }
+
+  SubstBodyWorld *world = (SubstBodyWorld *)AS_POINTER(args[0])->ptr;
+  uint32_t id = AS_NUMBER(args[1]);
+  if (!subst_body_world_contains(world, id)) {
+    return FALSE_VAL;
+  }
+
+  float x, y;
+  subst_body_world_render_position(world, id, &x, &y);
+  return NUMBER_VAL(x);
+}
+
+Value subst_body_world_y_msc(VM *vm, int arg_count, Value *args) {
+  if (arg_count != 2) {
+    subst_log("Function requires 2 parameters.");
+  }
+
+  SubstBodyWorld *world = (SubstBodyWorld *)AS_POINTER(args[0])->ptr;
+  uint32_t id = AS_NUMBER(args[1]);
+  if (!subst_body_world_contains(world, id)) {
+    return FALSE_VAL;
+  }
+
+  float x, y;
+  subst_body_world_render_position(world, id, &x, &y);
+  return NUMBER_VAL(y);
+}
+
+Value subst_body_world_velocity_x_msc(VM *vm, int arg_count, Value *args) {
+  if (arg_count != 2) {
+    subst_log("Function requires 2 parameters.");
+  }
+
+  SubstBodyWorld *world = (SubstBodyWorld *)AS_POINTER(args[0])->ptr;
+  uint32_t id = AS_NUMBER(args[1]);
+  if (!subst_body_world_contains(world, id)) {
+    return FALSE_VAL;
+  }
+
+  return NUMBER_VAL(world->velocity_x[world->body_indices[id]]);
+}
+
+Value subst_body_world_velocity_y_msc(VM *vm, int arg_count, Value *args) {
+  if (arg_count != 2) {
+    subst_log("Function requires 2 parameters.");
+  }
+
+  SubstBodyWorld *world = (SubstBodyWorld *)AS_POINTER(args[0])->ptr;
+  uint32_t id = AS_NUMBER(args[1]);
+  if (!subst_body_world_contains(world, id)) {
+    return FALSE_VAL;
+  }
+
+  return NUMBER_VAL(world->velocity_y[world->body_indices[id]]);
+}
+
+Value subst_body_world_position_set_msc(VM *vm, int arg_count, Value *args) {
+  if (arg_count != 4) {
+    subst_log("Function requires 4 parameters.");
+  }
+
+  SubstBodyWorld *world = (SubstBodyWorld *)AS_POINTER(args[0])->ptr;
+  subst_body_world_position_set(world, AS_NUMBER(args[1]), AS_NUMBER(args[2]),
+                                AS_NUMBER(args[3]));
+
+  return TRUE_VAL;
+}
+
+Value subst_body_world_velocity_set_msc(VM *vm, int arg_count, Value *args) {
+  if (arg_count != 4) {
+    subst_log("Function requires 4 parameters.");
+  }
+
+  SubstBodyWorld *world = (SubstBodyWorld *)AS_POINTER(args[0])->ptr;
+  subst_body_world_velocity_set(world, AS_NUMBER(args[1]), AS_NUMBER(args[2]),
+                                AS_NUMBER(args[3]));
+
+  return TRUE_VAL;
+}
+
+Value subst_body_world_impulse_apply_msc(VM *vm, int arg_count,
+                                         Value *args) {
+  if (arg_count != 4) {
+    subst_log("Function requires 4 parameters.");
+  }
+
+  SubstBodyWorld *world = (SubstBodyWorld *)AS_POINTER(args[0])->ptr;
+  subst_body_world_impulse_apply(world, AS_NUMBER(args[1]),
+                                 AS_NUMBER(args[2]), AS_NUMBER(args[3]));
+
+  return TRUE_VAL;
+}
+
+Value subst_body_world_force_apply_msc(VM *vm, int arg_count, Value *args) {
+  if (arg_count != 4) {
+    subst_log("Function requires 4 parameters.");
+  }
+
+  SubstBodyWorld *world = (SubstBodyWorld *)AS_POINTER(args[0])->ptr;
+  subst_body_world_force_apply(world, AS_NUMBER(args[1]), AS_NUMBER(args[2]),
+                               AS_NUMBER(args[3]));
+
+  return TRUE_VAL;
+}
+
+Value subst_body_world_mass_set_msc(VM *vm, int arg_count, Value *args) {
+  if (arg_count != 3) {
+    subst_log("Function requires 3 parameters.");
+  }
+
+  SubstBodyWorld *world = (SubstBodyWorld *)AS_POINTER(args[0])->ptr;
+  subst_body_world_mass_set(world, AS_NUMBER(args[1]), AS_NUMBER(args[2]));
+
+  return TRUE_VAL;
+}
+
+Value subst_body_world_material_set_msc(VM *vm, int arg_count, Value *args) {
+  if (arg_count != 4) {
+    subst_log("Function requires 4 parameters.");
+  }
+
+  SubstBodyWorld *world = (SubstBodyWorld *)AS_POINTER(args[0])->ptr;
+  subst_body_world_material_set(world, AS_NUMBER(args[1]), AS_NUMBER(args[2]),
+                                AS_NUMBER(args[3]));
+
+  return TRUE_VAL;
+}
+
+Value subst_body_world_static_sphere_add_msc(VM *vm, int arg_count,
+                                             Value *args) {
+  if (arg_count != 4) {
+    subst_log("Function requires 4 parameters.");
+  }
+
+  SubstBodyWorld *world = (SubstBodyWorld *)AS_POINTER(args[0])->ptr;
+  return NUMBER_VAL(subst_body_world_static_sphere_add(
+      world, AS_NUMBER(args[1]), AS_NUMBER(args[2]), AS_NUMBER(args[3])));
+}
+
+Value subst_body_world_static_box_add_msc(VM *vm, int arg_count,
+                                          Value *args) {
+  if (arg_count != 5) {
+    subst_log("Function requires 5 parameters.");
+  }
+
+  SubstBodyWorld *world = (SubstBodyWorld *)AS_POINTER(args[0])->ptr;
+  return NUMBER_VAL(subst_body_world_static_box_add(
+      world, AS_NUMBER(args[1]), AS_NUMBER(args[2]), AS_NUMBER(args[3]),
+      AS_NUMBER(args[4])));
+}
+
+Value subst_body_world_static_remove_msc(VM *vm, int arg_count,
+                                         Value *args) {
+  if (arg_count != 2) {
+    subst_log("Function requires 2 parameters.");
+  }
+
+  SubstBodyWorld *world = (SubstBodyWorld *)AS_POINTER(args[0])->ptr;
+  return BOOL_VAL(subst_body_world_static_remove(world, AS_NUMBER(args[1])));
+}
+
+void subst_body_module_init(VM *vm) {
+  mesche_vm_define_native_funcs(
+      vm, "substratic physics",
+      (MescheNativeFuncDetails[]){
+          {"body-world-create-internal", subst_body_world_create_msc, false},
+          {"body-world-sphere-add-internal", subst_body_world_sphere_add_msc,
+           false},
+          {"body-world-box-add-internal", subst_body_world_box_add_msc,
+           false},
+          {"body-world-remove!", subst_body_world_remove_msc, true},
+          {"body-world-count", subst_body_world_count_msc, true},
+          {"body-world-update!", subst_body_world_update_msc, true},
+          {"body-world-step!", subst_body_world_step_msc, true},
+          {"body-world-gravity-set!", subst_body_world_gravity_set_msc, true},
+          {"body-world-x", subst_body_world_x_msc, true},
+          {"body-world-y", subst_body_world_y_msc, true},
+          {"body-world-velocity-x", subst_body_world_velocity_x_msc, true},
+          {"body-world-velocity-y", subst_body_world_velocity_y_msc, true},
+          {"body-world-position-set!", subst_body_world_position_set_msc,
+           true},
+          {"body-world-velocity-set!", subst_body_world_velocity_set_msc,
+           true},
+          {"body-world-impulse-apply!", subst_body_world_impulse_apply_msc,
+           true},
+          {"body-world-force-apply!", subst_body_world_force_apply_msc, true},
+          {"body-world-mass-set!", subst_body_world_mass_set_msc, true},
+          {"body-world-material-set!", subst_body_world_material_set_msc,
+           true},
+          {"body-world-static-sphere-add!",
+           subst_body_world_static_sphere_add_msc, true},
+          {"body-world-static-box-add!", subst_body_world_static_box_add_msc,
+           true},
+          {"body-world-static-remove!", subst_body_world_static_remove_msc,
+           true},
+          {NULL, NULL, false}});
+}
@@ -0,0 +1,128 @@
+#ifndef __subst_body_h
+#define __subst_body_h
+
+#include <inttypes.h>
+#include <mesche.h>
+#include <stdbool.h>
+
+#include "collision.h"
+
+// Solver state for one contact found by the collision world.  Bodies are
+// given by index, a collider with no body is given as
+// SUBST_COLLISION_INVALID_ID and acts as immovable geometry.
+typedef struct {
+  uint64_t pair_key;
+  uint32_t first, second;
+  float normal_x, normal_y;
+  float depth;
+  float normal_mass;
+  float velocity_bias;
+  float friction;
+  float normal_impulse;
+  float tangent_impulse;
+} SubstBodyContact;
+
+// Impulses a contact ended the last step with, keyed by the pair of collider
+// ids in either order.  Swapping the pair flips both the normal and the
+// tangent so the same impulses still apply.
+typedef struct {
+  uint64_t pair_key;
+  float normal_impulse;
+  float tangent_impulse;
+} SubstBodyImpulse;
+
+typedef struct {
+  float time_step;
+  float time_accumulator;
+  // How far rendering is between the last two steps, from 0 to 1
+  float interpolation;
+  uint32_t velocity_iterations;
+  float gravity_x, gravity_y;
+
+  // Every body owns the collider with the same id, colliders with no body
+  // act as static geometry.  Only the body world adds or removes colliders
+  // so that the two stay in step.
+  SubstCollisionWorld *colliders;
+
+  // Bodies are packed into parallel arrays so that integration can stream
+  // through them.  Positions are collider centers and the previous step's
+  // positions are kept for interpolation.  Bodies with no mass are never
+  // pushed, though they still move with whatever velocity they're given.
+  uint32_t count;
+  uint32_t capacity;
+  uint32_t *ids;
+  float *position_x;
+  float *position_y;
+  float *previous_x;
+  float *previous_y;
+  float *velocity_x;
+  float *velocity_y;
+  float *force_x;
+  float *force_y;
+  float *inverse_mass;
+  float *restitution;
+  float *friction;
+
+  // Maps each collider id to its body's index
+  uint32_t body_index_capacity;
+  uint32_t *body_indices;
+
+  uint32_t contact_capacity;
+  SubstBodyContact *contacts;
+
+  // Open addressed table of last step's impulses so that the solver can
+  // start each contact from where it left off rather than from nothing
+  uint32_t impulse_capacity;
+  SubstBodyImpulse *impulses;
+} SubstBodyWorld;
+
+SubstBodyWorld *subst_body_world_create(float time_step, float cell_size);
+void subst_body_world_free(SubstBodyWorld *world);
+
+// A mass of 0 makes a static body
+uint32_t subst_body_world_sphere_add(SubstBodyWorld *world, float x, float y,
+                                     float radius, float mass);
+uint32_t subst_body_world_box_add(SubstBodyWorld *world, float x, float y,
+                                  float width, float height, float mass);
+void subst_body_world_remove(SubstBodyWorld *world, uint32_t id);
+bool subst_body_world_contains(SubstBodyWorld *world, uint32_t id);
+
+// Static geometry is a bare collider that bodies collide with and that never
+// moves.  Removing an id that belongs to a body does nothing and returns
+// false.
+uint32_t subst_body_world_static_sphere_add(SubstBodyWorld *world, float x,
+                                            float y, float radius);
+uint32_t subst_body_world_static_box_add(SubstBodyWorld *world, float x,
+                                         float y, float width, float height);
+bool subst_body_world_static_remove(SubstBodyWorld *world, uint32_t id);
+
+// Spheres are positioned by their center and boxes by their min corner.
+// Setting the position moves the body without interpolating from where it
+// was.
+void subst_body_world_position_set(SubstBodyWorld *world, uint32_t id,
+                                   float x, float y);
+void subst_body_world_velocity_set(SubstBodyWorld *world, uint32_t id,
+                                   float x, float y);
+void subst_body_world_mass_set(SubstBodyWorld *world, uint32_t id,
+                               float mass);
+void subst_body_world_material_set(SubstBodyWorld *world, uint32_t id,
+                                   float restitution, float friction);
+void subst_body_world_impulse_apply(SubstBodyWorld *world, uint32_t id,
+                                    float x, float y);
+// Forces are applied over the next step and then cleared
+void subst_body_world_force_apply(SubstBodyWorld *world, uint32_t id, float x,
+                                  float y);
+
+// The position to draw the body at, between its last two steps
+void subst_body_world_render_position(SubstBodyWorld *world, uint32_t id,
+                                      float *x, float *y);
+
+// Stepping replaces the contacts and cast hits held by the collision world
+void subst_body_world_step(SubstBodyWorld *world);
+// Takes as many fixed steps as fit in the elapsed time, carrying the rest
+// over to the next update, and returns how many were taken
+uint32_t subst_body_world_update(SubstBodyWorld *world, float time_delta);
+
+void subst_body_module_init(VM *vm);
+
+#endif
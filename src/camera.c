@@ -0,0 +1,147 @@
+#include <cglm/cglm.h>
+#include <mesche.h>
+#include <stdlib.h>
+
+#include "camera.h"
+#include "log.h"
+
+SubstCamera *subst_camera_create(float x, float y, float zoom,
+                                 float rotation) {
+  SubstCamera *camera = malloc(sizeof(SubstCamera));
+  camera->position[0] = x;
+  camera->position[1] = y;
+  camera->zoom = zoom;
+  camera->rotation = rotation;
+  camera->version = 1;
+  camera->ref_count = 1;
+
+  return camera;
+}
+
+void subst_camera_retain(SubstCamera *camera) { camera->ref_count++; }
+
+void subst_camera_release(SubstCamera *camera) {
+  camera->ref_count--;
+  if (camera->ref_count == 0) {
+    free(camera);
+  }
+}
+
+void subst_camera_position_set(SubstCamera *camera, float x, float y) {
+  camera->position[0] = x;
+  camera->position[1] = y;
+  camera->version++;
+}
+
+void subst_camera_zoom_set(SubstCamera *camera, float zoom) {
+  camera->zoom = zoom;
+  camera->version++;
+}
+
+void subst_camera_rotation_set(SubstCamera *camera, float rotation) {
+  camera->rotation = rotation;
+  camera->version++;
+}
+
+void subst_camera_view_matrix(SubstCamera *camera, vec2 screen_size,
+                              float scale, mat4 dest) {
+  float zoom = camera->zoom * scale;
+
+  // Move the camera position to the origin, rotate and zoom around it, then
+  // put it in the center of the screen
+  glm_mat4_identity(dest);
+  glm_translate(dest,
+                (vec3){screen_size[0] / 2.f, screen_size[1] / 2.f, 0.f});
+  glm_scale(dest, (vec3){zoom, zoom, 1.f});
+  glm_rotate_z(dest, glm_rad(-camera->rotation), dest);
+  glm_translate(dest, (vec3){-camera->position[0], -camera->position[1], 0.f});
+}
+
+void camera_free_func(MescheMemory *mem, void *obj) {
+  subst_camera_release((SubstCamera *)obj);
+}
+
+const ObjectPointerType SubstCameraType = {.name = "camera",
+                                           .free_func = camera_free_func};
+
+Value subst_camera_create_msc(VM *vm, int arg_count, Value *args) {
+  if (arg_count != 4) {
+    subst_log("Function requires 4 parameters.");
+  }
+
+  float zoom = IS_NUMBER(args[2]) ? AS_NUMBER(args[2]) : 1.f;
+  float rotation = IS_NUMBER(args[3]) ? AS_NUMBER(args[3]) : 0.f;
+  SubstCamera *camera = subst_camera_create(AS_NUMBER(args[0]),
+                                            AS_NUMBER(args[1]), zoom, rotation);
+
+  return OBJECT_VAL(
+      mesche_object_make_pointer_type(vm, camera, &SubstCameraType));
+}
+
+Value subst_camera_position_set_msc(VM *vm, int arg_count, Value *args) {
+  if (arg_count != 3) {
+    subst_log("Function requires 3 parameters.");
+  }
+
+  SubstCamera *camera = (SubstCamera *)AS_POINTER(args[0])->ptr;
+  subst_camera_position_set(camera, AS_NUMBER(args[1]), AS_NUMBER(args[2]));
+
+  return UNSPECIFIED_VAL;
+}
+
+Value subst_camera_zoom_set_msc(VM *vm, int arg_count, Value *args) {
+  if (arg_count != 2) {
+    subst_log("Function requires 2 parameters.");
+  }
+
+  SubstCamera *camera = (SubstCamera *)AS_POINTER(args[0])->ptr;
+  subst_camera_zoom_set(camera, AS_NUMBER(args[1]));
+
+  return UNSPECIFIED_VAL;
+}
+
+Value subst_camera_rotation_set_msc(VM *vm, int arg_count, Value *args) {
+  if (arg_count != 2) {
+    subst_log("Function requires 2 parameters.");
+  }
+
+  SubstCamera *camera = (SubstCamera *)AS_POINTER(args[0])->ptr;
+  subst_camera_rotation_set(camera, AS_NUMBER(args[1]));
+
+  return UNSPECIFIED_VAL;
+}
+
+Value subst_camera_x_msc(VM *vm, int arg_count, Value *args) {
+  SubstCamera *camera = (SubstCamera *)AS_POINTER(args[0])->ptr;
+  return NUMBER_VAL(camera->position[0]);
+}
+
+Value subst_camera_y_msc(VM *vm, int arg_count, Value *args) {
+  SubstCamera *camera = (SubstCamera *)AS_POINTER(args[0])->ptr;
+  return NUMBER_VAL(camera->position[1]);
+}
+
+Value subst_camera_zoom_msc(VM *vm, int arg_count, Value *args) {
+  SubstCamera *camera = (SubstCamera *)AS_POINTER(args[0])->ptr;
+  return NUMBER_VAL(camera->zoom);
+}
+
+Value subst_camera_rotation_msc(VM *vm, int arg_count, Value *args) {
+  SubstCamera *camera = (SubstCamera *)AS_POINTER(args[0])->ptr;
+  return NUMBER_VAL(camera->rotation);
+}
+
+void subst_camera_module_init(VM *vm) {
+  mesche_vm_define_native_funcs(
+      vm, "substratic renderer",
+      (MescheNativeFuncDetails[]){
+          {"camera-create-internal", subst_camera_create_msc, true},
+          {"camera-position-set!", subst_camera_position_set_msc, true},
+          {"camera-zoom-set!", subst_camera_zoom_set_msc, true},
+          {"camera-rotation-set!", subst_camera_rotation_set_msc, true},
+          {"camera-x", subst_camera_x_msc, true},
+          {"camera-y", subst_camera_y_msc, true},
+          {"camera-zoom", subst_camera_zoom_msc, true},
+          {"camera-rotation", subst_camera_rotation_msc, true},
+          {NULL, NULL, false}});
+}
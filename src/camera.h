@@ -0,0 +1,37 @@
+#ifndef __subst_camera_h
+#define __subst_camera_h
+
+#include <cglm/cglm.h>
+#include <inttypes.h>
+#include <mesche.h>
+
+typedef struct {
+  // The world position that appears at the center of the screen
+  vec2 position;
+  float zoom;
+  float rotation;
+
+  // Bumped on every change so the renderer knows to rebuild its view
+  uint32_t version;
+
+  // Held by the script object and by a renderer using the camera, so that
+  // dropping the camera in script doesn't free it out from under the view
+  uint32_t ref_count;
+} SubstCamera;
+
+// The new camera starts out with a single reference
+SubstCamera *subst_camera_create(float x, float y, float zoom,
+                                 float rotation);
+void subst_camera_retain(SubstCamera *camera);
+// Frees the camera once its last reference is released
+void subst_camera_release(SubstCamera *camera);
+
+void subst_camera_position_set(SubstCamera *camera, float x, float y);
+void subst_camera_zoom_set(SubstCamera *camera, float zoom);
+void subst_camera_rotation_set(SubstCamera *camera, float rotation);
+void subst_camera_view_matrix(SubstCamera *camera, vec2 screen_size,
+                              float scale, mat4 dest);
+
+void subst_camera_module_init(VM *vm);
+
+#endif
@@ -0,0 +1,297 @@
+#include <glad/glad.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "capture.h"
+#include "log.h"
+#include "texture.h"
+#include "util.h"
+
+static void capture_job_process(SubstCaptureJob *job) {
+  unsigned char swap_bytes[1024];
+  size_t row_length = 4 * job->width;
+
+  // Flip the rows in place because OpenGL's coordinate system is flipped
+  for (uint32_t i = 0; i < job->height / 2; i++) {
+    unsigned char *top_row = &job->pixels[row_length * i];
+    unsigned char *bottom_row =
+        &job->pixels[row_length * (job->height - (i + 1))];
+
+    for (size_t offset = 0; offset < row_length;
+         offset += sizeof(swap_bytes)) {
+      size_t length = row_length - offset;
+      if (length > sizeof(swap_bytes)) {
+        length = sizeof(swap_bytes);
+      }
+
+      memcpy(swap_bytes, top_row + offset, length);
+      memcpy(top_row + offset, bottom_row + offset, length);
+      memcpy(bottom_row + offset, swap_bytes, length);
+    }
+  }
+
+  // Save image data to a PNG file
+  subst_texture_png_save(job->file_path, job->pixels, job->width,
+                         job->height);
+}
+
+static void capture_job_release(SubstCapture *capture, SubstCaptureJob *job) {
+  // Keep the job around so its pixel storage can be reused
+  free(job->file_path);
+  job->file_path = NULL;
+  job->next_job = capture->free_jobs;
+  capture->free_jobs = job;
+}
+
+#ifndef __EMSCRIPTEN__
+
+static void *capture_worker_main(void *data) {
+  SubstCapture *capture = (SubstCapture *)data;
+
+  pthread_mutex_lock(&capture->mutex);
+  while (true) {
+    while (capture->first_job == NULL && !capture->is_stopping) {
+      pthread_cond_wait(&capture->job_ready, &capture->mutex);
+    }
+
+    if (capture->first_job == NULL) {
+      break;
+    }
+
+    // Take the next job off of the queue
+    SubstCaptureJob *job = capture->first_job;
+    capture->first_job = job->next_job;
+    if (capture->first_job == NULL) {
+      capture->last_job = NULL;
+    }
+
+    // Do the expensive work without holding the lock
+    pthread_mutex_unlock(&capture->mutex);
+    capture_job_process(job);
+    pthread_mutex_lock(&capture->mutex);
+
+    capture_job_release(capture, job);
+    capture->jobs_in_progress--;
+    pthread_cond_broadcast(&capture->job_done);
+  }
+  pthread_mutex_unlock(&capture->mutex);
+
+  return NULL;
+}
+
+#endif
+
+SubstCapture *subst_capture_create(void) {
+  SubstCapture *capture = malloc(sizeof(SubstCapture));
+  memset(capture, 0, sizeof(SubstCapture));
+
+#ifndef __EMSCRIPTEN__
+  for (int i = 0; i < SUBST_CAPTURE_SLOT_COUNT; i++) {
+    glGenBuffers(1, &capture->slots[i].pixel_buffer);
+  }
+
+  pthread_mutex_init(&capture->mutex, NULL);
+  pthread_cond_init(&capture->job_ready, NULL);
+  pthread_cond_init(&capture->job_done, NULL);
+  if (pthread_create(&capture->worker_thread, NULL, capture_worker_main,
+                     capture) != 0) {
+    PANIC("Could not start the frame capture thread!\n");
+  }
+#endif
+
+  return capture;
+}
+
+static SubstCaptureJob *capture_job_acquire(SubstCapture *capture,
+                                            size_t pixels_size) {
+  SubstCaptureJob *job = NULL;
+
+#ifndef __EMSCRIPTEN__
+  pthread_mutex_lock(&capture->mutex);
+#endif
+  if (capture->free_jobs != NULL) {
+    job = capture->free_jobs;
+    capture->free_jobs = job->next_job;
+  }
+#ifndef __EMSCRIPTEN__
+  pthread_mutex_unlock(&capture->mutex);
+#endif
+
+  if (job == NULL) {
+    job = malloc(sizeof(SubstCaptureJob));
+    job->pixels = NULL;
+    job->pixels_size = 0;
+  }
+
+  // Only allocate when the frame is bigger than any seen before
+  if (job->pixels_size < pixels_size) {
+    free(job->pixels);
+    job->pixels = malloc(pixels_size);
+    job->pixels_size = pixels_size;
+  }
+
+  job->next_job = NULL;
+  return job;
+}
+
+#ifndef __EMSCRIPTEN__
+
+static void capture_job_enqueue(SubstCapture *capture, SubstCaptureJob *job) {
+  pthread_mutex_lock(&capture->mutex);
+  if (capture->last_job) {
+    capture->last_job->next_job = job;
+  } else {
+    capture->first_job = job;
+  }
+  capture->last_job = job;
+  capture->jobs_in_progress++;
+  pthread_cond_signal(&capture->job_ready);
+  pthread_mutex_unlock(&capture->mutex);
+}
+
+static void capture_slot_complete(SubstCapture *capture,
+                                  SubstCaptureSlot *slot) {
+  size_t image_data_size = 4 * slot->width * slot->height;
+  SubstCaptureJob *job = capture_job_acquire(capture, image_data_size);
+
+  // Copy the pixels out so that the buffer can be reused right away
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pixel_buffer);
+  void *pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, image_data_size,
+                                  GL_MAP_READ_BIT);
+  if (pixels != NULL) {
+    memcpy(job->pixels, pixels, image_data_size);
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  } else {
+    subst_log("Could not map frame capture buffer for: %s\n",
+              slot->file_path);
+    memset(job->pixels, 0, image_data_size);
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  glDeleteSync(slot->fence);
+  slot->fence = NULL;
+  slot->is_pending = false;
+
+  // Hand the frame off to the worker thread for flipping and encoding
+  job->width = slot->width;
+  job->height = slot->height;
+  job->file_path = slot->file_path;
+  slot->file_path = NULL;
+  capture_job_enqueue(capture, job);
+}
+
+static bool capture_slot_is_ready(SubstCaptureSlot *slot, GLuint64 timeout) {
+  GLenum result =
+      glClientWaitSync(slot->fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+  return result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED;
+}
+
+#endif
+
+void subst_capture_frame_request(SubstCapture *capture, uint32_t width,
+                                 uint32_t height, const char *file_path) {
+  size_t image_data_size = 4 * width * height;
+
+#ifdef __EMSCRIPTEN__
+  // WebGL can't map pixel buffers so read back and encode right away
+  SubstCaptureJob *job = capture_job_acquire(capture, image_data_size);
+  glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, job->pixels);
+  job->width = width;
+  job->height = height;
+  job->file_path = strdup(file_path);
+  capture_job_process(job);
+  capture_job_release(capture, job);
+#else
+  SubstCaptureSlot *slot = &capture->slots[capture->next_slot];
+  capture->next_slot = (capture->next_slot + 1) % SUBST_CAPTURE_SLOT_COUNT;
+
+  // Every slot is in flight so we have to wait for the oldest one
+  if (slot->is_pending) {
+    capture_slot_is_ready(slot, UINT64_MAX);
+    capture_slot_complete(capture, slot);
+  }
+
+  // Start an asynchronous copy of the framebuffer into the pixel buffer
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pixel_buffer);
+  if (slot->buffer_size != image_data_size) {
+    glBufferData(GL_PIXEL_PACK_BUFFER, image_data_size, NULL, GL_STREAM_READ);
+    slot->buffer_size = image_data_size;
+  }
+  glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  slot->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  slot->is_pending = true;
+  slot->width = width;
+  slot->height = height;
+  slot->file_path = strdup(file_path);
+#endif
+}
+
+void subst_capture_update(SubstCapture *capture) {
+#ifndef __EMSCRIPTEN__
+  // Collect finished readbacks from oldest to newest without blocking
+  for (int i = 0; i < SUBST_CAPTURE_SLOT_COUNT; i++) {
+    SubstCaptureSlot *slot =
+        &capture->slots[(capture->next_slot + i) % SUBST_CAPTURE_SLOT_COUNT];
+    if (slot->is_pending) {
+      if (!capture_slot_is_ready(slot, 0)) {
+        break;
+      }
+
+      capture_slot_complete(capture, slot);
+    }
+  }
+#endif
+}
+
+void subst_capture_flush(SubstCapture *capture) {
+#ifndef __EMSCRIPTEN__
+  // Wait for every readback to land
+  for (int i = 0; i < SUBST_CAPTURE_SLOT_COUNT; i++) {
+    SubstCaptureSlot *slot =
+        &capture->slots[(capture->next_slot + i) % SUBST_CAPTURE_SLOT_COUNT];
+    if (slot->is_pending) {
+      capture_slot_is_ready(slot, UINT64_MAX);
+      capture_slot_complete(capture, slot);
+    }
+  }
+
+  // Wait for the worker to write out every file
+  pthread_mutex_lock(&capture->mutex);
+  while (capture->jobs_in_progress > 0) {
+    pthread_cond_wait(&capture->job_done, &capture->mutex);
+  }
+  pthread_mutex_unlock(&capture->mutex);
+#endif
+}
+
+void subst_capture_free(SubstCapture *capture) {
+  subst_capture_flush(capture);
+
+#ifndef __EMSCRIPTEN__
+  // Stop the worker thread
+  pthread_mutex_lock(&capture->mutex);
+  capture->is_stopping = true;
+  pthread_cond_signal(&capture->job_ready);
+  pthread_mutex_unlock(&capture->mutex);
+  pthread_join(capture->worker_thread, NULL);
+
+  pthread_cond_destroy(&capture->job_done);
+  pthread_cond_destroy(&capture->job_ready);
+  pthread_mutex_destroy(&capture->mutex);
+
+  for (int i = 0; i < SUBST_CAPTURE_SLOT_COUNT; i++) {
+    glDeleteBuffers(1, &capture->slots[i].pixel_buffer);
+  }
+#endif
+
+  while (capture->free_jobs != NULL) {
+    SubstCaptureJob *job = capture->free_jobs;
+    capture->free_jobs = job->next_job;
+    free(job->pixels);
+    free(job);
+  }
+
+  free(capture);
+}
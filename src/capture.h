@@ -0,0 +1,62 @@
+#ifndef __subst_capture_h
+#define __subst_capture_h
+
+#include <glad/glad.h>
+#include <inttypes.h>
+#include <stdbool.h>
+
+#ifndef __EMSCRIPTEN__
+#include <pthread.h>
+#endif
+
+// How many frames can be in flight between glReadPixels and mapping
+#define SUBST_CAPTURE_SLOT_COUNT 3
+
+typedef struct {
+  GLuint pixel_buffer;
+  size_t buffer_size;
+  GLsync fence;
+  bool is_pending;
+  uint32_t width;
+  uint32_t height;
+  char *file_path;
+} SubstCaptureSlot;
+
+typedef struct SubstCaptureJob {
+  unsigned char *pixels;
+  size_t pixels_size;
+  uint32_t width;
+  uint32_t height;
+  char *file_path;
+  struct SubstCaptureJob *next_job;
+} SubstCaptureJob;
+
+typedef struct {
+  SubstCaptureSlot slots[SUBST_CAPTURE_SLOT_COUNT];
+  uint32_t next_slot;
+
+  // Jobs waiting to be flipped and encoded, and finished jobs whose pixel
+  // storage can be reused
+  SubstCaptureJob *first_job;
+  SubstCaptureJob *last_job;
+  SubstCaptureJob *free_jobs;
+  uint32_t jobs_in_progress;
+
+#ifndef __EMSCRIPTEN__
+  pthread_t worker_thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t job_ready;
+  pthread_cond_t job_done;
+  bool is_stopping;
+#endif
+} SubstCapture;
+
+SubstCapture *subst_capture_create(void);
+void subst_capture_free(SubstCapture *capture);
+
+void subst_capture_frame_request(SubstCapture *capture, uint32_t width,
+                                 uint32_t height, const char *file_path);
+void subst_capture_update(SubstCapture *capture);
+void subst_capture_flush(SubstCapture *capture);
+
+#endif
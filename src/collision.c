@@ -0,0 +1,905 @@
+#include <math.h>
+#include <mesche.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "collision.h"
+#include "log.h"
+
+#define COLLISION_INITIAL_CAPACITY 64
+#define COLLISION_INITIAL_CELL_CAPACITY 256
+#define COLLISION_DEFAULT_CELL_SIZE 64.f
+
+SubstCollisionWorld *subst_collision_world_create(float cell_size) {
+  SubstCollisionWorld *world = malloc(sizeof(SubstCollisionWorld));
+  memset(world, 0, sizeof(SubstCollisionWorld));
+
+  world->cell_size = cell_size > 0 ? cell_size : COLLISION_DEFAULT_CELL_SIZE;
+  world->inv_cell_size = 1.f / world->cell_size;
+
+  world->cell_capacity = COLLISION_INITIAL_CELL_CAPACITY;
+  world->cells = calloc(world->cell_capacity, sizeof(SubstCollisionCell));
+  subst_collision_batch_init(&world->sphere_candidates);
+  subst_collision_batch_init(&world->sphere_box_candidates);
+  subst_collision_batch_init(&world->box_candidates);
+  subst_contact_set_init(&world->contacts);
+  subst_cast_hits_init(&world->cast_hits);
+
+  return world;
+}
+
+void subst_collision_world_free(SubstCollisionWorld *world) {
+  for (uint32_t i = 0; i < world->cell_capacity; i++) {
+    free(world->cells[i].ids);
+  }
+
+  free(world->cells);
+  free(world->shapes);
+  free(world->center_x);
+  free(world->center_y);
+  free(world->half_width);
+  free(world->half_height);
+  free(world->ids);
+  free(world->cell_ranges);
+  free(world->id_indices);
+  free(world->free_ids);
+  subst_collision_batch_free(&world->sphere_candidates);
+  subst_collision_batch_free(&world->sphere_box_candidates);
+  subst_collision_batch_free(&world->box_candidates);
+  subst_contact_set_free(&world->contacts);
+  free(world->cast_stamps);
+  subst_cast_hits_free(&world->cast_hits);
+  free(world);
+}
+
+static inline uint32_t collision_cell_hash(int32_t x, int32_t y) {
+  return ((uint32_t)x * 73856093u) ^ ((uint32_t)y * 19349663u);
+}
+
+static SubstCollisionCell *collision_cell_slot(SubstCollisionCell *cells,
+                                               uint32_t capacity, int32_t x,
+                                               int32_t y) {
+  // Probe linearly from the hashed slot until the cell or a free slot turns
+  // up, the table is never more than half full
+  uint32_t mask = capacity - 1;
+  uint32_t index = collision_cell_hash(x, y) & mask;
+  while (cells[index].is_used &&
+         (cells[index].x != x || cells[index].y != y)) {
+    index = (index + 1) & mask;
+  }
+
+  return &cells[index];
+}
+
+static void collision_cell_bounds_add(SubstCollisionWorld *world, int32_t x,
+                                      int32_t y) {
+  SubstCollisionCellRange *bounds = &world->cell_bounds;
+  if (world->cell_count++ == 0) {
+    *bounds = (SubstCollisionCellRange){x, y, x, y};
+  } else {
+    bounds->min_x = x < bounds->min_x ? x : bounds->min_x;
+    bounds->min_y = y < bounds->min_y ? y : bounds->min_y;
+    bounds->max_x = x > bounds->max_x ? x : bounds->max_x;
+    bounds->max_y = y > bounds->max_y ? y : bounds->max_y;
+  }
+}
+
+static void collision_cells_rehash(SubstCollisionWorld *world) {
+  // Size the table by the occupied cells alone so that it is at most a
+  // quarter full afterwards, which keeps rehashing rare
+  uint32_t occupied_count = 0;
+  for (uint32_t i = 0; i < world->cell_capacity; i++) {
+    if (world->cells[i].is_used && world->cells[i].count > 0) {
+      occupied_count++;
+    }
+  }
+
+  uint32_t capacity = COLLISION_INITIAL_CELL_CAPACITY;
+  while ((occupied_count + 1) * 4 > capacity) {
+    capacity *= 2;
+  }
+
+  SubstCollisionCell *cells = calloc(capacity, sizeof(SubstCollisionCell));
+  world->cell_count = 0;
+  for (uint32_t i = 0; i < world->cell_capacity; i++) {
+    SubstCollisionCell *cell = &world->cells[i];
+    if (!cell->is_used) {
+      continue;
+    }
+
+    if (cell->count == 0) {
+      free(cell->ids);
+      continue;
+    }
+
+    *collision_cell_slot(cells, capacity, cell->x, cell->y) = *cell;
+    collision_cell_bounds_add(world, cell->x, cell->y);
+  }
+
+  free(world->cells);
+  world->cells = cells;
+  world->cell_capacity = capacity;
+}
+
+static SubstCollisionCell *collision_cell_get(SubstCollisionWorld *world,
+                                              int32_t x, int32_t y) {
+  if ((world->cell_count + 1) * 2 > world->cell_capacity) {
+    collision_cells_rehash(world);
+  }
+
+  // Empty cells are only dropped when the table fills up so that colliders
+  // moving back and forth don't churn it
+  SubstCollisionCell *cell =
+      collision_cell_slot(world->cells, world->cell_capacity, x, y);
+  if (!cell->is_used) {
+    cell->is_used = true;
+    cell->x = x;
+    cell->y = y;
+    collision_cell_bounds_add(world, x, y);
+  }
+
+  return cell;
+}
+
+static SubstCollisionCell *collision_cell_find(SubstCollisionWorld *world,
+                                               int32_t x, int32_t y) {
+  SubstCollisionCell *cell =
+      collision_cell_slot(world->cells, world->cell_capacity, x, y);
+  return cell->is_used ? cell : NULL;
+}
+
+static void collision_cell_id_add(SubstCollisionCell *cell, uint32_t id) {
+  if (cell->count == cell->capacity) {
+    cell->capacity = cell->capacity == 0 ? 8 : cell->capacity * 2;
+    cell->ids = realloc(cell->ids, sizeof(uint32_t) * cell->capacity);
+  }
+
+  cell->ids[cell->count++] = id;
+}
+
+static void collision_cell_id_remove(SubstCollisionCell *cell, uint32_t id) {
+  for (uint32_t i = 0; i < cell->count; i++) {
+    if (cell->ids[i] == id) {
+      cell->ids[i] = cell->ids[--cell->count];
+      return;
+    }
+  }
+}
+
+static SubstCollisionCellRange collision_cell_range(SubstCollisionWorld *world,
+                                                    uint32_t index) {
+  float x = world->center_x[index], y = world->center_y[index];
+  float half_width = world->half_width[index];
+  float half_height = world->half_height[index];
+
+  return (SubstCollisionCellRange){
+      .min_x = (int32_t)floorf((x - half_width) * world->inv_cell_size),
+      .min_y = (int32_t)floorf((y - half_height) * world->inv_cell_size),
+      .max_x = (int32_t)floorf((x + half_width) * world->inv_cell_size),
+      .max_y = (int32_t)floorf((y + half_height) * world->inv_cell_size)};
+}
+
+static void collision_cells_insert(SubstCollisionWorld *world, uint32_t id,
+                                   SubstCollisionCellRange range) {
+  for (int32_t y = range.min_y; y <= range.max_y; y++) {
+    for (int32_t x = range.min_x; x <= range.max_x; x++) {
+      collision_cell_id_add(collision_cell_get(world, x, y), id);
+    }
+  }
+}
+
+static void collision_cells_remove(SubstCollisionWorld *world, uint32_t id,
+                                   SubstCollisionCellRange range) {
+  for (int32_t y = range.min_y; y <= range.max_y; y++) {
+    for (int32_t x = range.min_x; x <= range.max_x; x++) {
+      // Cells holding a collider are never dropped so this always finds one
+      SubstCollisionCell *cell = collision_cell_find(world, x, y);
+      if (cell != NULL) {
+        collision_cell_id_remove(cell, id);
+      }
+    }
+  }
+}
+
+static void collision_world_reserve(SubstCollisionWorld *world) {
+  if (world->count < world->capacity) {
+    return;
+  }
+
+  world->capacity = world->capacity == 0 ? COLLISION_INITIAL_CAPACITY
+                                         : world->capacity * 2;
+  world->shapes =
+      realloc(world->shapes, sizeof(SubstCollisionShape) * world->capacity);
+  world->center_x =
+      realloc(world->center_x, sizeof(float) * world->capacity);
+  world->center_y =
+      realloc(world->center_y, sizeof(float) * world->capacity);
+  world->half_width =
+      realloc(world->half_width, sizeof(float) * world->capacity);
+  world->half_height =
+      realloc(world->half_height, sizeof(float) * world->capacity);
+  world->ids = realloc(world->ids, sizeof(uint32_t) * world->capacity);
+  world->cell_ranges = realloc(
+      world->cell_ranges, sizeof(SubstCollisionCellRange) * world->capacity);
+}
+
+static uint32_t collision_world_id_acquire(SubstCollisionWorld *world) {
+  if (world->free_id_count > 0) {
+    return world->free_ids[--world->free_id_count];
+  }
+
+  if (world->id_count == world->id_capacity) {
+    uint32_t old_capacity = world->id_capacity;
+    world->id_capacity = world->id_capacity == 0 ? COLLISION_INITIAL_CAPACITY
+                                                 : world->id_capacity * 2;
+    world->id_indices =
+        realloc(world->id_indices, sizeof(uint32_t) * world->id_capacity);
+    world->free_ids =
+        realloc(world->free_ids, sizeof(uint32_t) * world->id_capacity);
+    world->cast_stamps =
+        realloc(world->cast_stamps, sizeof(uint32_t) * world->id_capacity);
+    memset(world->cast_stamps + old_capacity, 0,
+           sizeof(uint32_t) * (world->id_capacity - old_capacity));
+  }
+
+  return world->id_count++;
+}
+
+bool subst_collision_world_contains(SubstCollisionWorld *world, uint32_t id) {
+  return id < world->id_count &&
+         world->id_indices[id] != SUBST_COLLISION_INVALID_ID;
+}
+
+static uint32_t collision_world_collider_add(SubstCollisionWorld *world,
+                                             SubstCollisionShape shape,
+                                             float x, float y,
+                                             float half_width,
+                                             float half_height) {
+  collision_world_reserve(world);
+
+  uint32_t id = collision_world_id_acquire(world);
+  uint32_t index = world->count++;
+  world->id_indices[id] = index;
+  world->ids[index] = id;
+  world->shapes[index] = shape;
+  world->center_x[index] = x;
+  world->center_y[index] = y;
+  world->half_width[index] = half_width;
+  world->half_height[index] = half_height;
+  world->cell_ranges[index] = collision_cell_range(world, index);
+  collision_cells_insert(world, id, world->cell_ranges[index]);
+
+  return id;
+}
+
+uint32_t subst_collision_world_add(SubstCollisionWorld *world, float x,
+                                   float y, float radius) {
+  return collision_world_collider_add(world, SUBST_COLLISION_SHAPE_SPHERE, x,
+                                      y, radius, radius);
+}
+
+uint32_t subst_collision_world_box_add(SubstCollisionWorld *world, float x,
+                                       float y, float width, float height) {
+  return collision_world_collider_add(world, SUBST_COLLISION_SHAPE_BOX,
+                                      x + width * 0.5f, y + height * 0.5f,
+                                      width * 0.5f, height * 0.5f);
+}
+
+void subst_collision_world_remove(SubstCollisionWorld *world, uint32_t id) {
+  if (!subst_collision_world_contains(world, id)) {
+    return;
+  }
+
+  uint32_t index = world->id_indices[id];
+  collision_cells_remove(world, id, world->cell_ranges[index]);
+
+  // Move the last collider into the hole to keep the arrays packed
+  uint32_t last = --world->count;
+  if (index != last) {
+    world->shapes[index] = world->shapes[last];
+    world->center_x[index] = world->center_x[last];
+    world->center_y[index] = world->center_y[last];
+    world->half_width[index] = world->half_width[last];
+    world->half_height[index] = world->half_height[last];
+    world->ids[index] = world->ids[last];
+    world->cell_ranges[index] = world->cell_ranges[last];
+    world->id_indices[world->ids[index]] = index;
+  }
+
+  world->id_indices[id] = SUBST_COLLISION_INVALID_ID;
+  world->free_ids[world->free_id_count++] = id;
+}
+
+static void collision_world_cells_update(SubstCollisionWorld *world,
+                                         uint32_t id, uint32_t index) {
+  SubstCollisionCellRange old_range = world->cell_ranges[index];
+  SubstCollisionCellRange new_range = collision_cell_range(world, index);
+
+  // Most moves stay within the same cells
+  if (memcmp(&old_range, &new_range, sizeof(SubstCollisionCellRange)) == 0) {
+    return;
+  }
+
+  collision_cells_remove(world, id, old_range);
+  collision_cells_insert(world, id, new_range);
+  world->cell_ranges[index] = new_range;
+}
+
+void subst_collision_world_move(SubstCollisionWorld *world, uint32_t id,
+                                float x, float y) {
+  if (!subst_collision_world_contains(world, id)) {
+    return;
+  }
+
+  uint32_t index = world->id_indices[id];
+  if (world->shapes[index] == SUBST_COLLISION_SHAPE_BOX) {
+    x += world->half_width[index];
+    y += world->half_height[index];
+  }
+
+  world->center_x[index] = x;
+  world->center_y[index] = y;
+  collision_world_cells_update(world, id, index);
+}
+
+void subst_collision_world_radius_set(SubstCollisionWorld *world, uint32_t id,
+                                      float radius) {
+  if (!subst_collision_world_contains(world, id)) {
+    return;
+  }
+
+  uint32_t index = world->id_indices[id];
+  if (world->shapes[index] != SUBST_COLLISION_SHAPE_SPHERE) {
+    return;
+  }
+
+  world->half_width[index] = radius;
+  world->half_height[index] = radius;
+  collision_world_cells_update(world, id, index);
+}
+
+static void collision_world_candidate_add(SubstCollisionWorld *world,
+                                          uint32_t a, uint32_t b) {
+  SubstCollisionBatch *batch = &world->sphere_candidates;
+  if (world->shapes[a] == SUBST_COLLISION_SHAPE_BOX) {
+    // Sphere and box pairs always list the sphere first
+    if (world->shapes[b] == SUBST_COLLISION_SHAPE_SPHERE) {
+      uint32_t swap = a;
+      a = b;
+      b = swap;
+      batch = &world->sphere_box_candidates;
+    } else {
+      batch = &world->box_candidates;
+    }
+  } else if (world->shapes[b] == SUBST_COLLISION_SHAPE_BOX) {
+    batch = &world->sphere_box_candidates;
+  }
+
+  subst_collision_batch_add(
+      batch, world->ids[a], world->center_x[a], world->center_y[a],
+      world->half_width[a], world->half_height[a], world->ids[b],
+      world->center_x[b], world->center_y[b], world->half_width[b],
+      world->half_height[b]);
+}
+
+static void collision_world_candidates_find(SubstCollisionWorld *world) {
+  world->sphere_candidates.count = 0;
+  world->sphere_box_candidates.count = 0;
+  world->box_candidates.count = 0;
+
+  for (uint32_t c = 0; c < world->cell_capacity; c++) {
+    SubstCollisionCell *cell = &world->cells[c];
+    if (cell->count < 2) {
+      continue;
+    }
+
+    for (uint32_t i = 0; i < cell->count; i++) {
+      uint32_t a = world->id_indices[cell->ids[i]];
+      SubstCollisionCellRange *range_a = &world->cell_ranges[a];
+
+      for (uint32_t j = i + 1; j < cell->count; j++) {
+        uint32_t b = world->id_indices[cell->ids[j]];
+        SubstCollisionCellRange *range_b = &world->cell_ranges[b];
+
+        // Colliders that share several cells are only tested in the cell
+        // at the corner of the range they share
+        int32_t corner_x =
+            range_a->min_x > range_b->min_x ? range_a->min_x : range_b->min_x;
+        int32_t corner_y =
+            range_a->min_y > range_b->min_y ? range_a->min_y : range_b->min_y;
+        if (corner_x != cell->x || corner_y != cell->y) {
+          continue;
+        }
+
+        // Only pairs whose bounds overlap go on to the narrowphase
+        float reach_x = world->half_width[a] + world->half_width[b];
+        float reach_y = world->half_height[a] + world->half_height[b];
+        if (fabsf(world->center_x[a] - world->center_x[b]) <= reach_x &&
+            fabsf(world->center_y[a] - world->center_y[b]) <= reach_y) {
+          collision_world_candidate_add(world, a, b);
+        }
+      }
+    }
+  }
+}
+
+uint32_t subst_collision_world_pairs_find(SubstCollisionWorld *world) {
+  collision_world_candidates_find(world);
+
+  world->contacts.count = 0;
+  subst_narrowphase_spheres(&world->sphere_candidates, &world->contacts);
+  subst_narrowphase_sphere_boxes(&world->sphere_box_candidates,
+                                 &world->contacts);
+  subst_narrowphase_boxes(&world->box_candidates, &world->contacts);
+
+  return world->contacts.count;
+}
+
+static void collision_world_cast_cell(SubstCollisionWorld *world,
+                                      const SubstCast *cast,
+                                      SubstCollisionCell *cell,
+                                      bool nearest_only) {
+  SubstCastHits *hits = &world->cast_hits;
+  for (uint32_t i = 0; i < cell->count; i++) {
+    uint32_t id = cell->ids[i];
+    if (world->cast_stamps[id] == world->cast_stamp ||
+        id == cast->ignore_id) {
+      continue;
+    }
+    world->cast_stamps[id] = world->cast_stamp;
+
+    uint32_t index = world->id_indices[id];
+    float x = world->center_x[index], y = world->center_y[index];
+    float half_width = world->half_width[index];
+    float half_height = world->half_height[index];
+    SubstCastHit hit;
+    bool is_hit =
+        world->shapes[index] == SUBST_COLLISION_SHAPE_SPHERE
+            ? subst_cast_sphere(cast, x, y, half_width, &hit)
+            : subst_cast_box(cast, x - half_width, y - half_height,
+                             x + half_width, y + half_height, &hit);
+    if (!is_hit) {
+      continue;
+    }
+
+    hit.id = id;
+    if (!nearest_only || hits->count == 0) {
+      subst_cast_hits_add(hits, &hit);
+    } else if (hit.distance < hits->hits[0].distance) {
+      hits->hits[0] = hit;
+    }
+  }
+}
+
+uint32_t subst_collision_world_cast(SubstCollisionWorld *world,
+                                    const SubstCast *cast, bool nearest_only) {
+  SubstCastHits *hits = &world->cast_hits;
+  hits->count = 0;
+  if (world->cell_count == 0) {
+    return 0;
+  }
+
+  // Clip the cast to the cells in the table, grown by the cast's radius, so
+  // that rays which never stop still end and ones that start far away don't
+  // walk through empty cells
+  float cell_size = world->cell_size;
+  SubstCollisionCellRange *bounds = &world->cell_bounds;
+  float start, end;
+  if (!subst_cast_bounds(cast, bounds->min_x * cell_size - cast->radius,
+                         bounds->min_y * cell_size - cast->radius,
+                         (bounds->max_x + 1) * cell_size + cast->radius,
+                         (bounds->max_y + 1) * cell_size + cast->radius,
+                         &start, &end)) {
+    return 0;
+  }
+  start = start > 0 ? start : 0;
+  end = end < cast->max_distance ? end : cast->max_distance;
+
+  if (++world->cast_stamp == 0) {
+    memset(world->cast_stamps, 0, sizeof(uint32_t) * world->id_capacity);
+    world->cast_stamp = 1;
+  }
+
+  // A swept circle can touch colliders in any cell this many cells away from
+  // the one its center is passing through
+  int32_t spread = (int32_t)ceilf(cast->radius * world->inv_cell_size);
+
+  // Step from cell to cell along the line in the order the cast enters them
+  float direction_x = cast->direction_x, direction_y = cast->direction_y;
+  float x = cast->origin_x + direction_x * start;
+  float y = cast->origin_y + direction_y * start;
+  int32_t cell_x = (int32_t)floorf(x * world->inv_cell_size);
+  int32_t cell_y = (int32_t)floorf(y * world->inv_cell_size);
+  int32_t step_x = direction_x > 0 ? 1 : -1;
+  int32_t step_y = direction_y > 0 ? 1 : -1;
+  float next_x = INFINITY, next_y = INFINITY;
+  float delta_x = INFINITY, delta_y = INFINITY;
+  if (fabsf(direction_x) > 1e-8f) {
+    next_x = start + ((cell_x + (step_x > 0)) * cell_size - x) / direction_x;
+    delta_x = cell_size / fabsf(direction_x);
+  }
+  if (fabsf(direction_y) > 1e-8f) {
+    next_y = start + ((cell_y + (step_y > 0)) * cell_size - y) / direction_y;
+    delta_y = cell_size / fabsf(direction_y);
+  }
+
+  float cell_enter = start;
+  while (cell_enter <= end) {
+    // Any collider nearer than the best hit so far would have been found in
+    // a cell the cast entered before reaching it
+    if (nearest_only && hits->count > 0 &&
+        cell_enter > hits->hits[0].distance) {
+      break;
+    }
+
+    for (int32_t near_y = cell_y - spread; near_y <= cell_y + spread;
+         near_y++) {
+      for (int32_t near_x = cell_x - spread; near_x <= cell_x + spread;
+           near_x++) {
+        SubstCollisionCell *cell = collision_cell_find(world, near_x, near_y);
+        if (cell != NULL) {
+          collision_world_cast_cell(world, cast, cell, nearest_only);
+        }
+      }
+    }
+
+    if (next_x < next_y) {
+      cell_enter = next_x;
+      cell_x += step_x;
+      next_x += delta_x;
+    } else {
+      cell_enter = next_y;
+      cell_y += step_y;
+      next_y += delta_y;
+    }
+  }
+
+  if (!nearest_only) {
+    subst_cast_hits_sort(hits);
+  }
+
+  return hits->count;
+}
+
+void collision_world_free_func(MescheMemory *mem, void *obj) {
+  subst_collision_world_free((SubstCollisionWorld *)obj);
+}
+
+const ObjectPointerType SubstCollisionWorldType = {
+    .name = "collision-world", .free_func = collision_world_free_func};
+
+Value subst_collision_world_create_msc(VM *vm, int arg_count, Value *args) {
+  if (arg_count != 1) {
+    subst_log("Function requires 1 parameter.");
+  }
+
+  SubstCollisionWorld *world =
+      subst_collision_world_create(IS_NUMBER(args[0]) ? AS_NUMBER(args[0]) : 0);
+
+  return OBJECT_VAL(
+      mesche_object_make_pointer_type(vm, world, &SubstCollisionWorldType));
+}
+
+Value subst_collision_world_add_msc(VM *vm, int arg_count, Value *args) {
+  if (arg_count != 4) {
+    subst_log("Function requires 4 parameters.");
+  }
+
+  SubstCollisionWorld *world = (SubstCollisionWorld *)AS_POINTER(args[0])->ptr;
+  return NUMBER_VAL(subst_collision_world_add(
+      world, AS_NUMBER(args[1]), AS_NUMBER(args[2]), AS_NUMBER(args[3])));
+}
+
+Value subst_collision_world_sphere_add_msc(VM *vm, int arg_count,
+                                           Value *args) {
+  if (arg_count != 2) {
+    subst_log("Function requires 2 parameters.");
+  }
+
+  // The world keeps its own copy, moving the sphere later won't move it
+  SubstCollisionWorld *world = (SubstCollisionWorld *)AS_POINTER(args[0])->ptr;
+  SubstSphere *sphere = (SubstSphere *)AS_POINTER(args[1])->ptr;
+  return NUMBER_VAL(subst_collision_world_add(
+      world, sphere->center_x, sphere->center_y, sphere->radius));
+}
+
+Value subst_collision_world_box_add_msc(VM *vm, int arg_count, Value *args) {
+  if (arg_count != 2) {
+    subst_log("Function requires 2 parameters.");
+  }
+
+  SubstCollisionWorld *world = (SubstCollisionWorld *)AS_POINTER(args[0])->ptr;
+  SubstBox *box = (SubstBox *)AS_POINTER(args[1])->ptr;
+  return NUMBER_VAL(subst_collision_world_box_add(
+      world, box->bounds[0][0], box->bounds[0][1],
+      box->bounds[1][0] - box->bounds[0][0],
+      box->bounds[1][1] - box->bounds[0][1]));
+}
+
+Value subst_collision_world_remove_msc(VM *vm, int arg_count, Value *args) {
+  if (arg_count != 2) {
+    subst_log("Function requires 2 parameters.");
+  }
+
+  SubstCollisionWorld *world = (SubstCollisionWorld *)AS_POINTER(args[0])->ptr;
+  uint32_t id = AS_NUMBER(args[1]);
+  if (!subst_collision_world_contains(world, id)) {
+    return FALSE_VAL;
+  }
+
+  subst_collision_world_remove(world, id);
+
+  return TRUE_VAL;
+}
+
+Value subst_collision_world_move_msc(VM *vm, int arg_count, Value *args) {
+  if (arg_count != 4) {
+    subst_log("Function requires 4 parameters.");
+  }
+
+  SubstCollisionWorld *world = (SubstCollisionWorld *)AS_POINTER(args[0])->ptr;
+  subst_collision_world_move(world, AS_NUMBER(args[1]), AS_NUMBER(args[2]),
+                             AS_NUMBER(args[3]));
+
+  return TRUE_VAL;
+}
+
+Value subst_collision_world_radius_set_msc(VM *vm, int arg_count,
+                                           Value *args) {
+  if (arg_count != 3) {
+    subst_log("Function requires 3 parameters.");
+  }
+
+  SubstCollisionWorld *world = (SubstCollisionWorld *)AS_POINTER(args[0])->ptr;
+  subst_collision_world_radius_set(world, AS_NUMBER(args[1]),
+                                   AS_NUMBER(args[2]));
+
+  return TRUE_VAL;
+}
+
+Value subst_collision_world_count_msc(VM *vm, int arg_count, Value *args) {
+  if (arg_count != 1) {
+    subst_log("Function requires 1 parameter.");
+  }
+
+  SubstCollisionWorld *world = (SubstCollisionWorld *)AS_POINTER(args[0])->ptr;
+  return NUMBER_VAL(world->count);
+}
+
+Value subst_collision_world_pairs_find_msc(VM *vm, int arg_count,
+                                           Value *args) {
+  if (arg_count != 1) {
+    subst_log("Function requires 1 parameter.");
+  }
+
+  SubstCollisionWorld *world = (SubstCollisionWorld *)AS_POINTER(args[0])->ptr;
+  return NUMBER_VAL(subst_collision_world_pairs_find(world));
+}
+
+// Returns the contact set of the world along with the index argument, or
+// false when the index is out of range
+static bool collision_world_contact_arg(Value *args,
+                                        SubstContactSet **contacts,
+                                        uint32_t *index) {
+  SubstCollisionWorld *world = (SubstCollisionWorld *)AS_POINTER(args[0])->ptr;
+  int contact_index = AS_NUMBER(args[1]);
+  if (contact_index < 0 ||
+      (uint32_t)contact_index >= world->contacts.count) {
+    return false;
+  }
+
+  *contacts = &world->contacts;
+  *index = contact_index;
+  return true;
+}
+
+Value subst_collision_world_pair_first_msc(VM *vm, int arg_count,
+                                           Value *args) {
+  if (arg_count != 2) {
+    subst_log("Function requires 2 parameters.");
+  }
+
+  SubstContactSet *contacts;
+  uint32_t index;
+  if (!collision_world_contact_arg(args, &contacts, &index)) {
+    return FALSE_VAL;
+  }
+
+  return NUMBER_VAL(contacts->first[index]);
+}
+
+Value subst_collision_world_pair_second_msc(VM *vm, int arg_count,
+                                            Value *args) {
+  if (arg_count != 2) {
+    subst_log("Function requires 2 parameters.");
+  }
+
+  SubstContactSet *contacts;
+  uint32_t index;
+  if (!collision_world_contact_arg(args, &contacts, &index)) {
+    return FALSE_VAL;
+  }
+
+  return NUMBER_VAL(contacts->second[index]);
+}
+
+Value subst_collision_world_contact_normal_x_msc(VM *vm, int arg_count,
+                                                 Value *args) {
+  if (arg_count != 2) {
+    subst_log("Function requires 2 parameters.");
+  }
+
+  SubstContactSet *contacts;
+  uint32_t index;
+  if (!collision_world_contact_arg(args, &contacts, &index)) {
+    return FALSE_VAL;
+  }
+
+  return NUMBER_VAL(contacts->normal_x[index]);
+}
+
+Value subst_collision_world_contact_normal_y_msc(VM *vm, int arg_count,
+                                                 Value *args) {
+  if (arg_count != 2) {
+    subst_log("Function requires 2 parameters.");
+  }
+
+  SubstContactSet *contacts;
+  uint32_t index;
+  if (!collision_world_contact_arg(args, &contacts, &index)) {
+    return FALSE_VAL;
+  }
+
+  return NUMBER_VAL(contacts->normal_y[index]);
+}
+
+Value subst_collision_world_contact_depth_msc(VM *vm, int arg_count,
+                                              Value *args) {
+  if (arg_count != 2) {
+    subst_log("Function requires 2 parameters.");
+  }
+
+  SubstContactSet *contacts;
+  uint32_t index;
+  if (!collision_world_contact_arg(args, &contacts, &index)) {
+    return FALSE_VAL;
+  }
+
+  return NUMBER_VAL(contacts->depth[index]);
+}
+
+// Fills in the id to skip from the cast natives' trailing arguments and runs
+// the cast, keeping every hit unless the last argument is true
+static uint32_t collision_world_cast_run(SubstCollisionWorld *world,
+                                         SubstCast *cast, Value *args) {
+  if (IS_NUMBER(args[0])) {
+    cast->ignore_id = AS_NUMBER(args[0]);
+  }
+
+  return subst_collision_world_cast(world, cast, !IS_FALSE(args[1]));
+}
+
+Value subst_collision_world_ray_cast_msc(VM *vm, int arg_count, Value *args) {
+  if (arg_count != 9) {
+    subst_log("Function requires 9 parameters.");
+  }
+
+  SubstCollisionWorld *world = (SubstCollisionWorld *)AS_POINTER(args[0])->ptr;
+  SubstCast cast;
+  subst_cast_init(&cast, AS_NUMBER(args[1]), AS_NUMBER(args[2]),
+                  AS_NUMBER(args[3]), AS_NUMBER(args[4]),
+                  IS_NUMBER(args[5]) ? AS_NUMBER(args[5]) : INFINITY,
+                  IS_NUMBER(args[6]) ? AS_NUMBER(args[6]) : 0);
+
+  return NUMBER_VAL(collision_world_cast_run(world, &cast, &args[7]));
+}
+
+Value subst_collision_world_segment_cast_msc(VM *vm, int arg_count,
+                                             Value *args) {
+  if (arg_count != 8) {
+    subst_log("Function requires 8 parameters.");
+  }
+
+  SubstCollisionWorld *world = (SubstCollisionWorld *)AS_POINTER(args[0])->ptr;
+  SubstCast cast;
+  subst_cast_segment_init(&cast, AS_NUMBER(args[1]), AS_NUMBER(args[2]),
+                          AS_NUMBER(args[3]), AS_NUMBER(args[4]),
+                          IS_NUMBER(args[5]) ? AS_NUMBER(args[5]) : 0);
+
+  return NUMBER_VAL(collision_world_cast_run(world, &cast, &args[6]));
+}
+
+// Returns the hit at the index argument from the last cast, or NULL when the
+// index is out of range
+static SubstCastHit *collision_world_cast_hit_arg(Value *args) {
+  SubstCollisionWorld *world = (SubstCollisionWorld *)AS_POINTER(args[0])->ptr;
+  int hit_index = AS_NUMBER(args[1]);
+  if (hit_index < 0 || (uint32_t)hit_index >= world->cast_hits.count) {
+    return NULL;
+  }
+
+  return &world->cast_hits.hits[hit_index];
+}
+
+Value subst_collision_world_cast_hit_id_msc(VM *vm, int arg_count,
+                                            Value *args) {
+  if (arg_count != 2) {
+    subst_log("Function requires 2 parameters.");
+  }
+
+  SubstCastHit *hit = collision_world_cast_hit_arg(args);
+  return hit != NULL ? NUMBER_VAL(hit->id) : FALSE_VAL;
+}
+
+Value subst_collision_world_cast_hit_distance_msc(VM *vm, int arg_count,
+                                                  Value *args) {
+  if (arg_count != 2) {
+    subst_log("Function requires 2 parameters.");
+  }
+
+  SubstCastHit *hit = collision_world_cast_hit_arg(args);
+  return hit != NULL ? NUMBER_VAL(hit->distance) : FALSE_VAL;
+}
+
+Value subst_collision_world_cast_hit_normal_x_msc(VM *vm, int arg_count,
+                                                  Value *args) {
+  if (arg_count != 2) {
+    subst_log("Function requires 2 parameters.");
+  }
+
+  SubstCastHit *hit = collision_world_cast_hit_arg(args);
+  return hit != NULL ? NUMBER_VAL(hit->normal_x) : FALSE_VAL;
+}
+
+Value subst_collision_world_cast_hit_normal_y_msc(VM *vm, int arg_count,
+                                                  Value *args) {
+  if (arg_count != 2) {
+    subst_log("Function requires 2 parameters.");
+  }
+
+  SubstCastHit *hit = collision_world_cast_hit_arg(args);
+  return hit != NULL ? NUMBER_VAL(hit->normal_y) : FALSE_VAL;
+}
+
+void subst_collision_module_init(VM *vm) {
+  mesche_vm_define_native_funcs(
+      vm, "substratic physics",
+      (MescheNativeFuncDetails[]){
+          {"collision-world-create-internal",
+           subst_collision_world_create_msc, false},
+          {"collision-world-add!", subst_collision_world_add_msc, true},
+          {"collision-world-sphere-add!",
+           subst_collision_world_sphere_add_msc, true},
+          {"collision-world-box-add!", subst_collision_world_box_add_msc,
+           true},
+          {"collision-world-remove!", subst_collision_world_remove_msc, true},
+          {"collision-world-move!", subst_collision_world_move_msc, true},
+          {"collision-world-radius-set!",
+           subst_collision_world_radius_set_msc, true},
+          {"collision-world-count", subst_collision_world_count_msc, true},
+          {"collision-world-pairs-find!",
+           subst_collision_world_pairs_find_msc, true},
+          {"collision-world-pair-first",
+           subst_collision_world_pair_first_msc, true},
+          {"collision-world-pair-second",
+           subst_collision_world_pair_second_msc, true},
+          {"collision-world-contact-normal-x",
+           subst_collision_world_contact_normal_x_msc, true},
+          {"collision-world-contact-normal-y",
+           subst_collision_world_contact_normal_y_msc, true},
+          {"collision-world-contact-depth",
+           subst_collision_world_contact_depth_msc, true},
+          {"collision-world-ray-cast-internal",
+           subst_collision_world_ray_cast_msc, false},
+          {"collision-world-segment-cast-internal",
+           subst_collision_world_segment_cast_msc, false},
+          {"collision-world-cast-hit-id",
+           subst_collision_world_cast_hit_id_msc, true},
+          {"collision-world-cast-hit-distance",
+           subst_collision_world_cast_hit_distance_msc, true},
+          {"collision-world-cast-hit-normal-x",
+           subst_collision_world_cast_hit_normal_x_msc, true},
+          {"collision-world-cast-hit-normal-y",
+           subst_collision_world_cast_hit_normal_y_msc, true},
+          {NULL, NULL, false}});
+}
@@ -0,0 +1,105 @@
+#ifndef __subst_collision_h
+#define __subst_collision_h
+
+#include <inttypes.h>
+#include <mesche.h>
+#include <stdbool.h>
+
+#include "narrowphase.h"
+#include "physics.h"
+#include "raycast.h"
+
+#define SUBST_COLLISION_INVALID_ID UINT32_MAX
+
+typedef struct {
+  int32_t min_x, min_y;
+  int32_t max_x, max_y;
+} SubstCollisionCellRange;
+
+// One grid cell of the spatial hash and the ids of the colliders that
+// overlap it
+typedef struct {
+  bool is_used;
+  int32_t x, y;
+  uint32_t count;
+  uint32_t capacity;
+  uint32_t *ids;
+} SubstCollisionCell;
+
+typedef struct {
+  float cell_size;
+  float inv_cell_size;
+
+  // Colliders are packed into parallel arrays so that tests can stream
+  // through them, ids stay stable when colliders are removed
+  uint32_t count;
+  uint32_t capacity;
+  SubstCollisionShape *shapes;
+  float *center_x;
+  float *center_y;
+  // Spheres use their radius for both
+  float *half_width;
+  float *half_height;
+  uint32_t *ids;
+  SubstCollisionCellRange *cell_ranges;
+
+  // Maps each id to its collider's index, ids of removed colliders are
+  // reused
+  uint32_t id_count;
+  uint32_t id_capacity;
+  uint32_t *id_indices;
+  uint32_t free_id_count;
+  uint32_t *free_ids;
+
+  // Open addressed table of grid cells keyed by cell coordinates.  Colliders
+  // are only moved between cells when the range of cells they cover changes.
+  // Cells that empty out stay in the table until it fills up, then they are
+  // dropped so that the table only grows to fit the occupied cells.
+  uint32_t cell_count;
+  uint32_t cell_capacity;
+  SubstCollisionCell *cells;
+  // Covers every cell in the table so that casts know where to stop
+  SubstCollisionCellRange cell_bounds;
+
+  // Broadphase candidates sorted by shape so that each kind of pair goes
+  // through the narrowphase in batches, and the contacts found from them
+  SubstCollisionBatch sphere_candidates;
+  SubstCollisionBatch sphere_box_candidates;
+  SubstCollisionBatch box_candidates;
+  SubstContactSet contacts;
+
+  // Colliders are stamped by id as a cast tests them so that the ones that
+  // span several cells are only tested once
+  uint32_t cast_stamp;
+  uint32_t *cast_stamps;
+  SubstCastHits cast_hits;
+} SubstCollisionWorld;
+
+SubstCollisionWorld *subst_collision_world_create(float cell_size);
+void subst_collision_world_free(SubstCollisionWorld *world);
+
+uint32_t subst_collision_world_add(SubstCollisionWorld *world, float x,
+                                   float y, float radius);
+uint32_t subst_collision_world_box_add(SubstCollisionWorld *world, float x,
+                                       float y, float width, float height);
+void subst_collision_world_remove(SubstCollisionWorld *world, uint32_t id);
+// Spheres are positioned by their center and boxes by their min corner
+void subst_collision_world_move(SubstCollisionWorld *world, uint32_t id,
+                                float x, float y);
+void subst_collision_world_radius_set(SubstCollisionWorld *world, uint32_t id,
+                                      float radius);
+bool subst_collision_world_contains(SubstCollisionWorld *world, uint32_t id);
+
+// Returns the number of contacts found, which stay in world->contacts until
+// the next call
+uint32_t subst_collision_world_pairs_find(SubstCollisionWorld *world);
+
+// Walks the grid cells along the cast and returns the number of colliders it
+// touches, which stay in world->cast_hits nearest first until the next cast.
+// Only the nearest hit is kept when nearest_only is set.
+uint32_t subst_collision_world_cast(SubstCollisionWorld *world,
+                                    const SubstCast *cast, bool nearest_only);
+
+void subst_collision_module_init(VM *vm);
+
+#endif
@@ -0,0 +1,759 @@
+#include <math.h>
+#include <mesche.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "collision_tree.h"
+#include "log.h"
+
+#define COLLISION_TREE_INITIAL_CAPACITY 64
+#define COLLISION_TREE_DEFAULT_MARGIN 4.f
+
+SubstCollisionTree *subst_collision_tree_create(float margin) {
+  SubstCollisionTree *tree = malloc(sizeof(SubstCollisionTree));
+  memset(tree, 0, sizeof(SubstCollisionTree));
+
+  tree->margin = margin >= 0 ? margin : COLLISION_TREE_DEFAULT_MARGIN;
+  tree->root = SUBST_COLLISION_TREE_NULL;
+  tree->free_node = SUBST_COLLISION_TREE_NULL;
+
+  return tree;
+}
+
+void subst_collision_tree_free(SubstCollisionTree *tree) {
+  free(tree->nodes);
+  free(tree->stack);
+  free(tree->results);
+  subst_cast_hits_free(&tree->cast_hits);
+  free(tree);
+}
+
+static inline bool collision_tree_is_leaf(SubstCollisionTreeNode *node) {
+  return node->children[0] == SUBST_COLLISION_TREE_NULL;
+}
+
+static inline float collision_tree_perimeter(vec3 bounds[2]) {
+  return 2.f * ((bounds[1][0] - bounds[0][0]) + (bounds[1][1] - bounds[0][1]));
+}
+
+static uint32_t collision_tree_node_acquire(SubstCollisionTree *tree) {
+  if (tree->free_node == SUBST_COLLISION_TREE_NULL) {
+    uint32_t capacity = tree->node_capacity == 0
+                            ? COLLISION_TREE_INITIAL_CAPACITY
+                            : tree->node_capacity * 2;
+    tree->nodes =
+        realloc(tree->nodes, sizeof(SubstCollisionTreeNode) * capacity);
+
+    // Thread the new nodes onto the free list through their parent links
+    for (uint32_t i = tree->node_capacity; i < capacity; i++) {
+      tree->nodes[i].parent = i + 1 < capacity ? i + 1 : tree->free_node;
+      tree->nodes[i].height = -1;
+    }
+
+    tree->free_node = tree->node_capacity;
+    tree->node_capacity = capacity;
+  }
+
+  uint32_t index = tree->free_node;
+  SubstCollisionTreeNode *node = &tree->nodes[index];
+  tree->free_node = node->parent;
+  tree->node_count++;
+
+  node->parent = SUBST_COLLISION_TREE_NULL;
+  node->children[0] = SUBST_COLLISION_TREE_NULL;
+  node->children[1] = SUBST_COLLISION_TREE_NULL;
+  node->height = 0;
+
+  return index;
+}
+
+static void collision_tree_node_release(SubstCollisionTree *tree,
+                                        uint32_t index) {
+  tree->nodes[index].parent = tree->free_node;
+  tree->nodes[index].height = -1;
+  tree->free_node = index;
+  tree->node_count--;
+}
+
+static void collision_tree_child_replace(SubstCollisionTree *tree,
+                                         uint32_t parent, uint32_t old_child,
+                                         uint32_t new_child) {
+  if (parent == SUBST_COLLISION_TREE_NULL) {
+    tree->root = new_child;
+  } else if (tree->nodes[parent].children[0] == old_child) {
+    tree->nodes[parent].children[0] = new_child;
+  } else {
+    tree->nodes[parent].children[1] = new_child;
+  }
+}
+
+static void collision_tree_node_refit(SubstCollisionTree *tree,
+                                      uint32_t index) {
+  SubstCollisionTreeNode *node = &tree->nodes[index];
+  SubstCollisionTreeNode *first = &tree->nodes[node->children[0]];
+  SubstCollisionTreeNode *second = &tree->nodes[node->children[1]];
+
+  glm_aabb_merge(first->bounds, second->bounds, node->bounds);
+  node->height =
+      1 + (first->height > second->height ? first->height : second->height);
+}
+
+// Rotates the taller grandchild of an unbalanced node up into its place and
+// returns the index of the node that now roots the subtree
+static uint32_t collision_tree_balance(SubstCollisionTree *tree,
+                                       uint32_t index) {
+  SubstCollisionTreeNode *node = &tree->nodes[index];
+  if (collision_tree_is_leaf(node) || node->height < 2) {
+    return index;
+  }
+
+  int32_t balance = tree->nodes[node->children[1]].height -
+                    tree->nodes[node->children[0]].height;
+  if (balance >= -1 && balance <= 1) {
+    return index;
+  }
+
+  // Lift the taller child and give the node the shorter of its children
+  int side = balance > 1 ? 1 : 0;
+  uint32_t lifted = node->children[side];
+  SubstCollisionTreeNode *lifted_node = &tree->nodes[lifted];
+  uint32_t first = lifted_node->children[0];
+  uint32_t second = lifted_node->children[1];
+  uint32_t kept = tree->nodes[first].height > tree->nodes[second].height
+                      ? first
+                      : second;
+  uint32_t moved = kept == first ? second : first;
+
+  lifted_node->children[0] = index;
+  lifted_node->children[1] = kept;
+  lifted_node->parent = node->parent;
+  collision_tree_child_replace(tree, node->parent, index, lifted);
+
+  node->children[side] = moved;
+  node->parent = lifted;
+  tree->nodes[moved].parent = index;
+
+  collision_tree_node_refit(tree, index);
+  collision_tree_node_refit(tree, lifted);
+
+  return lifted;
+}
+
+static void collision_tree_ancestors_refit(SubstCollisionTree *tree,
+                                           uint32_t index) {
+  while (index != SUBST_COLLISION_TREE_NULL) {
+    index = collision_tree_balance(tree, index);
+    collision_tree_node_refit(tree, index);
+    index = tree->nodes[index].parent;
+  }
+}
+
+static void collision_tree_leaf_insert(SubstCollisionTree *tree,
+                                       uint32_t leaf) {
+  if (tree->root == SUBST_COLLISION_TREE_NULL) {
+    tree->root = leaf;
+    tree->nodes[leaf].parent = SUBST_COLLISION_TREE_NULL;
+    return;
+  }
+
+  // Descend toward the sibling that grows the total perimeter the least,
+  // stopping once pairing with the current node is the cheapest option
+  vec3 *leaf_bounds = tree->nodes[leaf].bounds;
+  vec3 merged[2];
+  uint32_t index = tree->root;
+  while (!collision_tree_is_leaf(&tree->nodes[index])) {
+    SubstCollisionTreeNode *node = &tree->nodes[index];
+    glm_aabb_merge(node->bounds, leaf_bounds, merged);
+    float merged_perimeter = collision_tree_perimeter(merged);
+    float cost = 2.f * merged_perimeter;
+    float inherited_cost =
+        2.f * (merged_perimeter - collision_tree_perimeter(node->bounds));
+
+    float child_costs[2];
+    for (int i = 0; i < 2; i++) {
+      SubstCollisionTreeNode *child = &tree->nodes[node->children[i]];
+      glm_aabb_merge(child->bounds, leaf_bounds, merged);
+      child_costs[i] = collision_tree_perimeter(merged) + inherited_cost;
+      if (!collision_tree_is_leaf(child)) {
+        child_costs[i] -= collision_tree_perimeter(child->bounds);
+      }
+    }
+
+    if (cost < child_costs[0] && cost < child_costs[1]) {
+      break;
+    }
+
+    index = node->children[child_costs[0] < child_costs[1] ? 0 : 1];
+  }
+
+  // Pair the leaf and its new sibling under a new branch. Acquiring a node
+  // can move the node array so no pointers are held across it.
+  uint32_t sibling = index;
+  uint32_t old_parent = tree->nodes[sibling].parent;
+  uint32_t branch = collision_tree_node_acquire(tree);
+  tree->nodes[branch].parent = old_parent;
+  tree->nodes[branch].children[0] = sibling;
+  tree->nodes[branch].children[1] = leaf;
+  tree->nodes[sibling].parent = branch;
+  tree->nodes[leaf].parent = branch;
+  collision_tree_child_replace(tree, old_parent, sibling, branch);
+
+  collision_tree_ancestors_refit(tree, branch);
+}
+
+static void collision_tree_leaf_remove(SubstCollisionTree *tree,
+                                       uint32_t leaf) {
+  if (leaf == tree->root) {
+    tree->root = SUBST_COLLISION_TREE_NULL;
+    return;
+  }
+
+  // The leaf's sibling takes the place of their parent
+  uint32_t parent = tree->nodes[leaf].parent;
+  uint32_t grandparent = tree->nodes[parent].parent;
+  uint32_t sibling = tree->nodes[parent].children[0] == leaf
+                         ? tree->nodes[parent].children[1]
+                         : tree->nodes[parent].children[0];
+
+  collision_tree_child_replace(tree, grandparent, parent, sibling);
+  tree->nodes[sibling].parent = grandparent;
+  collision_tree_node_release(tree, parent);
+
+  collision_tree_ancestors_refit(tree, grandparent);
+}
+
+static void collision_tree_leaf_fatten(SubstCollisionTree *tree,
+                                       SubstCollisionTreeNode *node) {
+  for (int i = 0; i < 2; i++) {
+    node->bounds[0][i] = node->shape_bounds[0][i] - tree->margin;
+    node->bounds[1][i] = node->shape_bounds[1][i] + tree->margin;
+  }
+  node->bounds[0][2] = 0.f;
+  node->bounds[1][2] = 0.f;
+}
+
+static uint32_t collision_tree_leaf_add(SubstCollisionTree *tree,
+                                        SubstCollisionShape shape,
+                                        SubstBox *box, float radius) {
+  uint32_t leaf = collision_tree_node_acquire(tree);
+  SubstCollisionTreeNode *node = &tree->nodes[leaf];
+  node->shape = shape;
+  node->radius = radius;
+  glm_vec3_copy(box->bounds[0], node->shape_bounds[0]);
+  glm_vec3_copy(box->bounds[1], node->shape_bounds[1]);
+  collision_tree_leaf_fatten(tree, node);
+
+  collision_tree_leaf_insert(tree, leaf);
+  tree->leaf_count++;
+
+  return leaf;
+}
+
+uint32_t subst_collision_tree_sphere_add(SubstCollisionTree *tree, float x,
+                                         float y, float radius) {
+  SubstBox box;
+  subst_box_init(&box, x - radius, y - radius, radius * 2, radius * 2);
+  return collision_tree_leaf_add(tree, SUBST_COLLISION_SHAPE_SPHERE, &box,
+                                 radius);
+}
+
+uint32_t subst_collision_tree_box_add(SubstCollisionTree *tree, float x,
+                                      float y, float width, float height) {
+  SubstBox box;
+  subst_box_init(&box, x, y, width, height);
+  return collision_tree_leaf_add(tree, SUBST_COLLISION_SHAPE_BOX, &box, 0);
+}
+
+bool subst_collision_tree_contains(SubstCollisionTree *tree, uint32_t id) {
+  return id < tree->node_capacity && tree->nodes[id].height == 0;
+}
+
+void subst_collision_tree_remove(SubstCollisionTree *tree, uint32_t id) {
+  if (!subst_collision_tree_contains(tree, id)) {
+    return;
+  }
+
+  collision_tree_leaf_remove(tree, id);
+  collision_tree_node_release(tree, id);
+  tree->leaf_count--;
+}
+
+void subst_collision_tree_move(SubstCollisionTree *tree, uint32_t id, float x,
+                               float y) {
+  if (!subst_collision_tree_contains(tree, id)) {
+    return;
+  }
+
+  SubstCollisionTreeNode *node = &tree->nodes[id];
+  vec3 *bounds = node->shape_bounds;
+  if (node->shape == SUBST_COLLISION_SHAPE_SPHERE) {
+    x -= node->radius;
+    y -= node->radius;
+  }
+  subst_box_init((SubstBox *)bounds, x, y, bounds[1][0] - bounds[0][0],
+                 bounds[1][1] - bounds[0][1]);
+
+  // Only reinsert once the collider leaves its fattened bounds
+  if (glm_aabb_contains(node->bounds, bounds)) {
+    return;
+  }
+
+  collision_tree_leaf_remove(tree, id);
+  collision_tree_leaf_fatten(tree, node);
+  collision_tree_leaf_insert(tree, id);
+}
+
+static bool collision_tree_shapes_overlap(SubstCollisionShape shape,
+                                          vec3 bounds[2], float radius,
+                                          SubstCollisionShape other_shape,
+                                          vec3 other_bounds[2],
+                                          float other_radius) {
+  // Sort the pair so that a box always comes first
+  if (shape == SUBST_COLLISION_SHAPE_SPHERE &&
+      other_shape == SUBST_COLLISION_SHAPE_BOX) {
+    return collision_tree_shapes_overlap(other_shape, other_bounds,
+                                         other_radius, shape, bounds, radius);
+  }
+
+  float other_x = (other_bounds[0][0] + other_bounds[1][0]) * 0.5f;
+  float other_y = (other_bounds[0][1] + other_bounds[1][1]) * 0.5f;
+  if (shape == SUBST_COLLISION_SHAPE_BOX) {
+    return other_shape == SUBST_COLLISION_SHAPE_BOX
+               ? glm_aabb_aabb(bounds, other_bounds)
+               : subst_box_circle_intersect((SubstBox *)bounds, other_x,
+                                            other_y, other_radius);
+  }
+
+  float dx = (bounds[0][0] + bounds[1][0]) * 0.5f - other_x;
+  float dy = (bounds[0][1] + bounds[1][1]) * 0.5f - other_y;
+  float reach = radius + other_radius;
+  return dx * dx + dy * dy <= reach * reach;
+}
+
+static void collision_tree_stack_push(SubstCollisionTree *tree,
+                                      uint32_t *count, uint32_t index) {
+  if (*count == tree->stack_capacity) {
+    tree->stack_capacity = tree->stack_capacity == 0
+                               ? COLLISION_TREE_INITIAL_CAPACITY
+                               : tree->stack_capacity * 2;
+    tree->stack =
+        realloc(tree->stack, sizeof(uint32_t) * tree->stack_capacity);
+  }
+
+  tree->stack[(*count)++] = index;
+}
+
+static void collision_tree_result_add(SubstCollisionTree *tree, uint32_t id) {
+  if (tree->result_count == tree->result_capacity) {
+    tree->result_capacity = tree->result_capacity == 0
+                                ? COLLISION_TREE_INITIAL_CAPACITY
+                                : tree->result_capacity * 2;
+    tree->results =
+        realloc(tree->results, sizeof(uint32_t) * tree->result_capacity);
+  }
+
+  tree->results[tree->result_count++] = id;
+}
+
+static uint32_t collision_tree_query(SubstCollisionTree *tree,
+                                     SubstCollisionShape shape, SubstBox *box,
+                                     float radius) {
+  tree->result_count = 0;
+  if (tree->root == SUBST_COLLISION_TREE_NULL) {
+    return 0;
+  }
+
+  uint32_t stack_count = 0;
+  collision_tree_stack_push(tree, &stack_count, tree->root);
+  while (stack_count > 0) {
+    SubstCollisionTreeNode *node = &tree->nodes[tree->stack[--stack_count]];
+    if (!glm_aabb_aabb(node->bounds, box->bounds)) {
+      continue;
+    }
+
+    if (collision_tree_is_leaf(node)) {
+      if (collision_tree_shapes_overlap(node->shape, node->shape_bounds,
+                                        node->radius, shape, box->bounds,
+                                        radius)) {
+        collision_tree_result_add(tree, node - tree->nodes);
+      }
+    } else {
+      collision_tree_stack_push(tree, &stack_count, node->children[0]);
+      collision_tree_stack_push(tree, &stack_count, node->children[1]);
+    }
+  }
+
+  return tree->result_count;
+}
+
+uint32_t subst_collision_tree_query_point(SubstCollisionTree *tree, float x,
+                                          float y) {
+  SubstBox box;
+  subst_box_init(&box, x, y, 0, 0);
+  return collision_tree_query(tree, SUBST_COLLISION_SHAPE_BOX, &box, 0);
+}
+
+uint32_t subst_collision_tree_query_rect(SubstCollisionTree *tree, float x,
+                                         float y, float width, float height) {
+  SubstBox box;
+  subst_box_init(&box, x, y, width, height);
+  return collision_tree_query(tree, SUBST_COLLISION_SHAPE_BOX, &box, 0);
+}
+
+uint32_t subst_collision_tree_query_circle(SubstCollisionTree *tree, float x,
+                                           float y, float radius) {
+  SubstBox box;
+  subst_box_init(&box, x - radius, y - radius, radius * 2, radius * 2);
+  return collision_tree_query(tree, SUBST_COLLISION_SHAPE_SPHERE, &box,
+                              radius);
+}
+
+// Tests whether the cast passes through a node's bounds, grown by the cast's
+// radius, and finds the distance at which it enters them
+static bool collision_tree_cast_node(const SubstCollisionTreeNode *node,
+                                     const SubstCast *cast, float *enter) {
+  float radius = cast->radius, exit;
+  return subst_cast_bounds(cast, node->bounds[0][0] - radius,
+                           node->bounds[0][1] - radius,
+                           node->bounds[1][0] + radius,
+                           node->bounds[1][1] + radius, enter, &exit);
+}
+
+uint32_t subst_collision_tree_cast(SubstCollisionTree *tree,
+                                   const SubstCast *cast, bool nearest_only) {
+  SubstCastHits *hits = &tree->cast_hits;
+  hits->count = 0;
+  float enter;
+  if (tree->root == SUBST_COLLISION_TREE_NULL ||
+      !collision_tree_cast_node(&tree->nodes[tree->root], cast, &enter)) {
+    return 0;
+  }
+
+  // Children are tested before they are pushed so that missed subtrees never
+  // go on the stack
+  uint32_t stack_count = 0;
+  collision_tree_stack_push(tree, &stack_count, tree->root);
+  while (stack_count > 0) {
+    SubstCollisionTreeNode *node = &tree->nodes[tree->stack[--stack_count]];
+    if (!collision_tree_is_leaf(node)) {
+      float first_enter, second_enter;
+      uint32_t first = node->children[0], second = node->children[1];
+      bool is_first_hit =
+          collision_tree_cast_node(&tree->nodes[first], cast, &first_enter);
+      bool is_second_hit =
+          collision_tree_cast_node(&tree->nodes[second], cast, &second_enter);
+
+      // Nothing under a child the cast enters beyond the nearest hit found
+      // so far can beat it
+      if (nearest_only && hits->count > 0) {
+        is_first_hit &= first_enter <= hits->hits[0].distance;
+        is_second_hit &= second_enter <= hits->hits[0].distance;
+      }
+
+      // Visit the nearer child first so that more of the tree gets pruned
+      if (is_first_hit && is_second_hit && first_enter < second_enter) {
+        collision_tree_stack_push(tree, &stack_count, second);
+        collision_tree_stack_push(tree, &stack_count, first);
+      } else {
+        if (is_first_hit) {
+          collision_tree_stack_push(tree, &stack_count, first);
+        }
+        if (is_second_hit) {
+          collision_tree_stack_push(tree, &stack_count, second);
+        }
+      }
+      continue;
+    }
+
+    uint32_t id = node - tree->nodes;
+    if (id == cast->ignore_id) {
+      continue;
+    }
+
+    SubstCastHit hit;
+    bool is_hit =
+        node->shape == SUBST_COLLISION_SHAPE_SPHERE
+            ? subst_cast_sphere(
+                  cast,
+                  (node->shape_bounds[0][0] + node->shape_bounds[1][0]) * 0.5f,
+                  (node->shape_bounds[0][1] + node->shape_bounds[1][1]) * 0.5f,
+                  node->radius, &hit)
+            : subst_cast_box(cast, node->shape_bounds[0][0],
+                             node->shape_bounds[0][1],
+                             node->shape_bounds[1][0],
+                             node->shape_bounds[1][1], &hit);
+    if (!is_hit) {
+      continue;
+    }
+
+    hit.id = id;
+    if (!nearest_only || hits->count == 0) {
+      subst_cast_hits_add(hits, &hit);
+    } else if (hit.distance < hits->hits[0].distance) {
+      hits->hits[0] = hit;
+    }
+  }
+
+  if (!nearest_only) {
+    subst_cast_hits_sort(hits);
+  }
+
+  return hits->count;
+}
+
+void collision_tree_free_func(MescheMemory *mem, void *obj) {
+  subst_collision_tree_free((SubstCollisionTree *)obj);
+}
+
+const ObjectPointerType SubstCollisionTreeType = {
+    .name = "collision-tree", .free_func = collision_tree_free_func};
+
+Value subst_collision_tree_create_msc(VM *vm, int arg_count, Value *args) {
+  if (arg_count != 1) {
+    subst_log("Function requires 1 parameter.");
+  }
+
+  SubstCollisionTree *tree = subst_collision_tree_create(
+      IS_NUMBER(args[0]) ? AS_NUMBER(args[0]) : -1);
+
+  return OBJECT_VAL(
+      mesche_object_make_pointer_type(vm, tree, &SubstCollisionTreeType));
+}
+
+Value subst_collision_tree_sphere_add_msc(VM *vm, int arg_count,
+                                          Value *args) {
+  if (arg_count != 2) {
+    subst_log("Function requires 2 parameters.");
+  }
+
+  // The tree keeps its own copy, moving the sphere later won't move it
+  SubstCollisionTree *tree = (SubstCollisionTree *)AS_POINTER(args[0])->ptr;
+  SubstSphere *sphere = (SubstSphere *)AS_POINTER(args[1])->ptr;
+  return NUMBER_VAL(subst_collision_tree_sphere_add(
+      tree, sphere->center_x, sphere->center_y, sphere->radius));
+}
+
+Value subst_collision_tree_box_add_msc(VM *vm, int arg_count, Value *args) {
+  if (arg_count != 2) {
+    subst_log("Function requires 2 parameters.");
+  }
+
+  SubstCollisionTree *tree = (SubstCollisionTree *)AS_POINTER(args[0])->ptr;
+  SubstBox *box = (SubstBox *)AS_POINTER(args[1])->ptr;
+  return NUMBER_VAL(subst_collision_tree_box_add(
+      tree, box->bounds[0][0], box->bounds[0][1],
+      box->bounds[1][0] - box->bounds[0][0],
+      box->bounds[1][1] - box->bounds[0][1]));
+}
+
+Value subst_collision_tree_remove_msc(VM *vm, int arg_count, Value *args) {
+  if (arg_count != 2) {
+    subst_log("Function requires 2 parameters.");
+  }
+
+  SubstCollisionTree *tree = (SubstCollisionTree *)AS_POINTER(args[0])->ptr;
+  uint32_t id = AS_NUMBER(args[1]);
+  if (!subst_collision_tree_contains(tree, id)) {
+    return FALSE_VAL;
+  }
+
+  subst_collision_tree_remove(tree, id);
+
+  return TRUE_VAL;
+}
+
+Value subst_collision_tree_move_msc(VM *vm, int arg_count, Value *args) {
+  if (arg_count != 4) {
+    subst_log("Function requires 4 parameters.");
+  }
+
+  SubstCollisionTree *tree = (SubstCollisionTree *)AS_POINTER(args[0])->ptr;
+  subst_collision_tree_move(tree, AS_NUMBER(args[1]), AS_NUMBER(args[2]),
+                            AS_NUMBER(args[3]));
+
+  return TRUE_VAL;
+}
+
+Value subst_collision_tree_count_msc(VM *vm, int arg_count, Value *args) {
+  if (arg_count != 1) {
+    subst_log("Function requires 1 parameter.");
+  }
+
+  SubstCollisionTree *tree = (SubstCollisionTree *)AS_POINTER(args[0])->ptr;
+  return NUMBER_VAL(tree->leaf_count);
+}
+
+Value subst_collision_tree_query_point_msc(VM *vm, int arg_count,
+                                           Value *args) {
+  if (arg_count != 3) {
+    subst_log("Function requires 3 parameters.");
+  }
+
+  SubstCollisionTree *tree = (SubstCollisionTree *)AS_POINTER(args[0])->ptr;
+  return NUMBER_VAL(subst_collision_tree_query_point(tree, AS_NUMBER(args[1]),
+                                                     AS_NUMBER(args[2])));
+}
+
+Value subst_collision_tree_query_rect_msc(VM *vm, int arg_count,
+                                          Value *args) {
+  if (arg_count != 5) {
+    subst_log("Function requires 5 parameters.");
+  }
+
+  SubstCollisionTree *tree = (SubstCollisionTree *)AS_POINTER(args[0])->ptr;
+  return NUMBER_VAL(subst_collision_tree_query_rect(
+      tree, AS_NUMBER(args[1]), AS_NUMBER(args[2]), AS_NUMBER(args[3]),
+      AS_NUMBER(args[4])));
+}
+
+Value subst_collision_tree_query_circle_msc(VM *vm, int arg_count,
+                                            Value *args) {
+  if (arg_count != 4) {
+    subst_log("Function requires 4 parameters.");
+  }
+
+  SubstCollisionTree *tree = (SubstCollisionTree *)AS_POINTER(args[0])->ptr;
+  return NUMBER_VAL(subst_collision_tree_query_circle(
+      tree, AS_NUMBER(args[1]), AS_NUMBER(args[2]), AS_NUMBER(args[3])));
+}
+
+Value subst_collision_tree_result_msc(VM *vm, int arg_count, Value *args) {
+  if (arg_count != 2) {
+    subst_log("Function requires 2 parameters.");
+  }
+
+  SubstCollisionTree *tree = (SubstCollisionTree *)AS_POINTER(args[0])->ptr;
+  int index = AS_NUMBER(args[1]);
+  if (index < 0 || (uint32_t)index >= tree->result_count) {
+    return FALSE_VAL;
+  }
+
+  return NUMBER_VAL(tree->results[index]);
+}
+
+// Fills in the id to skip from the cast natives' trailing arguments and runs
+// the cast, keeping every hit unless the last argument is true
+static uint32_t collision_tree_cast_run(SubstCollisionTree *tree,
+                                        SubstCast *cast, Value *args) {
+  if (IS_NUMBER(args[0])) {
+    cast->ignore_id = AS_NUMBER(args[0]);
+  }
+
+  return subst_collision_tree_cast(tree, cast, !IS_FALSE(args[1]));
+}
+
+Value subst_collision_tree_ray_cast_msc(VM *vm, int arg_count, Value *args) {
+  if (arg_count != 9) {
+    subst_log("Function requires 9 parameters.");
+  }
+
+  SubstCollisionTree *tree = (SubstCollisionTree *)AS_POINTER(args[0])->ptr;
+  SubstCast cast;
+  subst_cast_init(&cast, AS_NUMBER(args[1]), AS_NUMBER(args[2]),
+                  AS_NUMBER(args[3]), AS_NUMBER(args[4]),
+                  IS_NUMBER(args[5]) ? AS_NUMBER(args[5]) : INFINITY,
+                  IS_NUMBER(args[6]) ? AS_NUMBER(args[6]) : 0);
+
+  return NUMBER_VAL(collision_tree_cast_run(tree, &cast, &args[7]));
+}
+
+Value subst_collision_tree_segment_cast_msc(VM *vm, int arg_count,
+                                            Value *args) {
+  if (arg_count != 8) {
+    subst_log("Function requires 8 parameters.");
+  }
+
+  SubstCollisionTree *tree = (SubstCollisionTree *)AS_POINTER(args[0])->ptr;
+  SubstCast cast;
+  subst_cast_segment_init(&cast, AS_NUMBER(args[1]), AS_NUMBER(args[2]),
+                          AS_NUMBER(args[3]), AS_NUMBER(args[4]),
+                          IS_NUMBER(args[5]) ? AS_NUMBER(args[5]) : 0);
+
+  return NUMBER_VAL(collision_tree_cast_run(tree, &cast, &args[6]));
+}
+
+// Returns the hit at the index argument from the last cast, or NULL when the
+// index is out of range
+static SubstCastHit *collision_tree_cast_hit_arg(Value *args) {
+  SubstCollisionTree *tree = (SubstCollisionTree *)AS_POINTER(args[0])->ptr;
+  int hit_index = AS_NUMBER(args[1]);
+  if (hit_index < 0 || (uint32_t)hit_index >= tree->cast_hits.count) {
+    return NULL;
+  }
+
+  return &tree->cast_hits.hits[hit_index];
+}
+
+Value subst_collision_tree_cast_hit_id_msc(VM *vm, int arg_count,
+                                           Value *args) {
+  if (arg_count != 2) {
+    subst_log("Function requires 2 parameters.");
+  }
+
+  SubstCastHit *hit = collision_tree_cast_hit_arg(args);
+  return hit != NULL ? NUMBER_VAL(hit->id) : FALSE_VAL;
+}
+
+Value subst_collision_tree_cast_hit_distance_msc(VM *vm, int arg_count,
+                                                 Value *args) {
+  if (arg_count != 2) {
+    subst_log("Function requires 2 parameters.");
+  }
+
+  SubstCastHit *hit = collision_tree_cast_hit_arg(args);
+  return hit != NULL ? NUMBER_VAL(hit->distance) : FALSE_VAL;
+}
+
+Value subst_collision_tree_cast_hit_normal_x_msc(VM *vm, int arg_count,
+                                                 Value *args) {
+  if (arg_count != 2) {
+    subst_log("Function requires 2 parameters.");
+  }
+
+  SubstCastHit *hit = collision_tree_cast_hit_arg(args);
+  return hit != NULL ? NUMBER_VAL(hit->normal_x) : FALSE_VAL;
+}
+
+Value subst_collision_tree_cast_hit_normal_y_msc(VM *vm, int arg_count,
+                                                 Value *args) {
+  if (arg_count != 2) {
+    subst_log("Function requires 2 parameters.");
+  }
+
+  SubstCastHit *hit = collision_tree_cast_hit_arg(args);
+  return hit != NULL ? NUMBER_VAL(hit->normal_y) : FALSE_VAL;
+}
+
+void subst_collision_tree_module_init(VM *vm) {
+  mesche_vm_define_native_funcs(
+      vm, "substratic physics",
+      (MescheNativeFuncDetails[]){
+          {"collision-tree-create-internal", subst_collision_tree_create_msc,
+           false},
+          {"collision-tree-sphere-add!", subst_collision_tree_sphere_add_msc,
+           true},
+          {"collision-tree-box-add!", subst_collision_tree_box_add_msc, true},
+          {"collision-tree-remove!", subst_collision_tree_remove_msc, true},
+          {"collision-tree-move!", subst_collision_tree_move_msc, true},
+          {"collision-tree-count", subst_collision_tree_count_msc, true},
+          {"collision-tree-query-point!",
+           subst_collision_tree_query_point_msc, true},
+          {"collision-tree-query-rect!", subst_collision_tree_query_rect_msc,
+           true},
+          {"collision-tree-query-circle!",
+           subst_collision_tree_query_circle_msc, true},
+          {"collision-tree-result", subst_collision_tree_result_msc, true},
+          {"collision-tree-ray-cast-internal",
+           subst_collision_tree_ray_cast_msc, false},
+          {"collision-tree-segment-cast-internal",
+           subst_collision_tree_segment_cast_msc, false},
+          {"collision-tree-cast-hit-id", subst_collision_tree_cast_hit_id_msc,
+           true},
+          {"collision-tree-cast-hit-distance",
+           subst_collision_tree_cast_hit_distance_msc, true},
+          {"collision-tree-cast-hit-normal-x",
+           subst_collision_tree_cast_hit_normal_x_msc, true},
+          {"collision-tree-cast-hit-normal-y",
+           subst_collision_tree_cast_hit_normal_y_msc, true},
+          {NULL, NULL, false}});
+}
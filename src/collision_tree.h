@@ -0,0 +1,79 @@
+#ifndef __subst_collision_tree_h
+#define __subst_collision_tree_h
+
+#include <cglm/cglm.h>
+#include <inttypes.h>
+#include <mesche.h>
+#include <stdbool.h>
+
+#include "physics.h"
+#include "raycast.h"
+
+#define SUBST_COLLISION_TREE_NULL UINT32_MAX
+
+// Branches hold the union of their children's bounds, leaves hold one
+// collider and are addressed by their node index, which serves as the
+// collider id
+typedef struct {
+  // Fattened bounds so that small moves don't touch the tree
+  vec3 bounds[2];
+  uint32_t parent;
+  uint32_t children[2];
+  // Leaves are 0 high, free nodes are -1
+  int32_t height;
+
+  // Exact shape of a leaf's collider
+  SubstCollisionShape shape;
+  vec3 shape_bounds[2];
+  float radius;
+} SubstCollisionTreeNode;
+
+typedef struct {
+  float margin;
+
+  uint32_t root;
+  uint32_t node_count;
+  uint32_t node_capacity;
+  uint32_t free_node;
+  SubstCollisionTreeNode *nodes;
+  uint32_t leaf_count;
+
+  // Scratch stack for traversals and the ids found by the last query
+  uint32_t stack_capacity;
+  uint32_t *stack;
+  uint32_t result_count;
+  uint32_t result_capacity;
+  uint32_t *results;
+  SubstCastHits cast_hits;
+} SubstCollisionTree;
+
+SubstCollisionTree *subst_collision_tree_create(float margin);
+void subst_collision_tree_free(SubstCollisionTree *tree);
+
+uint32_t subst_collision_tree_sphere_add(SubstCollisionTree *tree, float x,
+                                         float y, float radius);
+uint32_t subst_collision_tree_box_add(SubstCollisionTree *tree, float x,
+                                      float y, float width, float height);
+void subst_collision_tree_remove(SubstCollisionTree *tree, uint32_t id);
+bool subst_collision_tree_contains(SubstCollisionTree *tree, uint32_t id);
+
+// Spheres are positioned by their center and boxes by their min corner
+void subst_collision_tree_move(SubstCollisionTree *tree, uint32_t id, float x,
+                               float y);
+
+uint32_t subst_collision_tree_query_point(SubstCollisionTree *tree, float x,
+                                          float y);
+uint32_t subst_collision_tree_query_rect(SubstCollisionTree *tree, float x,
+                                         float y, float width, float height);
+uint32_t subst_collision_tree_query_circle(SubstCollisionTree *tree, float x,
+                                           float y, float radius);
+
+// Returns the number of colliders the cast touches, which stay in
+// tree->cast_hits nearest first until the next cast.  Only the nearest hit is
+// kept when nearest_only is set.
+uint32_t subst_collision_tree_cast(SubstCollisionTree *tree,
+                                   const SubstCast *cast, bool nearest_only);
+
+void subst_collision_tree_module_init(VM *vm);
+
+#endif
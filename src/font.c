@@ -13,6 +13,8 @@
 
 #include "font.h"
 #include "log.h"
+#include "profiler.h"
+#include "render_state.h"
 #include "renderer.h"
 #include "shader.h"
 #include "texture.h"
@@ -100,15 +102,16 @@ SubstFont *subst_font_load_file(const char *font_path, int font_size) {
 
     // Assign glyph metrics
     current_char = &subst_font->chars[char_id - ASCII_CHAR_START];
-    current_char->texture.width = face->glyph->bitmap.width;
-    current_char->texture.height = face->glyph->bitmap.rows;
     current_char->bearing_x = face->glyph->bitmap_left;
     current_char->bearing_y = face->glyph->bitmap_top;
     current_char->advance = face->glyph->advance.x;
 
     // Create the texture and copy the glyph bitmap into it
-    glGenTextures(1, &current_char->texture.texture_id);
-    glBindTexture(GL_TEXTURE_2D, current_char->texture.texture_id);
+    GLuint texture_id;
+    glGenTextures(1, &texture_id);
+    subst_texture_init(&current_char->texture, texture_id,
+                       face->glyph->bitmap.width, face->glyph->bitmap.rows);
+    subst_render_state_texture_bind(0, texture_id);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, current_char->texture.width,
                  current_char->texture.height, 0, GL_RED, GL_UNSIGNED_BYTE,
                  face->glyph->bitmap.buffer);
@@ -135,15 +138,17 @@ void subst_font_render_text(SubstRenderer *renderer, SubstFont *font,
   SubstFontChar *current_char = NULL;
   static SubstDrawArgs draw_args;
 
-  if (draw_args.shader_program == 0) {
+  if (draw_args.shader == NULL) {
     const SubstShaderFile shader_files[] = {
         {GL_VERTEX_SHADER, FontVertexShaderText},
         {GL_FRAGMENT_SHADER, FontFragmentShaderText},
     };
 
-    draw_args.shader_program = subst_shader_compile(shader_files, 2);
+    draw_args.shader = subst_shader_compile(shader_files, 2);
   }
 
+  subst_profiler_zone_begin("text-render");
+
   num_chars = strlen(text);
 
   for (i = 0; i < num_chars; i++) {
@@ -159,7 +164,7 @@ void subst_font_render_text(SubstRenderer *renderer, SubstFont *font,
     pos_x += current_char->advance >> 6;
   }
 
-  glBindTexture(GL_TEXTURE_2D, 0);
+  subst_profiler_zone_end();
 }
 
 int subst_font_text_width(SubstFont *font, const char *text) {
@@ -1,6 +1,13 @@
+#include "atlas.h"
+#include "body.h"
+#include "camera.h"
+#include "collision.h"
+#include "collision_tree.h"
 #include "font.h"
 #include "particle.h"
 #include "physics.h"
+#include "profiler.h"
+#include "render_target.h"
 #include "renderer.h"
 #include "texture.h"
 #include "window.h"
@@ -12,7 +19,14 @@ void substratic_library_init(VM *vm) {
   subst_input_module_init(vm);
   subst_window_module_init(vm);
   subst_texture_module_init(vm);
+  subst_atlas_module_init(vm);
   subst_renderer_module_init(vm);
+  subst_render_target_module_init(vm);
+  subst_camera_module_init(vm);
   subst_physics_module_init(vm);
+  subst_collision_module_init(vm);
+  subst_collision_tree_module_init(vm);
+  subst_body_module_init(vm);
   subst_particle_module_init(vm);
+  subst_profiler_module_init(vm);
 }
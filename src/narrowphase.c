@@ -0,0 +1,261 @@
+#include <cglm/cglm.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "narrowphase.h"
+#include "simd.h"
+
+#define NARROWPHASE_LANES (SUBST_SIMD_ALIGN / sizeof(float))
+#define NARROWPHASE_EPSILON 1e-6f
+
+// Results for one vector's worth of pairs, read back for the pairs that hit
+typedef struct {
+  _Alignas(SUBST_SIMD_ALIGN) float normal_x[NARROWPHASE_LANES];
+  _Alignas(SUBST_SIMD_ALIGN) float normal_y[NARROWPHASE_LANES];
+  _Alignas(SUBST_SIMD_ALIGN) float depth[NARROWPHASE_LANES];
+} NarrowphaseLanes;
+
+void subst_collision_batch_init(SubstCollisionBatch *batch) {
+  memset(batch, 0, sizeof(SubstCollisionBatch));
+}
+
+void subst_collision_batch_free(SubstCollisionBatch *batch) {
+  free(batch->first_ids);
+  free(batch->second_ids);
+  free(batch->first_x);
+  free(batch->first_y);
+  free(batch->first_extent_x);
+  free(batch->first_extent_y);
+  free(batch->second_x);
+  free(batch->second_y);
+  free(batch->second_extent_x);
+  free(batch->second_extent_y);
+  subst_collision_batch_init(batch);
+}
+
+static void collision_batch_floats_grow(float **values, uint32_t count,
+                                        uint32_t capacity) {
+  // realloc can't keep the alignment so copy into a new array
+  float *grown = subst_simd_floats_alloc(capacity);
+  if (*values != NULL) {
+    memcpy(grown, *values, sizeof(float) * count);
+    free(*values);
+  }
+
+  *values = grown;
+}
+
+void subst_collision_batch_grow(SubstCollisionBatch *batch) {
+  uint32_t capacity = batch->capacity == 0 ? 64 : batch->capacity * 2;
+
+  batch->first_ids = realloc(batch->first_ids, sizeof(uint32_t) * capacity);
+  batch->second_ids = realloc(batch->second_ids, sizeof(uint32_t) * capacity);
+  collision_batch_floats_grow(&batch->first_x, batch->count, capacity);
+  collision_batch_floats_grow(&batch->first_y, batch->count, capacity);
+  collision_batch_floats_grow(&batch->first_extent_x, batch->count,
+                              capacity);
+  collision_batch_floats_grow(&batch->first_extent_y, batch->count,
+                              capacity);
+  collision_batch_floats_grow(&batch->second_x, batch->count, capacity);
+  collision_batch_floats_grow(&batch->second_y, batch->count, capacity);
+  collision_batch_floats_grow(&batch->second_extent_x, batch->count,
+                              capacity);
+  collision_batch_floats_grow(&batch->second_extent_y, batch->count,
+                              capacity);
+  batch->capacity = capacity;
+}
+
+void subst_contact_set_init(SubstContactSet *contacts) {
+  memset(contacts, 0, sizeof(SubstContactSet));
+}
+
+void subst_contact_set_free(SubstContactSet *contacts) {
+  free(contacts->first);
+  free(contacts->second);
+  free(contacts->normal_x);
+  free(contacts->normal_y);
+  free(contacts->depth);
+  subst_contact_set_init(contacts);
+}
+
+static void contact_set_reserve(SubstContactSet *contacts, uint32_t count) {
+  if (count <= contacts->capacity) {
+    return;
+  }
+
+  uint32_t capacity = contacts->capacity == 0 ? 64 : contacts->capacity;
+  while (capacity < count) {
+    capacity *= 2;
+  }
+
+  contacts->first = realloc(contacts->first, sizeof(uint32_t) * capacity);
+  contacts->second = realloc(contacts->second, sizeof(uint32_t) * capacity);
+  contacts->normal_x = realloc(contacts->normal_x, sizeof(float) * capacity);
+  contacts->normal_y = realloc(contacts->normal_y, sizeof(float) * capacity);
+  contacts->depth = realloc(contacts->depth, sizeof(float) * capacity);
+  contacts->capacity = capacity;
+}
+
+static inline void narrowphase_lanes_emit(NarrowphaseLanes *lanes,
+                                          SubstSimdFloat normal_x,
+                                          SubstSimdFloat normal_y,
+                                          SubstSimdFloat depth,
+                                          const SubstCollisionBatch *batch,
+                                          uint32_t first,
+                                          SubstContactSet *contacts) {
+  // Only the pairs that touch are read back, lanes past the end of the
+  // batch hold padding
+  uint32_t count = batch->count - first < SUBST_SIMD_WIDTH
+                       ? batch->count - first
+                       : SUBST_SIMD_WIDTH;
+  int hits = ~subst_simd_mask_bits(subst_simd_less(depth, subst_simd_set1(0)));
+  hits &= (1 << count) - 1;
+  if (hits == 0) {
+    return;
+  }
+
+  subst_simd_store(lanes->normal_x, normal_x);
+  subst_simd_store(lanes->normal_y, normal_y);
+  subst_simd_store(lanes->depth, depth);
+  while (hits != 0) {
+    int lane = __builtin_ctz(hits);
+    hits &= hits - 1;
+
+    uint32_t index = contacts->count++;
+    contacts->first[index] = batch->first_ids[first + lane];
+    contacts->second[index] = batch->second_ids[first + lane];
+    contacts->normal_x[index] = lanes->normal_x[lane];
+    contacts->normal_y[index] = lanes->normal_y[lane];
+    contacts->depth[index] = lanes->depth[lane];
+  }
+}
+
+void subst_narrowphase_spheres(const SubstCollisionBatch *batch,
+                               SubstContactSet *contacts) {
+  NarrowphaseLanes lanes;
+  SubstSimdFloat zero = subst_simd_set1(0.f);
+  SubstSimdFloat one = subst_simd_set1(1.f);
+  SubstSimdFloat epsilon = subst_simd_set1(NARROWPHASE_EPSILON);
+
+  contact_set_reserve(contacts, contacts->count + batch->count);
+  for (uint32_t i = 0; i < batch->count; i += SUBST_SIMD_WIDTH) {
+    SubstSimdFloat dx = subst_simd_sub(subst_simd_load(&batch->second_x[i]),
+                                       subst_simd_load(&batch->first_x[i]));
+    SubstSimdFloat dy = subst_simd_sub(subst_simd_load(&batch->second_y[i]),
+                                       subst_simd_load(&batch->first_y[i]));
+    SubstSimdFloat distance =
+        subst_simd_sqrt(subst_simd_madd(dx, dx, subst_simd_mul(dy, dy)));
+    SubstSimdFloat reach =
+        subst_simd_add(subst_simd_load(&batch->first_extent_x[i]),
+                       subst_simd_load(&batch->second_extent_x[i]));
+
+    // Concentric spheres have no direction between them so push along x
+    SubstSimdMask is_centered = subst_simd_less(distance, epsilon);
+    SubstSimdFloat inv_distance =
+        subst_simd_div(one, subst_simd_max(distance, epsilon));
+    narrowphase_lanes_emit(
+        &lanes,
+        subst_simd_select(is_centered, one, subst_simd_mul(dx, inv_distance)),
+        subst_simd_select(is_centered, zero, subst_simd_mul(dy, inv_distance)),
+        subst_simd_sub(reach, distance), batch, i, contacts);
+  }
+}
+
+// Picks +1 where a is less than b and -1 elsewhere
+static inline SubstSimdFloat narrowphase_direction(SubstSimdFloat a,
+                                                   SubstSimdFloat b) {
+  return subst_simd_select(subst_simd_less(a, b), subst_simd_set1(1.f),
+                           subst_simd_set1(-1.f));
+}
+
+void subst_narrowphase_sphere_boxes(const SubstCollisionBatch *batch,
+                                    SubstContactSet *contacts) {
+  NarrowphaseLanes lanes;
+  SubstSimdFloat zero = subst_simd_set1(0.f);
+  SubstSimdFloat epsilon = subst_simd_set1(NARROWPHASE_EPSILON);
+
+  contact_set_reserve(contacts, contacts->count + batch->count);
+  for (uint32_t i = 0; i < batch->count; i += SUBST_SIMD_WIDTH) {
+    SubstSimdFloat sphere_x = subst_simd_load(&batch->first_x[i]);
+    SubstSimdFloat sphere_y = subst_simd_load(&batch->first_y[i]);
+    SubstSimdFloat radius = subst_simd_load(&batch->first_extent_x[i]);
+    SubstSimdFloat box_x = subst_simd_load(&batch->second_x[i]);
+    SubstSimdFloat box_y = subst_simd_load(&batch->second_y[i]);
+    SubstSimdFloat half_width = subst_simd_load(&batch->second_extent_x[i]);
+    SubstSimdFloat half_height = subst_simd_load(&batch->second_extent_y[i]);
+
+    // Offset from the closest point on the box to the sphere's center
+    SubstSimdFloat dx = subst_simd_sub(
+        sphere_x,
+        subst_simd_min(subst_simd_max(sphere_x,
+                                      subst_simd_sub(box_x, half_width)),
+                       subst_simd_add(box_x, half_width)));
+    SubstSimdFloat dy = subst_simd_sub(
+        sphere_y,
+        subst_simd_min(subst_simd_max(sphere_y,
+                                      subst_simd_sub(box_y, half_height)),
+                       subst_simd_add(box_y, half_height)));
+    SubstSimdFloat distance =
+        subst_simd_sqrt(subst_simd_madd(dx, dx, subst_simd_mul(dy, dy)));
+    // Negated so that the normal points from the sphere toward the box
+    SubstSimdFloat inv_distance = subst_simd_div(
+        subst_simd_set1(-1.f), subst_simd_max(distance, epsilon));
+
+    // A center inside the box is pushed out through the nearest face
+    SubstSimdFloat face_x = subst_simd_sub(
+        half_width, subst_simd_abs(subst_simd_sub(sphere_x, box_x)));
+    SubstSimdFloat face_y = subst_simd_sub(
+        half_height, subst_simd_abs(subst_simd_sub(sphere_y, box_y)));
+    SubstSimdMask is_face_x = subst_simd_less(face_x, face_y);
+    SubstSimdFloat inside_normal_x = subst_simd_select(
+        is_face_x, narrowphase_direction(sphere_x, box_x), zero);
+    SubstSimdFloat inside_normal_y = subst_simd_select(
+        is_face_x, zero, narrowphase_direction(sphere_y, box_y));
+    SubstSimdFloat inside_depth =
+        subst_simd_add(radius, subst_simd_min(face_x, face_y));
+
+    SubstSimdMask is_inside = subst_simd_less(distance, epsilon);
+    narrowphase_lanes_emit(
+        &lanes,
+        subst_simd_select(is_inside, inside_normal_x,
+                          subst_simd_mul(dx, inv_distance)),
+        subst_simd_select(is_inside, inside_normal_y,
+                          subst_simd_mul(dy, inv_distance)),
+        subst_simd_select(is_inside, inside_depth,
+                          subst_simd_sub(radius, distance)),
+        batch, i, contacts);
+  }
+}
+
+void subst_narrowphase_boxes(const SubstCollisionBatch *batch,
+                             SubstContactSet *contacts) {
+  NarrowphaseLanes lanes;
+  SubstSimdFloat zero = subst_simd_set1(0.f);
+
+  contact_set_reserve(contacts, contacts->count + batch->count);
+  for (uint32_t i = 0; i < batch->count; i += SUBST_SIMD_WIDTH) {
+    SubstSimdFloat first_x = subst_simd_load(&batch->first_x[i]);
+    SubstSimdFloat first_y = subst_simd_load(&batch->first_y[i]);
+    SubstSimdFloat second_x = subst_simd_load(&batch->second_x[i]);
+    SubstSimdFloat second_y = subst_simd_load(&batch->second_y[i]);
+
+    // Separate along whichever axis overlaps the least
+    SubstSimdFloat overlap_x = subst_simd_sub(
+        subst_simd_add(subst_simd_load(&batch->first_extent_x[i]),
+                       subst_simd_load(&batch->second_extent_x[i])),
+        subst_simd_abs(subst_simd_sub(second_x, first_x)));
+    SubstSimdFloat overlap_y = subst_simd_sub(
+        subst_simd_add(subst_simd_load(&batch->first_extent_y[i]),
+                       subst_simd_load(&batch->second_extent_y[i])),
+        subst_simd_abs(subst_simd_sub(second_y, first_y)));
+    SubstSimdMask is_axis_x = subst_simd_less(overlap_x, overlap_y);
+
+    narrowphase_lanes_emit(
+        &lanes,
+        subst_simd_select(is_axis_x, narrowphase_direction(first_x, second_x),
+                          zero),
+        subst_simd_select(is_axis_x, zero,
+                          narrowphase_direction(first_y, second_y)),
+        subst_simd_min(overlap_x, overlap_y), batch, i, contacts);
+  }
+}
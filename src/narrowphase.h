@@ -0,0 +1,76 @@
+#ifndef __subst_narrowphase_h
+#define __subst_narrowphase_h
+
+#include <inttypes.h>
+
+// Candidate pairs copied out of the broadphase into parallel arrays so that
+// a whole vector of pairs can be loaded at once.  Extents hold the radius
+// twice for spheres and the half width and height for boxes.  The float
+// arrays are SIMD aligned and padded.
+typedef struct {
+  uint32_t count;
+  uint32_t capacity;
+  uint32_t *first_ids;
+  uint32_t *second_ids;
+  float *first_x;
+  float *first_y;
+  float *first_extent_x;
+  float *first_extent_y;
+  float *second_x;
+  float *second_y;
+  float *second_extent_x;
+  float *second_extent_y;
+} SubstCollisionBatch;
+
+// Normals are unit length and point from the first collider toward the
+// second, depth is how far they would have to move apart along it
+typedef struct {
+  uint32_t count;
+  uint32_t capacity;
+  uint32_t *first;
+  uint32_t *second;
+  float *normal_x;
+  float *normal_y;
+  float *depth;
+} SubstContactSet;
+
+void subst_collision_batch_init(SubstCollisionBatch *batch);
+void subst_collision_batch_free(SubstCollisionBatch *batch);
+void subst_collision_batch_grow(SubstCollisionBatch *batch);
+
+static inline void subst_collision_batch_add(
+    SubstCollisionBatch *batch, uint32_t first_id, float first_x,
+    float first_y, float first_extent_x, float first_extent_y,
+    uint32_t second_id, float second_x, float second_y, float second_extent_x,
+    float second_extent_y) {
+  if (batch->count == batch->capacity) {
+    subst_collision_batch_grow(batch);
+  }
+
+  uint32_t i = batch->count++;
+  batch->first_ids[i] = first_id;
+  batch->first_x[i] = first_x;
+  batch->first_y[i] = first_y;
+  batch->first_extent_x[i] = first_extent_x;
+  batch->first_extent_y[i] = first_extent_y;
+  batch->second_ids[i] = second_id;
+  batch->second_x[i] = second_x;
+  batch->second_y[i] = second_y;
+  batch->second_extent_x[i] = second_extent_x;
+  batch->second_extent_y[i] = second_extent_y;
+}
+
+void subst_contact_set_init(SubstContactSet *contacts);
+void subst_contact_set_free(SubstContactSet *contacts);
+
+// Each of these tests a vector's worth of candidate pairs at a time and
+// appends a contact for every pair that touches.  Sphere and box pairs list
+// the sphere first.
+void subst_narrowphase_spheres(const SubstCollisionBatch *batch,
+                               SubstContactSet *contacts);
+void subst_narrowphase_sphere_boxes(const SubstCollisionBatch *batch,
+                                    SubstContactSet *contacts);
+void subst_narrowphase_boxes(const SubstCollisionBatch *batch,
+                             SubstContactSet *contacts);
+
+#endif
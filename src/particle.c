@@ -1,77 +1,251 @@
+#include <cglm/cglm.h>
+#include <float.h>
+#include <math.h>
 #include <mesche.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "log.h"
 #include "particle.h"
+#include "profiler.h"
 #include "renderer.h"
+#include "simd.h"
+#include "thread_pool.h"
 
-typedef struct {
-  float min;
-  float max;
-} SubstParticleFactor;
+static void particle_source_grow(SubstParticleSource *source, int capacity) {
+  if (capacity > source->config.max_particles) {
+    capacity = source->config.max_particles;
+  }
 
-typedef struct {
-  float size;
-  float pos_x, pos_y;
-  float vel_x, vel_y;
-  float time_left; // If this is 0, the particle is done
-  SubstColor color;
-} SubstParticle;
+  // Zero the new arrays so that the padding past the last particle never
+  // holds values that are slow to compute with
+  size_t field_size = subst_simd_padded_count(capacity) * sizeof(float);
+  for (int i = 0; i < SUBST_PARTICLE_FIELD_COUNT; i++) {
+    float *field = subst_simd_floats_alloc(capacity);
+    memset(field, 0, field_size);
+    if (source->fields[i] != NULL) {
+      memcpy(field, source->fields[i], source->num_particles * sizeof(float));
+      free(source->fields[i]);
+    }
 
-typedef struct {
-  // Source Configuration
-  int max_particles;
-  float geometry;
-  SubstParticleFactor size;
-  SubstParticleFactor interval;
-  SubstParticleFactor lifetime;
-  SubstParticleFactor vel_x;
-  SubstParticleFactor vel_y;
-  SubstColor color;
-
-  // Source State
-  float next_particle_time;
-  SubstParticle *particles;
-  int num_particles;
-  int oldest_particle;
-} SubstParticleSource;
-
-void particle_source_free_func(MescheMemory *mem, void *obj) {
-  SubstParticleSource *source = (SubstParticleSource *)obj;
-  free(source->particles);
-  free(source);
-}
-
-const ObjectPointerType SubstParticleSourceType = {
-    .name = "particle-source", .free_func = particle_source_free_func};
+    source->fields[i] = field;
+  }
 
-typedef struct {
-  float current_time;
-  float origin_x, origin_y;
-  ObjectArray *sources;
-} SubstParticleSystem;
+  source->capacity = capacity;
+}
 
-void particle_system_mark_func(MescheMemory *mem, Object *obj) {
-  SubstParticleSystem *system = (SubstParticleSystem *)obj;
-  mesche_gc_mark_object((VM *)mem, (Object *)system->sources);
+static float particle_curve_value(const SubstParticleCurve *curve, float t) {
+  if (curve->ease == NULL) {
+    return glm_bezier(t, curve->start, curve->control[0], curve->control[1],
+                      curve->end);
+  }
+
+  return glm_lerp(curve->start, curve->end, curve->ease(t));
 }
 
-const ObjectPointerType SubstParticleSystemType = {
-    .name = "particle-system", .mark_func = particle_system_mark_func};
+static void particle_source_curves_bake(SubstParticleSource *source) {
+  SubstParticleSourceConfig *config = &source->config;
 
-Value subst_particle_make_system_msc(VM *vm, int arg_count, Value *args) {
+  // Sample every curve once here so that particles only need a table lookup
+  for (int i = 0; i < SUBST_PARTICLE_CURVE_SAMPLES; i++) {
+    float t = i / (float)(SUBST_PARTICLE_CURVE_SAMPLES - 1);
+    float blend = particle_curve_value(&config->color_curve, t);
+    SubstColor *color = &source->color_table[i];
+
+    color->r = glm_lerp(config->color.r, config->end_color.r, blend);
+    color->g = glm_lerp(config->color.g, config->end_color.g, blend);
+    color->b = glm_lerp(config->color.b, config->end_color.b, blend);
+    color->a = glm_lerp(config->color.a, config->end_color.a, blend) *
+               particle_curve_value(&config->alpha_curve, t);
+    source->size_table[i] = particle_curve_value(&config->size_curve, t);
+  }
+
+  // The largest a particle can get, which pads the bounds
+  source->max_size = 0;
+  for (int i = 0; i < SUBST_PARTICLE_CURVE_SAMPLES; i++) {
+    source->max_size =
+        fmaxf(source->max_size, config->size.max * source->size_table[i]);
+  }
+}
+
+// Empties the bounds while keeping them flat so that glm_aabb_isvalid only
+// depends on whether a point was added
+static inline void particle_bounds_reset(vec3 bounds[2]) {
+  glm_vec3_copy((vec3){FLT_MAX, FLT_MAX, 0.f}, bounds[0]);
+  glm_vec3_copy((vec3){-FLT_MAX, -FLT_MAX, 0.f}, bounds[1]);
+}
+
+static inline void particle_bounds_add(vec3 bounds[2], float x, float y) {
+  bounds[0][0] = fminf(bounds[0][0], x);
+  bounds[0][1] = fminf(bounds[0][1], y);
+  bounds[1][0] = fmaxf(bounds[1][0], x);
+  bounds[1][1] = fmaxf(bounds[1][1], y);
+}
+
+static void particle_source_init(SubstParticleSource *source,
+                                 const SubstParticleSourceConfig *config) {
+  source->config = *config;
+  source->next_particle_time = 0;
+  source->num_particles = 0;
+  source->capacity = 0;
+  memset(source->fields, 0, sizeof(source->fields));
+  source->gpu = NULL;
+  source->gpu_pending_time = 0;
+  particle_source_curves_bake(source);
+  particle_bounds_reset(source->bounds);
+
+  // GPU state is created on the first render when a GL context is current
+  if (!config->is_gpu) {
+    particle_source_grow(source, SUBST_PARTICLE_INITIAL_CAPACITY);
+  }
+}
+
+static void particle_source_release(SubstParticleSource *source) {
+  for (int i = 0; i < SUBST_PARTICLE_FIELD_COUNT; i++) {
+    free(source->fields[i]);
+  }
+
+  if (source->gpu != NULL) {
+    subst_particle_gpu_free(source->gpu);
+  }
+}
+
+static void particle_source_reserve(SubstParticleSource *source, int count) {
+  int capacity = source->capacity;
+  while (capacity < count) {
+    capacity *= 2;
+  }
+
+  if (capacity != source->capacity) {
+    particle_source_grow(source, capacity);
+  }
+}
+
+static void particle_source_compact(SubstParticleSource *source,
+                                    int first) {
+  // Move the last live particle into each dead slot so that the live ones
+  // stay packed at the front.  Particles before first are known to be alive.
+  for (int i = first; i < source->num_particles;) {
+    if (source->time_left[i] > 0) {
+      i++;
+      continue;
+    }
+
+    int last = --source->num_particles;
+    for (int field = 0; field < SUBST_PARTICLE_FIELD_COUNT; field++) {
+      source->fields[field][i] = source->fields[field][last];
+    }
+  }
+}
+
+SubstParticleSystem *
+subst_particle_system_create(const SubstParticleSourceConfig *configs,
+                             int config_count) {
   SubstParticleSystem *system = malloc(sizeof(SubstParticleSystem));
-  system->sources = mesche_object_make_array(
-      vm); // malloc(sizeof(SubstParticleSource *) * arg_count);
   system->current_time = 0;
   system->origin_x = 0;
   system->origin_y = 0;
 
+  // Systems get distinct but repeatable streams until they are seeded
+  static uint64_t next_seed = 1;
+  subst_random_seed(&system->random, next_seed++);
+
+  // Every system gets its own copy of the sources so that they can be shared
+  // between systems without sharing particles
+  system->source_count = config_count;
+  system->sources = malloc(sizeof(SubstParticleSource) * config_count);
+  for (int i = 0; i < config_count; i++) {
+    particle_source_init(&system->sources[i], &configs[i]);
+  }
+
+  system->force_count = 0;
+  system->forces = NULL;
+  system->collider_count = 0;
+  system->colliders = NULL;
+
+  // Level of detail is off until it's asked for
+  particle_bounds_reset(system->bounds);
+  system->sleep_offscreen = false;
+  system->lod_min_size = 0;
+  system->is_visible = true;
+  system->lod_level = SUBST_PARTICLE_LOD_FULL;
+  system->skipped_time = 0;
+  system->skipped_updates = 0;
+
+  return system;
+}
+
+void subst_particle_system_free(SubstParticleSystem *system) {
+  for (int i = 0; i < system->source_count; i++) {
+    particle_source_release(&system->sources[i]);
+  }
+
+  free(system->sources);
+  free(system->forces);
+  free(system->colliders);
+  free(system);
+}
+
+void subst_particle_system_seed(SubstParticleSystem *system, uint64_t seed) {
+  subst_random_seed(&system->random, seed);
+}
+
+int subst_particle_system_force_add(SubstParticleSystem *system,
+                                    const SubstParticleForce *force) {
+  system->forces = realloc(system->forces, sizeof(SubstParticleForce) *
+                                               (system->force_count + 1));
+  system->forces[system->force_count] = *force;
+
+  return system->force_count++;
+}
+
+int subst_particle_system_collider_add(SubstParticleSystem *system,
+                                       const SubstParticleCollider *collider) {
+  system->colliders =
+      realloc(system->colliders,
+              sizeof(SubstParticleCollider) * (system->collider_count + 1));
+  system->colliders[system->collider_count] = *collider;
+
+  return system->collider_count++;
+}
+
+void subst_particle_system_lod_set(SubstParticleSystem *system,
+                                   bool sleep_offscreen, float min_size) {
+  system->sleep_offscreen = sleep_offscreen;
+  system->lod_min_size = min_size;
+  if (!sleep_offscreen && min_size <= 0) {
+    system->lod_level = SUBST_PARTICLE_LOD_FULL;
+  }
+}
+
+void subst_particle_system_forces_clear(SubstParticleSystem *system) {
+  system->force_count = 0;
+}
+
+void subst_particle_system_colliders_clear(SubstParticleSystem *system) {
+  system->collider_count = 0;
+}
+
+void particle_system_free_func(MescheMemory *mem, void *obj) {
+  subst_particle_system_free((SubstParticleSystem *)obj);
+}
+
+const ObjectPointerType SubstParticleSystemType = {
+    .name = "particle-system", .free_func = particle_system_free_func};
+
+Value subst_particle_make_system_msc(VM *vm, int arg_count, Value *args) {
+  SubstParticleSourceConfig *configs =
+      malloc(sizeof(SubstParticleSourceConfig) * arg_count);
+
   // Read in and process every particle source argument
   for (int i = 0; i < arg_count; i++) {
-    mesche_value_array_write((MescheMemory *)vm, &system->sources->objects,
-                             args[i]);
+    configs[i] = *(SubstParticleSourceConfig *)AS_POINTER(args[i])->ptr;
   }
 
+  SubstParticleSystem *system =
+      subst_particle_system_create(configs, arg_count);
+  free(configs);
+
   return OBJECT_VAL(
       mesche_object_make_pointer_type(vm, system, &SubstParticleSystemType));
 }
@@ -96,13 +270,96 @@ void read_particle_factor(SubstParticleFactor *factor, Value *args,
   *index += 1;
 }
 
+static const struct {
+  const char *name;
+  float (*ease)(float t);
+} particle_ease_names[] = {
+    {"linear", glm_ease_linear},
+    {"sine-in", glm_ease_sine_in},
+    {"sine-out", glm_ease_sine_out},
+    {"sine-inout", glm_ease_sine_inout},
+    {"quad-in", glm_ease_quad_in},
+    {"quad-out", glm_ease_quad_out},
+    {"quad-inout", glm_ease_quad_inout},
+    {"cubic-in", glm_ease_cubic_in},
+    {"cubic-out", glm_ease_cubic_out},
+    {"cubic-inout", glm_ease_cubic_inout},
+    {"quart-in", glm_ease_quart_in},
+    {"quart-out", glm_ease_quart_out},
+    {"quart-inout", glm_ease_quart_inout},
+    {"quint-in", glm_ease_quint_in},
+    {"quint-out", glm_ease_quint_out},
+    {"quint-inout", glm_ease_quint_inout},
+    {"exp-in", glm_ease_exp_in},
+    {"exp-out", glm_ease_exp_out},
+    {"exp-inout", glm_ease_exp_inout},
+    {"circ-in", glm_ease_circ_in},
+    {"circ-out", glm_ease_circ_out},
+    {"circ-inout", glm_ease_circ_inout},
+    {"back-in", glm_ease_back_in},
+    {"back-out", glm_ease_back_out},
+    {"back-inout", glm_ease_back_inout},
+    {"elastic-in", glm_ease_elast_in},
+    {"elastic-out", glm_ease_elast_out},
+    {"elastic-inout", glm_ease_elast_inout},
+    {"bounce-in", glm_ease_bounce_in},
+    {"bounce-out", glm_ease_bounce_out},
+    {"bounce-inout", glm_ease_bounce_inout},
+};
+
+static float (*particle_ease_lookup(const char *name))(float t) {
+  for (size_t i = 0;
+       i < sizeof(particle_ease_names) / sizeof(particle_ease_names[0]); i++) {
+    if (strcmp(particle_ease_names[i].name, name) == 0) {
+      return particle_ease_names[i].ease;
+    }
+  }
+
+  subst_log("Unknown particle curve ease: %s\n", name);
+  return glm_ease_linear;
+}
+
+static void read_particle_curve(SubstParticleCurve *curve, Value value,
+                                float start, float end) {
+  curve->start = start;
+  curve->end = end;
+  curve->ease = glm_ease_linear;
+
+  if (IS_NUMBER(value)) {
+    // Treat this as a constant
+    curve->start = AS_NUMBER(value);
+    curve->end = curve->start;
+  } else if (IS_STRING(value)) {
+    // Only the shape between the default values was given
+    curve->ease = particle_ease_lookup(AS_CSTRING(value));
+  } else if (IS_CONS(value)) {
+    // A list of the start and end values followed by either an ease name or
+    // the two bezier control values
+    ObjectCons *cons = AS_CONS(value);
+    curve->start = AS_NUMBER(cons->car);
+    cons = AS_CONS(cons->cdr);
+    curve->end = AS_NUMBER(cons->car);
+
+    if (IS_CONS(cons->cdr)) {
+      cons = AS_CONS(cons->cdr);
+      if (IS_STRING(cons->car)) {
+        curve->ease = particle_ease_lookup(AS_CSTRING(cons->car));
+      } else {
+        curve->ease = NULL;
+        curve->control[0] = AS_NUMBER(cons->car);
+        curve->control[1] = AS_NUMBER(AS_CONS(cons->cdr)->car);
+      }
+    }
+  }
+}
+
 Value subst_particle_make_source_msc(VM *vm, int arg_count, Value *args) {
-  if (arg_count != 8) {
-    subst_log("Function requires 8 parameters.");
+  if (arg_count != 13) {
+    subst_log("Function requires 13 parameters.");
   }
 
   // Create the particle source
-  SubstParticleSource *source = malloc(sizeof(SubstParticleSource));
+  SubstParticleSourceConfig *source = malloc(sizeof(SubstParticleSourceConfig));
   source->max_particles = AS_NUMBER(args[0]);
   source->geometry = AS_NUMBER(args[1]);
   source->color = *((SubstColor *)AS_POINTER(args[2])->ptr);
@@ -114,95 +371,575 @@ Value subst_particle_make_source_msc(VM *vm, int arg_count, Value *args) {
   read_particle_factor(&source->lifetime, args, &next_index);
   read_particle_factor(&source->vel_x, args, &next_index);
   read_particle_factor(&source->vel_y, args, &next_index);
+  source->is_gpu = AS_BOOL(args[8]);
 
-  // Allocate the particle array
-  source->particles = malloc(sizeof(SubstParticle) * source->max_particles);
-  source->num_particles = 0;
-  source->oldest_particle = 0;
+  // Without an end color the color curve has nothing to blend toward
+  source->end_color = source->color;
+  if (IS_POINTER(args[9])) {
+    source->end_color = *((SubstColor *)AS_POINTER(args[9])->ptr);
+  }
+
+  read_particle_curve(&source->color_curve, args[10], 0.f, 1.f);
+  read_particle_curve(&source->size_curve, args[11], 1.f, 1.f);
+  read_particle_curve(&source->alpha_curve, args[12], 1.f, 1.f);
 
   /* (make-particle-source-internal max-particles geometry */
   /*                                color size */
   /*                                interval lifetime */
-  /*                                vel-x vel-y) */
+  /*                                vel-x vel-y gpu */
+  /*                                end-color color-curve */
+  /*                                size-curve alpha-curve) */
 
-  return OBJECT_VAL(
-      mesche_object_make_pointer_type(vm, source, &SubstParticleSourceType));
+  // Sources are only a description until they are added to a system
+  return OBJECT_VAL(mesche_object_make_pointer(vm, source, true));
 }
 
-double rand_double(double min, double max) {
-  double range = max - min;
-  double val = rand() % 100 / (double)100;
-  return (range * val) + min;
+static float particle_factor_next_value(SubstRandom *random,
+                                        SubstParticleFactor *factor) {
+  return subst_random_range(random, factor->min, factor->max);
 }
 
-double particle_factor_next_value(SubstParticleFactor *factor) {
-  return rand_double(factor->min, factor->max);
+static inline void particle_force_apply(const SubstParticleForce *force,
+                                        float time_delta, SubstSimdFloat pos_x,
+                                        SubstSimdFloat pos_y,
+                                        SubstSimdFloat *vel_x,
+                                        SubstSimdFloat *vel_y) {
+  SubstSimdFloat delta = subst_simd_set1(time_delta);
+
+  switch (force->type) {
+  case SUBST_PARTICLE_FORCE_GRAVITY:
+    *vel_x = subst_simd_madd(subst_simd_set1(force->x), delta, *vel_x);
+    *vel_y = subst_simd_madd(subst_simd_set1(force->y), delta, *vel_y);
+    break;
+  case SUBST_PARTICLE_FORCE_DRAG: {
+    // Clamped so that a long step can't turn the particles around
+    float keep = 1.f - force->strength * time_delta;
+    SubstSimdFloat factor = subst_simd_set1(keep > 0 ? keep : 0);
+    *vel_x = subst_simd_mul(*vel_x, factor);
+    *vel_y = subst_simd_mul(*vel_y, factor);
+    break;
+  }
+  case SUBST_PARTICLE_FORCE_RADIAL:
+  case SUBST_PARTICLE_FORCE_VORTEX: {
+    // The small bias keeps particles sitting on the center from dividing by
+    // zero
+    SubstSimdFloat dx = subst_simd_sub(subst_simd_set1(force->x), pos_x);
+    SubstSimdFloat dy = subst_simd_sub(subst_simd_set1(force->y), pos_y);
+    SubstSimdFloat distance = subst_simd_sqrt(subst_simd_madd(
+        dx, dx, subst_simd_madd(dy, dy, subst_simd_set1(1e-6f))));
+    SubstSimdFloat scale =
+        subst_simd_div(subst_simd_set1(force->strength * time_delta), distance);
+
+    if (force->radius > 0) {
+      SubstSimdFloat falloff = subst_simd_sub(
+          subst_simd_set1(1.f),
+          subst_simd_mul(distance, subst_simd_set1(1.f / force->radius)));
+      falloff = subst_simd_max(falloff, subst_simd_set1(0));
+      scale = subst_simd_mul(scale, falloff);
+    }
+
+    if (force->type == SUBST_PARTICLE_FORCE_RADIAL) {
+      *vel_x = subst_simd_madd(dx, scale, *vel_x);
+      *vel_y = subst_simd_madd(dy, scale, *vel_y);
+    } else {
+      *vel_x = subst_simd_madd(dy, scale, *vel_x);
+      *vel_y = subst_simd_sub(*vel_y, subst_simd_mul(dx, scale));
+    }
+    break;
+  }
+  }
 }
 
-SubstParticleSource *particle_system_source(SubstParticleSystem *system,
-                                            int index) {
-  return (SubstParticleSource
-              *)(AS_POINTER(system->sources->objects.values[index])->ptr);
+static inline void particle_collider_apply(
+    const SubstParticleCollider *collider, SubstSimdFloat *pos_x,
+    SubstSimdFloat *pos_y, SubstSimdFloat *vel_x, SubstSimdFloat *vel_y,
+    SubstSimdFloat *time_left) {
+  const SubstSphere *sphere = &collider->sphere;
+  SubstSimdFloat zero = subst_simd_set1(0);
+  SubstSimdFloat center_x = subst_simd_set1(sphere->center_x);
+  SubstSimdFloat center_y = subst_simd_set1(sphere->center_y);
+  SubstSimdFloat dx = subst_simd_sub(*pos_x, center_x);
+  SubstSimdFloat dy = subst_simd_sub(*pos_y, center_y);
+  SubstSimdFloat distance_squared =
+      subst_simd_madd(dx, dx, subst_simd_mul(dy, dy));
+  SubstSimdMask inside = subst_simd_less(
+      distance_squared, subst_simd_set1(sphere->radius * sphere->radius));
+
+  // Expired particles are dropped by the compaction after the update
+  if (collider->response == SUBST_PARTICLE_COLLISION_KILL) {
+    *time_left = subst_simd_select(inside, zero, *time_left);
+    return;
+  }
+
+  SubstSimdFloat distance =
+      subst_simd_sqrt(subst_simd_max(distance_squared, subst_simd_set1(1e-6f)));
+  SubstSimdFloat normal_x = subst_simd_div(dx, distance);
+  SubstSimdFloat normal_y = subst_simd_div(dy, distance);
+
+  // Push the particles that got inside back out to the surface
+  SubstSimdFloat radius = subst_simd_set1(sphere->radius);
+  *pos_x =
+      subst_simd_select(inside, subst_simd_madd(normal_x, radius, center_x),
+                        *pos_x);
+  *pos_y =
+      subst_simd_select(inside, subst_simd_madd(normal_y, radius, center_y),
+                        *pos_y);
+
+  // Reflect only the part of the velocity that heads into the sphere
+  SubstSimdFloat approach = subst_simd_min(
+      subst_simd_madd(normal_x, *vel_x, subst_simd_mul(normal_y, *vel_y)),
+      zero);
+  SubstSimdFloat impulse = subst_simd_select(
+      inside,
+      subst_simd_mul(approach, subst_simd_set1(1.f + collider->restitution)),
+      zero);
+  *vel_x = subst_simd_sub(*vel_x, subst_simd_mul(normal_x, impulse));
+  *vel_y = subst_simd_sub(*vel_y, subst_simd_mul(normal_y, impulse));
 }
 
-Value subst_particle_system_update_msc(VM *vm, int arg_count, Value *args) {
-  SubstParticleSystem *system =
-      ((SubstParticleSystem *)AS_POINTER(args[0])->ptr);
-  double time_delta = AS_NUMBER(args[1]);
+static void particle_source_integrate(SubstParticleSystem *system,
+                                      SubstParticleSource *source,
+                                      float time_delta) {
+  SubstSimdFloat delta = subst_simd_set1(time_delta);
+  SubstSimdFloat min_x = subst_simd_set1(FLT_MAX);
+  SubstSimdFloat min_y = subst_simd_set1(FLT_MAX);
+  SubstSimdFloat max_x = subst_simd_set1(-FLT_MAX);
+  SubstSimdFloat max_y = subst_simd_set1(-FLT_MAX);
+  int vector_end =
+      source->num_particles - source->num_particles % SUBST_SIMD_WIDTH;
+
+  // Advance whole vectors of particles at a time, the arrays are padded so
+  // that the last partial vector can be read and written safely
+  for (int i = 0; i < source->num_particles; i += SUBST_SIMD_WIDTH) {
+    SubstSimdFloat pos_x = subst_simd_load(&source->pos_x[i]);
+    SubstSimdFloat pos_y = subst_simd_load(&source->pos_y[i]);
+    SubstSimdFloat vel_x = subst_simd_load(&source->vel_x[i]);
+    SubstSimdFloat vel_y = subst_simd_load(&source->vel_y[i]);
+    SubstSimdFloat time_left = subst_simd_load(&source->time_left[i]);
+
+    // Forces change the velocity before it moves the particles, then
+    // collisions correct wherever they ended up
+    for (int f = 0; f < system->force_count; f++) {
+      particle_force_apply(&system->forces[f], time_delta, pos_x, pos_y,
+                           &vel_x, &vel_y);
+    }
+
+    pos_x = subst_simd_madd(vel_x, delta, pos_x);
+    pos_y = subst_simd_madd(vel_y, delta, pos_y);
+    time_left = subst_simd_sub(time_left, delta);
+
+    for (int c = 0; c < system->collider_count; c++) {
+      particle_collider_apply(&system->colliders[c], &pos_x, &pos_y, &vel_x,
+                              &vel_y, &time_left);
+    }
+
+    subst_simd_store(&source->pos_x[i], pos_x);
+    subst_simd_store(&source->pos_y[i], pos_y);
+    subst_simd_store(&source->vel_x[i], vel_x);
+    subst_simd_store(&source->vel_y[i], vel_y);
+    subst_simd_store(&source->time_left[i], time_left);
+
+    // Padding lanes hold stale particles so the partial vector at the end
+    // is added to the bounds separately
+    if (i < vector_end) {
+      min_x = subst_simd_min(min_x, pos_x);
+      min_y = subst_simd_min(min_y, pos_y);
+      max_x = subst_simd_max(max_x, pos_x);
+      max_y = subst_simd_max(max_y, pos_y);
+    }
+  }
+
+  _Alignas(SUBST_SIMD_ALIGN) float lanes[4][SUBST_SIMD_ALIGN / sizeof(float)];
+  subst_simd_store(lanes[0], min_x);
+  subst_simd_store(lanes[1], min_y);
+  subst_simd_store(lanes[2], max_x);
+  subst_simd_store(lanes[3], max_y);
+  for (int lane = 0; lane < SUBST_SIMD_WIDTH; lane++) {
+    particle_bounds_add(source->bounds, lanes[0][lane], lanes[1][lane]);
+    particle_bounds_add(source->bounds, lanes[2][lane], lanes[3][lane]);
+  }
+
+  for (int i = vector_end; i < source->num_particles; i++) {
+    particle_bounds_add(source->bounds, source->pos_x[i], source->pos_y[i]);
+  }
+}
+
+static void particle_source_spawn_block(SubstParticleSystem *system,
+                                        SubstParticleSource *source, int first,
+                                        int count) {
+  SubstParticleSourceConfig *config = &source->config;
+  int end = first + count;
+
+  // Fill one field at a time across the whole block
+  subst_random_fill(&system->random, &source->pos_x[first], count,
+                    system->origin_x, system->origin_x + config->geometry);
+  subst_random_fill(&system->random, &source->pos_y[first], count,
+                    system->origin_y, system->origin_y + config->geometry);
+  subst_random_fill(&system->random, &source->vel_x[first], count,
+                    config->vel_x.min, config->vel_x.max);
+  subst_random_fill(&system->random, &source->vel_y[first], count,
+                    config->vel_y.min, config->vel_y.max);
+  subst_random_fill(&system->random, &source->size[first], count,
+                    config->size.min, config->size.max);
+
+  // The block's time_left slots hold how long ago each particle was due, so
+  // move each one forward to where it would be now
+  float lifetimes[64];
+  for (int i = first; i < end; i += 64) {
+    int length = end - i < 64 ? end - i : 64;
+    subst_random_fill(&system->random, lifetimes, length,
+                      config->lifetime.min, config->lifetime.max);
+
+    for (int j = 0; j < length; j++) {
+      float age = source->time_left[i + j];
+      source->pos_x[i + j] += source->vel_x[i + j] * age;
+      source->pos_y[i + j] += source->vel_y[i + j] * age;
+      source->time_left[i + j] = lifetimes[j] - age;
+      source->inv_lifetime[i + j] = 1.f / lifetimes[j];
+      particle_bounds_add(source->bounds, source->pos_x[i + j],
+                          source->pos_y[i + j]);
+    }
+  }
+}
+
+static void particle_source_emit(SubstParticleSystem *system,
+                                 SubstParticleSource *source) {
+  SubstParticleSourceConfig *config = &source->config;
+  int first = source->num_particles;
+  int count = 0;
+  float interval_scale = system->lod_level == SUBST_PARTICLE_LOD_REDUCED
+                             ? SUBST_PARTICLE_LOD_REDUCED_SPAWN_SCALE
+                             : 1.f;
+
+  // Spawn every particle that came due since the last update
+  while (source->next_particle_time <= system->current_time) {
+    // The rest of this update's particles won't fit so skip past them
+    if (first + count == config->max_particles) {
+      source->next_particle_time =
+          system->current_time +
+          particle_factor_next_value(&system->random, &config->interval) *
+              interval_scale;
+      break;
+    }
+
+    particle_source_reserve(source, first + count + 1);
+    source->time_left[first + count] =
+        system->current_time - source->next_particle_time;
+    count++;
+
+    // Decide the time for the next particle, a source without an interval
+    // spawns once per update
+    float interval =
+        particle_factor_next_value(&system->random, &config->interval) *
+        interval_scale;
+    if (interval <= 0) {
+      break;
+    }
+
+    source->next_particle_time += interval;
+  }
+
+  if (count > 0) {
+    particle_source_spawn_block(system, source, first, count);
+    source->num_particles += count;
+  }
+}
+
+static void particle_source_reach_box(SubstParticleSystem *system,
+                                      SubstParticleSource *source,
+                                      vec3 box[2]) {
+  SubstParticleSourceConfig *config = &source->config;
+  float lifetime = config->lifetime.max;
+
+  // Where particles can get to from the emitter if no forces act on them
+  box[0][0] = system->origin_x + fminf(config->vel_x.min * lifetime, 0);
+  box[0][1] = system->origin_y + fminf(config->vel_y.min * lifetime, 0);
+  box[0][2] = 0;
+  box[1][0] = system->origin_x + config->geometry +
+              fmaxf(config->vel_x.max * lifetime, 0) + source->max_size;
+  box[1][1] = system->origin_y + config->geometry +
+              fmaxf(config->vel_y.max * lifetime, 0) + source->max_size;
+  box[1][2] = 0;
+}
+
+static void particle_source_update(SubstParticleSystem *system,
+                                   SubstParticleSource *source,
+                                   float time_delta) {
+  SubstParticleSourceConfig *config = &source->config;
+
+  // GPU particles can't be read back cheaply so they are bounded by how far
+  // they can travel
+  if (config->is_gpu) {
+    source->gpu_pending_time += time_delta;
+    particle_source_reach_box(system, source, source->bounds);
+    return;
+  }
+
+  // Update all existing particles, then add the new ones which have already
+  // been moved to their place at the end of the update.  Nothing outlives a
+  // step longer than the longest lifetime, so a system catching up on a
+  // long sleep only spawns the particles that would still be alive now.
+  particle_bounds_reset(source->bounds);
+  if (time_delta < config->lifetime.max) {
+    particle_source_integrate(system, source, time_delta);
+
+    // Free up the slots of expired particles before emitting so that a full
+    // source can reuse them in the same update
+    particle_source_compact(source, 0);
+  } else {
+    source->num_particles = 0;
+  }
+
+  float earliest_time = system->current_time - config->lifetime.max;
+  if (source->next_particle_time < earliest_time) {
+    source->next_particle_time = earliest_time;
+  }
+
+  int first_new = source->num_particles;
+  particle_source_emit(system, source);
+
+  // Drop new particles that were due so long ago that their lifetime
+  // already ran out
+  particle_source_compact(source, first_new);
+
+  // Positions are the top left corner of each particle
+  if (glm_aabb_isvalid(source->bounds)) {
+    source->bounds[1][0] += source->max_size;
+    source->bounds[1][1] += source->max_size;
+  }
+}
+
+static void particle_system_step(SubstParticleSystem *system,
+                                 float time_delta) {
+  // Sleeping systems and reduced ones between steps only keep track of the
+  // time that they will need to catch up on
+  system->skipped_time += time_delta;
+  system->skipped_updates++;
+  if (system->lod_level == SUBST_PARTICLE_LOD_ASLEEP ||
+      (system->lod_level == SUBST_PARTICLE_LOD_REDUCED &&
+       system->skipped_updates < SUBST_PARTICLE_LOD_REDUCED_STEPS)) {
+    return;
+  }
+
+  time_delta = system->skipped_time;
+  system->skipped_time = 0;
+  system->skipped_updates = 0;
 
   // Update the current time for the system
   system->current_time += time_delta;
 
   // Update each of the sources
-  for (int i = 0; i < system->sources->objects.count; i++) {
-    // Has the creation interval passed?
-    SubstParticleSource *source = particle_system_source(system, i);
-    if (system->current_time >= source->next_particle_time) {
-      // Initialize the new particle
-      SubstParticle *particle = NULL;
-      if (source->num_particles < source->max_particles) {
-        // TODO: Factor in oldest_particle index!
-        particle = &source->particles[source->num_particles];
-        source->num_particles++;
-      } else {
-        particle = &source->particles[source->oldest_particle];
-        source->oldest_particle++;
-        if (source->oldest_particle == source->max_particles) {
-          source->oldest_particle = 0;
-        }
-      }
+  particle_bounds_reset(system->bounds);
+  for (int i = 0; i < system->source_count; i++) {
+    particle_source_update(system, &system->sources[i], time_delta);
+    if (glm_aabb_isvalid(system->sources[i].bounds)) {
+      glm_aabb_merge(system->bounds, system->sources[i].bounds,
+                     system->bounds);
+    }
+  }
+}
 
-      // Set particle factors
-      particle->pos_x = system->origin_x + rand_double(0.0, source->geometry);
-      particle->pos_y = system->origin_y + rand_double(0.0, source->geometry);
-      particle->vel_x = particle_factor_next_value(&source->vel_x);
-      particle->vel_y = particle_factor_next_value(&source->vel_y);
-      particle->size = particle_factor_next_value(&source->size);
-      particle->color = source->color; // TODO: Interpolate colors
-      particle->time_left = particle_factor_next_value(&source->lifetime);
+void subst_particle_system_update(SubstParticleSystem *system,
+                                  float time_delta) {
+  subst_profiler_zone_begin("particle-update");
+  particle_system_step(system, time_delta);
+  subst_profiler_zone_end();
+}
 
-      // Decide the time for the next particle
-      source->next_particle_time =
-          system->current_time + particle_factor_next_value(&source->interval);
+typedef struct {
+  SubstParticleSystem **systems;
+  float time_delta;
+} SubstParticleUpdateJob;
+
+static void particle_update_job_run(void *context, int index) {
+  SubstParticleUpdateJob *job = (SubstParticleUpdateJob *)context;
+  particle_system_step(job->systems[index], job->time_delta);
+}
+
+void subst_particle_systems_update_all(SubstParticleSystem **systems,
+                                       int system_count, float time_delta) {
+  // Created on first use so that nothing starts threads it doesn't need
+  static SubstThreadPool *update_pool = NULL;
+  if (update_pool == NULL) {
+    update_pool = subst_thread_pool_create(subst_thread_pool_default_size());
+  }
+
+  // Systems only touch their own particles and generator so each one can be
+  // stepped on any thread
+  subst_profiler_zone_begin("particle-update");
+  SubstParticleUpdateJob job = {.systems = systems, .time_delta = time_delta};
+  subst_thread_pool_run(update_pool, particle_update_job_run, &job,
+                        system_count);
+  subst_profiler_zone_end();
+}
+
+static void particle_source_gpu_render(SubstParticleSystem *system,
+                                       SubstParticleSource *source,
+                                       SubstRenderer *renderer) {
+  SubstParticleSourceConfig *config = &source->config;
+  if (source->gpu == NULL) {
+    source->gpu = subst_particle_gpu_create(config->max_particles);
+  }
+
+  // Every spawn on the GPU is spaced by the mean interval
+  float interval = (config->interval.min + config->interval.max) / 2.f;
+  if (system->lod_level == SUBST_PARTICLE_LOD_REDUCED) {
+    interval *= SUBST_PARTICLE_LOD_REDUCED_SPAWN_SCALE;
+  }
+  SubstParticleGpuStep step = {
+      .time_delta = source->gpu_pending_time,
+      .spawn_interval = interval > 0 ? interval : 0,
+      .first_age = system->current_time - source->next_particle_time,
+      .seed = subst_random_next(&system->random),
+      .origin_x = system->origin_x,
+      .origin_y = system->origin_y,
+      .geometry = config->geometry,
+      .size_range = {config->size.min, config->size.max},
+      .lifetime_range = {config->lifetime.min, config->lifetime.max},
+      .vel_x_range = {config->vel_x.min, config->vel_x.max},
+      .vel_y_range = {config->vel_y.min, config->vel_y.max},
+  };
+
+  // Count the spawns that came due since the last render, a source without
+  // an interval spawns once per render
+  if (source->next_particle_time <= system->current_time) {
+    if (interval > 0) {
+      step.emit_count = (int)(step.first_age / interval) + 1;
+      source->next_particle_time += step.emit_count * interval;
+    } else {
+      step.emit_count = 1;
+      step.first_age = 0;
+      source->next_particle_time = system->current_time;
     }
+  }
 
-    // Update all existing particles
-    for (int j = 0; j < source->num_particles; j++) {
-      // Factor in the oldest_particle index when looping
-      SubstParticle *particle = &source->particles[j];
+  if (step.time_delta > 0 || step.emit_count > 0) {
+    subst_particle_gpu_update(source->gpu, &step);
+    source->gpu_pending_time = 0;
+  }
 
-      // Update lifetime
-      particle->time_left -= time_delta;
-      if (particle->time_left > 0) {
-        // Update position
-        particle->pos_x += particle->vel_x * time_delta;
-        particle->pos_y += particle->vel_y * time_delta;
+  source->num_particles = source->gpu->slots_used;
+  subst_particle_gpu_render(source->gpu, renderer, source->color_table,
+                            source->size_table);
+}
 
-        // TODO: Add fade
-      }
+static void particle_system_lod_update(SubstParticleSystem *system,
+                                       SubstRenderer *renderer) {
+  // Particles can only be seen within their bounds or where the emitters
+  // can send new ones
+  vec3 box[2], reach_box[2];
+  glm_vec3_copy(system->bounds[0], box[0]);
+  glm_vec3_copy(system->bounds[1], box[1]);
+  for (int i = 0; i < system->source_count; i++) {
+    particle_source_reach_box(system, &system->sources[i], reach_box);
+    if (glm_aabb_isvalid(box)) {
+      glm_aabb_merge(box, reach_box, box);
+    } else {
+      glm_vec3_copy(reach_box[0], box[0]);
+      glm_vec3_copy(reach_box[1], box[1]);
     }
   }
 
+  system->is_visible = subst_renderer_box_visible(renderer, box);
+
+  if (!system->is_visible) {
+    system->lod_level = system->sleep_offscreen ? SUBST_PARTICLE_LOD_ASLEEP
+                        : system->lod_min_size > 0 ? SUBST_PARTICLE_LOD_REDUCED
+                                                   : SUBST_PARTICLE_LOD_FULL;
+  } else {
+    float screen_size = fmaxf(box[1][0] - box[0][0], box[1][1] - box[0][1]) *
+                        subst_renderer_pixel_scale(renderer);
+    system->lod_level = screen_size < system->lod_min_size
+                            ? SUBST_PARTICLE_LOD_REDUCED
+                            : SUBST_PARTICLE_LOD_FULL;
+  }
+}
+
+void subst_particle_system_render(SubstParticleSystem *system,
+                                  SubstRenderer *renderer) {
+  // Offscreen systems cost nothing to draw, GPU sources hold on to their
+  // pending time until they can be seen again
+  particle_system_lod_update(system, renderer);
+  if (!system->is_visible) {
+    return;
+  }
+
+  // Render each of the sources
+  for (int i = 0; i < system->source_count; i++) {
+    SubstParticleSource *source = &system->sources[i];
+    if (source->config.is_gpu) {
+      particle_source_gpu_render(system, source, renderer);
+      continue;
+    }
+
+    // Write every live particle straight into the instance buffer
+    SubstRectInstance *instances =
+        subst_renderer_rect_instances_begin(renderer, source->num_particles);
+    if (instances == NULL) {
+      continue;
+    }
+
+    for (int j = 0; j < source->num_particles; j++) {
+      // Look up the curve sample nearest to the particle's age
+      float age = 1.f - source->time_left[j] * source->inv_lifetime[j];
+      age = glm_clamp(age, 0.f, 1.f);
+      int sample = (int)(age * (SUBST_PARTICLE_CURVE_SAMPLES - 1) + 0.5f);
+
+      float size = source->size[j] * source->size_table[sample];
+      instances[j].x = source->pos_x[j];
+      instances[j].y = source->pos_y[j];
+      instances[j].width = size;
+      instances[j].height = size;
+      instances[j].color = source->color_table[sample];
+    }
+
+    // Draw all of the source's particles at once
+    subst_renderer_rect_instances_end(renderer, source->num_particles);
+  }
+}
+
+int subst_particle_system_live_count(SubstParticleSystem *system) {
+  int count = 0;
+  for (int i = 0; i < system->source_count; i++) {
+    count += system->sources[i].num_particles;
+  }
+
+  return count;
+}
+
+Value subst_particle_system_update_msc(VM *vm, int arg_count, Value *args) {
+  SubstParticleSystem *system =
+      ((SubstParticleSystem *)AS_POINTER(args[0])->ptr);
+  double time_delta = AS_NUMBER(args[1]);
+
+  subst_particle_system_update(system, time_delta);
+
+  return TRUE_VAL;
+}
+
+Value subst_particle_systems_update_all_msc(VM *vm, int arg_count,
+                                            Value *args) {
+  if (arg_count != 2) {
+    subst_log("Function requires 2 parameters.");
+  }
+
+  // Gather the systems out of the list so the workers can index them
+  int system_count = 0;
+  for (Value list = args[0]; IS_CONS(list); list = AS_CONS(list)->cdr) {
+    system_count++;
+  }
+
+  SubstParticleSystem **systems =
+      malloc(sizeof(SubstParticleSystem *) * system_count);
+  int index = 0;
+  for (Value list = args[0]; IS_CONS(list); list = AS_CONS(list)->cdr) {
+    systems[index++] =
+        (SubstParticleSystem *)AS_POINTER(AS_CONS(list)->car)->ptr;
+  }
+
+  subst_particle_systems_update_all(systems, system_count, AS_NUMBER(args[1]));
+  free(systems);
+
   return TRUE_VAL;
 }
 
@@ -211,22 +948,7 @@ Value subst_particle_system_render_msc(VM *vm, int arg_count, Value *args) {
   SubstParticleSystem *system =
       ((SubstParticleSystem *)AS_POINTER(args[1])->ptr);
 
-  // TODO: Use OpenGL instanced arrays for this instead!
-
-  // Render each of the sources
-  for (int i = 0; i < system->sources->objects.count; i++) {
-    // Render each of the particles
-    SubstParticleSource *source = particle_system_source(system, i);
-    for (int j = 0; j < source->num_particles; j++) {
-      // TODO: Offset based on oldest_particle
-      SubstParticle *particle = &source->particles[j];
-      if (particle->time_left > 0) {
-        subst_renderer_draw_rect_fill(
-            renderer, particle->pos_x, particle->pos_y, particle->size,
-            particle->size, (float *)&particle->color);
-      }
-    }
-  }
+  subst_particle_system_render(system, renderer);
 
   return TRUE_VAL;
 }
@@ -244,6 +966,199 @@ Value subst_particle_system_origin_set_msc(VM *vm, int arg_count, Value *args) {
   return TRUE_VAL;
 }
 
+Value subst_particle_system_seed_msc(VM *vm, int arg_count, Value *args) {
+  if (arg_count != 2) {
+    subst_log("Function requires 2 parameters.");
+  }
+
+  SubstParticleSystem *system =
+      ((SubstParticleSystem *)AS_POINTER(args[0])->ptr);
+  subst_particle_system_seed(system, (uint64_t)AS_NUMBER(args[1]));
+
+  return TRUE_VAL;
+}
+
+Value subst_particle_system_live_count_msc(VM *vm, int arg_count,
+                                           Value *args) {
+  if (arg_count != 1) {
+    subst_log("Function requires 1 parameter.");
+  }
+
+  SubstParticleSystem *system =
+      ((SubstParticleSystem *)AS_POINTER(args[0])->ptr);
+  return NUMBER_VAL(subst_particle_system_live_count(system));
+}
+
+Value subst_particle_source_live_count_msc(VM *vm, int arg_count,
+                                           Value *args) {
+  if (arg_count != 2) {
+    subst_log("Function requires 2 parameters.");
+  }
+
+  SubstParticleSystem *system =
+      ((SubstParticleSystem *)AS_POINTER(args[0])->ptr);
+  int index = AS_NUMBER(args[1]);
+  if (index < 0 || index >= system->source_count) {
+    return NUMBER_VAL(0);
+  }
+
+  return NUMBER_VAL(system->sources[index].num_particles);
+}
+
+static Value particle_system_force_add(SubstParticleSystem *system,
+                                       SubstParticleForceType type, float x,
+                                       float y, float strength, float radius) {
+  SubstParticleForce force = {.type = type,
+                              .x = x,
+                              .y = y,
+                              .strength = strength,
+                              .radius = radius};
+
+  return NUMBER_VAL(subst_particle_system_force_add(system, &force));
+}
+
+Value subst_particle_system_gravity_add_msc(VM *vm, int arg_count,
+                                            Value *args) {
+  if (arg_count != 3) {
+    subst_log("Function requires 3 parameters.");
+  }
+
+  SubstParticleSystem *system =
+      ((SubstParticleSystem *)AS_POINTER(args[0])->ptr);
+  return particle_system_force_add(system, SUBST_PARTICLE_FORCE_GRAVITY,
+                                   AS_NUMBER(args[1]), AS_NUMBER(args[2]), 0,
+                                   0);
+}
+
+Value subst_particle_system_drag_add_msc(VM *vm, int arg_count, Value *args) {
+  if (arg_count != 2) {
+    subst_log("Function requires 2 parameters.");
+  }
+
+  SubstParticleSystem *system =
+      ((SubstParticleSystem *)AS_POINTER(args[0])->ptr);
+  return particle_system_force_add(system, SUBST_PARTICLE_FORCE_DRAG, 0, 0,
+                                   AS_NUMBER(args[1]), 0);
+}
+
+Value subst_particle_system_field_add_msc(VM *vm, int arg_count, Value *args) {
+  if (arg_count != 6) {
+    subst_log("Function requires 6 parameters.");
+  }
+
+  SubstParticleSystem *system =
+      ((SubstParticleSystem *)AS_POINTER(args[0])->ptr);
+  SubstParticleForceType type = AS_BOOL(args[1]) ? SUBST_PARTICLE_FORCE_VORTEX
+                                                 : SUBST_PARTICLE_FORCE_RADIAL;
+  float radius = IS_NUMBER(args[5]) ? AS_NUMBER(args[5]) : 0;
+
+  return particle_system_force_add(system, type, AS_NUMBER(args[2]),
+                                   AS_NUMBER(args[3]), AS_NUMBER(args[4]),
+                                   radius);
+}
+
+Value subst_particle_system_force_center_set_msc(VM *vm, int arg_count,
+                                                 Value *args) {
+  if (arg_count != 4) {
+    subst_log("Function requires 4 parameters.");
+  }
+
+  SubstParticleSystem *system =
+      ((SubstParticleSystem *)AS_POINTER(args[0])->ptr);
+  int index = AS_NUMBER(args[1]);
+  if (index < 0 || index >= system->force_count) {
+    return FALSE_VAL;
+  }
+
+  system->forces[index].x = AS_NUMBER(args[2]);
+  system->forces[index].y = AS_NUMBER(args[3]);
+
+  return TRUE_VAL;
+}
+
+Value subst_particle_system_forces_clear_msc(VM *vm, int arg_count,
+                                             Value *args) {
+  if (arg_count != 1) {
+    subst_log("Function requires 1 parameter.");
+  }
+
+  subst_particle_system_forces_clear(
+      (SubstParticleSystem *)AS_POINTER(args[0])->ptr);
+
+  return TRUE_VAL;
+}
+
+Value subst_particle_system_collider_add_msc(VM *vm, int arg_count,
+                                             Value *args) {
+  if (arg_count != 4) {
+    subst_log("Function requires 4 parameters.");
+  }
+
+  SubstParticleSystem *system =
+      ((SubstParticleSystem *)AS_POINTER(args[0])->ptr);
+  SubstParticleCollider collider = {
+      .sphere = *(SubstSphere *)AS_POINTER(args[1])->ptr,
+      .response = AS_BOOL(args[2]) ? SUBST_PARTICLE_COLLISION_KILL
+                                   : SUBST_PARTICLE_COLLISION_BOUNCE,
+      .restitution = IS_NUMBER(args[3]) ? AS_NUMBER(args[3]) : 1.f};
+
+  return NUMBER_VAL(subst_particle_system_collider_add(system, &collider));
+}
+
+Value subst_particle_system_collider_center_set_msc(VM *vm, int arg_count,
+                                                    Value *args) {
+  if (arg_count != 4) {
+    subst_log("Function requires 4 parameters.");
+  }
+
+  SubstParticleSystem *system =
+      ((SubstParticleSystem *)AS_POINTER(args[0])->ptr);
+  int index = AS_NUMBER(args[1]);
+  if (index < 0 || index >= system->collider_count) {
+    return FALSE_VAL;
+  }
+
+  system->colliders[index].sphere.center_x = AS_NUMBER(args[2]);
+  system->colliders[index].sphere.center_y = AS_NUMBER(args[3]);
+
+  return TRUE_VAL;
+}
+
+Value subst_particle_system_lod_set_msc(VM *vm, int arg_count, Value *args) {
+  if (arg_count != 3) {
+    subst_log("Function requires 3 parameters.");
+  }
+
+  SubstParticleSystem *system =
+      ((SubstParticleSystem *)AS_POINTER(args[0])->ptr);
+  subst_particle_system_lod_set(system, AS_BOOL(args[1]),
+                                IS_NUMBER(args[2]) ? AS_NUMBER(args[2]) : 0);
+
+  return TRUE_VAL;
+}
+
+Value subst_particle_system_visible_msc(VM *vm, int arg_count, Value *args) {
+  if (arg_count != 1) {
+    subst_log("Function requires 1 parameter.");
+  }
+
+  SubstParticleSystem *system =
+      ((SubstParticleSystem *)AS_POINTER(args[0])->ptr);
+  return BOOL_VAL(system->is_visible);
+}
+
+Value subst_particle_system_colliders_clear_msc(VM *vm, int arg_count,
+                                                Value *args) {
+  if (arg_count != 1) {
+    subst_log("Function requires 1 parameter.");
+  }
+
+  subst_particle_system_colliders_clear(
+      (SubstParticleSystem *)AS_POINTER(args[0])->ptr);
+
+  return TRUE_VAL;
+}
+
 void subst_particle_module_init(VM *vm) {
   mesche_vm_define_native_funcs(
       vm, "substratic particle",
@@ -252,8 +1167,35 @@ void subst_particle_module_init(VM *vm) {
           {"make-particle-source-internal", subst_particle_make_source_msc,
            false},
           {"particle-system-update", subst_particle_system_update_msc, true},
+          {"particle-systems-update-all",
+           subst_particle_systems_update_all_msc, true},
           {"particle-system-render", subst_particle_system_render_msc, true},
           {"particle-system-origin-set!", subst_particle_system_origin_set_msc,
            true},
+          {"particle-system-seed!", subst_particle_system_seed_msc, true},
+          {"particle-system-live-count", subst_particle_system_live_count_msc,
+           true},
+          {"particle-source-live-count", subst_particle_source_live_count_msc,
+           true},
+          {"particle-system-gravity-add!",
+           subst_particle_system_gravity_add_msc, true},
+          {"particle-system-drag-add!", subst_particle_system_drag_add_msc,
+           true},
+          {"particle-system-field-add-internal",
+           subst_particle_system_field_add_msc, false},
+          {"particle-system-force-center-set!",
+           subst_particle_system_force_center_set_msc, true},
+          {"particle-system-forces-clear!",
+           subst_particle_system_forces_clear_msc, true},
+          {"particle-system-collider-add-internal",
+           subst_particle_system_collider_add_msc, false},
+          {"particle-system-collider-center-set!",
+           subst_particle_system_collider_center_set_msc, true},
+          {"particle-system-colliders-clear!",
+           subst_particle_system_colliders_clear_msc, true},
+          {"particle-system-lod-set-internal",
+           subst_particle_system_lod_set_msc, false},
+          {"particle-system-visible?", subst_particle_system_visible_msc,
+           true},
           {NULL, NULL, false}});
 }
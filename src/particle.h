@@ -1,6 +1,196 @@
 #ifndef __subst_particle_h
 #define __subst_particle_h
 
+#include <inttypes.h>
+#include <mesche.h>
+
+#include "particle_gpu.h"
+#include "physics.h"
+#include "random.h"
+#include "renderer.h"
+
+#define SUBST_PARTICLE_FIELD_COUNT 7
+
+// Systems drawn smaller than their minimum size only step once every this
+// many updates and spawn this many times less often
+#define SUBST_PARTICLE_LOD_REDUCED_STEPS 3
+#define SUBST_PARTICLE_LOD_REDUCED_SPAWN_SCALE 2.f
+
+// Over-lifetime curves are baked into tables of this many samples, the GPU
+// particle shader declares its tables with the same size
+#define SUBST_PARTICLE_CURVE_SAMPLES 32
+
+// Sources start out with room for this many particles
+#define SUBST_PARTICLE_INITIAL_CAPACITY 64
+
+typedef struct {
+  float min;
+  float max;
+} SubstParticleFactor;
+
+// Goes from start to end over a particle's lifetime, shaped by one of the
+// cglm easing functions or, when ease is NULL, by a bezier curve with the
+// two control values
+typedef struct {
+  float start;
+  float end;
+  float (*ease)(float t);
+  float control[2];
+} SubstParticleCurve;
+
+typedef struct {
+  int max_particles;
+  float geometry;
+  SubstParticleFactor size;
+  SubstParticleFactor interval;
+  SubstParticleFactor lifetime;
+  SubstParticleFactor vel_x;
+  SubstParticleFactor vel_y;
+  SubstColor color;
+
+  // The color blends toward end_color along color_curve while size and alpha
+  // are scaled by their own curves
+  SubstColor end_color;
+  SubstParticleCurve color_curve;
+  SubstParticleCurve size_curve;
+  SubstParticleCurve alpha_curve;
+
+  // Simulate the particles in GL buffers instead of on the CPU
+  bool is_gpu;
+} SubstParticleSourceConfig;
+
+typedef struct {
+  SubstParticleSourceConfig config;
+
+  // Source State
+  float next_particle_time;
+
+  // The config's curves sampled from birth to death
+  SubstColor color_table[SUBST_PARTICLE_CURVE_SAMPLES];
+  float size_table[SUBST_PARTICLE_CURVE_SAMPLES];
+  float max_size;
+
+  // Box around the live particles as of the last update
+  vec3 bounds[2];
+
+  // Live particles are kept packed at the front of the arrays, a particle
+  // that dies is replaced by the last one.  The arrays grow as needed up to
+  // max_particles.
+  int num_particles;
+  int capacity;
+
+  // Each particle field lives in its own aligned array so that the update
+  // loop can work on several particles at once
+  union {
+    struct {
+      float *pos_x, *pos_y;
+      float *vel_x, *vel_y;
+      float *size;
+      float *time_left;
+      float *inv_lifetime;
+    };
+    float *fields[SUBST_PARTICLE_FIELD_COUNT];
+  };
+
+  // GPU sources have no particle arrays, their updates are held until the
+  // next render since only the render thread can issue GL calls
+  SubstParticleGpu *gpu;
+  float gpu_pending_time;
+} SubstParticleSource;
+
+typedef enum {
+  // Constant acceleration of (x, y)
+  SUBST_PARTICLE_FORCE_GRAVITY,
+  // Removes strength of the velocity per second
+  SUBST_PARTICLE_FORCE_DRAG,
+  // Accelerates toward (x, y), or away from it with a negative strength
+  SUBST_PARTICLE_FORCE_RADIAL,
+  // Accelerates around (x, y), counterclockwise with a positive strength
+  SUBST_PARTICLE_FORCE_VORTEX,
+} SubstParticleForceType;
+
+typedef struct {
+  SubstParticleForceType type;
+  float x, y;
+  float strength;
+
+  // Radial and vortex fields fade out linearly toward this distance, or
+  // reach everywhere at full strength when it is zero
+  float radius;
+} SubstParticleForce;
+
+typedef enum {
+  SUBST_PARTICLE_COLLISION_BOUNCE,
+  SUBST_PARTICLE_COLLISION_KILL,
+} SubstParticleCollisionResponse;
+
+// The sphere is copied into the system so that it can't be freed while
+// particles are being updated, it's moved by setting its center by index
+typedef struct {
+  SubstSphere sphere;
+  SubstParticleCollisionResponse response;
+  float restitution;
+} SubstParticleCollider;
+
+typedef enum {
+  SUBST_PARTICLE_LOD_FULL,
+  SUBST_PARTICLE_LOD_REDUCED,
+  SUBST_PARTICLE_LOD_ASLEEP,
+} SubstParticleLodLevel;
+
+typedef struct {
+  float current_time;
+  float origin_x, origin_y;
+  int source_count;
+  SubstParticleSource *sources;
+
+  int force_count;
+  SubstParticleForce *forces;
+  int collider_count;
+  SubstParticleCollider *colliders;
+
+  // Union of the source bounds, kept up to date by every step
+  vec3 bounds[2];
+
+  // The level of detail is picked at render time from whether the system
+  // can be seen and how large it is on screen.  Time skipped by reduced and
+  // sleeping systems is caught up in one step when they are next simulated.
+  bool sleep_offscreen;
+  float lod_min_size;
+  bool is_visible;
+  SubstParticleLodLevel lod_level;
+  float skipped_time;
+  int skipped_updates;
+
+  // Each system draws from its own generator so that effects can be replayed
+  // and systems never contend over shared random state
+  SubstRandom random;
+} SubstParticleSystem;
+
+SubstParticleSystem *
+subst_particle_system_create(const SubstParticleSourceConfig *configs,
+                             int config_count);
+void subst_particle_system_free(SubstParticleSystem *system);
+void subst_particle_system_seed(SubstParticleSystem *system, uint64_t seed);
+
+void subst_particle_system_update(SubstParticleSystem *system,
+                                  float time_delta);
+void subst_particle_systems_update_all(SubstParticleSystem **systems,
+                                       int system_count, float time_delta);
+void subst_particle_system_render(SubstParticleSystem *system,
+                                  SubstRenderer *renderer);
+int subst_particle_system_live_count(SubstParticleSystem *system);
+
+int subst_particle_system_force_add(SubstParticleSystem *system,
+                                    const SubstParticleForce *force);
+// Returns the index of the new collider for moving it later
+int subst_particle_system_collider_add(SubstParticleSystem *system,
+                                       const SubstParticleCollider *collider);
+void subst_particle_system_forces_clear(SubstParticleSystem *system);
+void subst_particle_system_colliders_clear(SubstParticleSystem *system);
+void subst_particle_system_lod_set(SubstParticleSystem *system,
+                                   bool sleep_offscreen, float min_size);
+
 void subst_particle_module_init(VM *vm);
 
 #endif
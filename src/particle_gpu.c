@@ -0,0 +1,232 @@
+#include <glad/glad.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+#include "log.h"
+#include "particle.h"
+#include "particle_gpu.h"
+#include "render_state.h"
+#include "renderer.h"
+#include "shader.h"
+
+// Two vec4s per particle: position and velocity, then size, time left and
+// lifetime
+#define PARTICLE_GPU_STATE_SIZE (8 * sizeof(float))
+
+static struct {
+  SubstShader *update_shader;
+  SubstParticleGpuUniforms uniforms;
+  SubstShader *render_shader;
+  GLint color_table_location;
+  GLint size_table_location;
+  GLuint quad_buffer;
+  GLuint element_buffer;
+} particle_gpu;
+
+static void particle_gpu_programs_init(void) {
+  const SubstShaderFile update_files[] = {
+      {GL_VERTEX_SHADER, GpuParticleUpdateVertexShaderText},
+      {GL_FRAGMENT_SHADER, GpuParticleUpdateFragmentShaderText},
+  };
+  const char *varyings[] = {"out_state0", "out_state1"};
+  particle_gpu.update_shader =
+      subst_shader_compile_feedback(update_files, 2, varyings, 2);
+
+  GLuint program = particle_gpu.update_shader->program;
+  SubstParticleGpuUniforms *uniforms = &particle_gpu.uniforms;
+  uniforms->time_delta = glGetUniformLocation(program, "time_delta");
+  uniforms->slot_count = glGetUniformLocation(program, "slot_count");
+  uniforms->emit_offset = glGetUniformLocation(program, "emit_offset");
+  uniforms->emit_count = glGetUniformLocation(program, "emit_count");
+  uniforms->spawn_index = glGetUniformLocation(program, "spawn_index");
+  uniforms->seed = glGetUniformLocation(program, "seed");
+  uniforms->first_age = glGetUniformLocation(program, "first_age");
+  uniforms->spawn_interval = glGetUniformLocation(program, "spawn_interval");
+  uniforms->origin = glGetUniformLocation(program, "origin");
+  uniforms->geometry = glGetUniformLocation(program, "geometry");
+  uniforms->size_range = glGetUniformLocation(program, "size_range");
+  uniforms->lifetime_range = glGetUniformLocation(program, "lifetime_range");
+  uniforms->vel_x_range = glGetUniformLocation(program, "vel_x_range");
+  uniforms->vel_y_range = glGetUniformLocation(program, "vel_y_range");
+
+  const SubstShaderFile render_files[] = {
+      {GL_VERTEX_SHADER, GpuParticleVertexShaderText},
+      {GL_FRAGMENT_SHADER, InstancedRectFragmentShaderText},
+  };
+  particle_gpu.render_shader = subst_shader_compile(render_files, 2);
+  particle_gpu.color_table_location =
+      glGetUniformLocation(particle_gpu.render_shader->program, "color_table");
+  particle_gpu.size_table_location =
+      glGetUniformLocation(particle_gpu.render_shader->program, "size_table");
+
+  // Every particle is drawn as the same unit quad scaled by its size
+  float vertices[] = {
+      1.f, 1.f, // bottom right
+      1.f, 0.f, // top right
+      0.f, 0.f, // top left
+      0.f, 1.f, // bottom left
+  };
+
+  unsigned int indices[] = {
+      0, 1, 2, // first triangle
+      2, 3, 0  // second triangle
+  };
+
+  // The element buffer binding is part of whichever vertex array is bound,
+  // which is still the last batch's at this point, so unbind it to avoid
+  // replacing the batch's indices with these
+  subst_render_state_vertex_array_bind(0);
+
+  glGenBuffers(1, &particle_gpu.quad_buffer);
+  glBindBuffer(GL_ARRAY_BUFFER, particle_gpu.quad_buffer);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+
+  glGenBuffers(1, &particle_gpu.element_buffer);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, particle_gpu.element_buffer);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices,
+               GL_STATIC_DRAW);
+}
+
+static void particle_gpu_state_attribs(GLuint first_location, GLuint divisor) {
+  for (GLuint i = 0; i < 2; i++) {
+    glEnableVertexAttribArray(first_location + i);
+    glVertexAttribPointer(first_location + i, 4, GL_FLOAT, GL_FALSE,
+                          PARTICLE_GPU_STATE_SIZE,
+                          (const void *)(i * 4 * sizeof(float)));
+    glVertexAttribDivisor(first_location + i, divisor);
+  }
+}
+
+SubstParticleGpu *subst_particle_gpu_create(int slot_count) {
+  if (particle_gpu.update_shader == NULL) {
+    particle_gpu_programs_init();
+  }
+
+  SubstParticleGpu *gpu = malloc(sizeof(SubstParticleGpu));
+  gpu->slot_count = slot_count;
+  gpu->current_buffer = 0;
+  gpu->spawn_index = 0;
+  gpu->slots_used = 0;
+
+  // Zeroed state means every slot starts out dead
+  float *initial_state = calloc(slot_count, PARTICLE_GPU_STATE_SIZE);
+
+  glGenBuffers(2, gpu->state_buffers);
+  glGenVertexArrays(2, gpu->update_arrays);
+  glGenVertexArrays(2, gpu->render_arrays);
+
+  for (int i = 0; i < 2; i++) {
+    glBindBuffer(GL_ARRAY_BUFFER, gpu->state_buffers[i]);
+    glBufferData(GL_ARRAY_BUFFER, slot_count * PARTICLE_GPU_STATE_SIZE,
+                 initial_state, GL_DYNAMIC_COPY);
+
+    // The update reads one state per vertex
+    subst_render_state_vertex_array_bind(gpu->update_arrays[i]);
+    particle_gpu_state_attribs(0, 0);
+
+    // Rendering reads one state per quad instance
+    subst_render_state_vertex_array_bind(gpu->render_arrays[i]);
+    particle_gpu_state_attribs(1, 1);
+    glBindBuffer(GL_ARRAY_BUFFER, particle_gpu.quad_buffer);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, particle_gpu.element_buffer);
+  }
+
+  subst_render_state_vertex_array_bind(0);
+  free(initial_state);
+
+  return gpu;
+}
+
+void subst_particle_gpu_free(SubstParticleGpu *gpu) {
+  subst_render_state_vertex_array_bind(0);
+  glDeleteVertexArrays(2, gpu->update_arrays);
+  glDeleteVertexArrays(2, gpu->render_arrays);
+  glDeleteBuffers(2, gpu->state_buffers);
+  free(gpu);
+}
+
+void subst_particle_gpu_update(SubstParticleGpu *gpu,
+                               const SubstParticleGpuStep *step) {
+  SubstParticleGpuUniforms *uniforms = &particle_gpu.uniforms;
+  int emit_count = step->emit_count;
+  float first_age = step->first_age;
+
+  // Only the newest particles survive when more are due than there are
+  // slots for
+  if (emit_count > gpu->slot_count) {
+    int skipped = emit_count - gpu->slot_count;
+    gpu->spawn_index += skipped;
+    first_age -= skipped * step->spawn_interval;
+    emit_count = gpu->slot_count;
+  }
+
+  subst_render_state_program_use(particle_gpu.update_shader->program);
+  glUniform1f(uniforms->time_delta, step->time_delta);
+  glUniform1i(uniforms->slot_count, gpu->slot_count);
+  glUniform1i(uniforms->emit_offset, gpu->spawn_index % gpu->slot_count);
+  glUniform1i(uniforms->emit_count, emit_count);
+  glUniform1ui(uniforms->spawn_index, gpu->spawn_index);
+  glUniform1ui(uniforms->seed, step->seed);
+  glUniform1f(uniforms->first_age, first_age);
+  glUniform1f(uniforms->spawn_interval, step->spawn_interval);
+  glUniform2f(uniforms->origin, step->origin_x, step->origin_y);
+  glUniform1f(uniforms->geometry, step->geometry);
+  glUniform2fv(uniforms->size_range, 1, step->size_range);
+  glUniform2fv(uniforms->lifetime_range, 1, step->lifetime_range);
+  glUniform2fv(uniforms->vel_x_range, 1, step->vel_x_range);
+  glUniform2fv(uniforms->vel_y_range, 1, step->vel_y_range);
+
+  // Read the current state and capture the next one into the other buffer
+  int next_buffer = 1 - gpu->current_buffer;
+  subst_render_state_vertex_array_bind(gpu->update_arrays[gpu->current_buffer]);
+  glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0,
+                   gpu->state_buffers[next_buffer]);
+
+  glEnable(GL_RASTERIZER_DISCARD);
+  glBeginTransformFeedback(GL_POINTS);
+  glDrawArrays(GL_POINTS, 0, gpu->slot_count);
+  glEndTransformFeedback();
+  glDisable(GL_RASTERIZER_DISCARD);
+
+  glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+  gpu->current_buffer = next_buffer;
+
+  gpu->spawn_index += emit_count;
+  gpu->slots_used += emit_count;
+  if (gpu->slots_used > gpu->slot_count) {
+    gpu->slots_used = gpu->slot_count;
+  }
+}
+
+void subst_particle_gpu_render(SubstParticleGpu *gpu, SubstRenderer *renderer,
+                               const SubstColor *color_table,
+                               const float *size_table) {
+  SubstShader *shader = particle_gpu.render_shader;
+
+  if (gpu->slots_used == 0) {
+    return;
+  }
+
+  // Particles must land on top of anything drawn before them
+  subst_renderer_flush(renderer);
+
+  subst_render_state_program_use(shader->program);
+  subst_render_state_vertex_array_bind(gpu->render_arrays[gpu->current_buffer]);
+  subst_shader_matrices_apply(shader, renderer->batch->projection_matrix,
+                              renderer->batch->view_matrix,
+                              renderer->batch->matrix_version);
+  glUniform4fv(particle_gpu.color_table_location,
+               SUBST_PARTICLE_CURVE_SAMPLES, (const float *)color_table);
+  glUniform1fv(particle_gpu.size_table_location, SUBST_PARTICLE_CURVE_SAMPLES,
+               size_table);
+
+  // Dead slots are collapsed by the vertex shader so every used slot can be
+  // drawn in one call
+  glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0,
+                          gpu->slots_used);
+
+  renderer->batch->stats.sprites_submitted += gpu->slots_used;
+  renderer->batch->stats.draws_issued++;
+}
@@ -0,0 +1,73 @@
+#ifndef __subst_particle_gpu_h
+#define __subst_particle_gpu_h
+
+#include <glad/glad.h>
+#include <inttypes.h>
+
+#include "renderer.h"
+#include "shader.h"
+
+// Uniforms of the transform feedback update program
+typedef struct {
+  GLint time_delta;
+  GLint slot_count;
+  GLint emit_offset;
+  GLint emit_count;
+  GLint spawn_index;
+  GLint seed;
+  GLint first_age;
+  GLint spawn_interval;
+  GLint origin;
+  GLint geometry;
+  GLint size_range;
+  GLint lifetime_range;
+  GLint vel_x_range;
+  GLint vel_y_range;
+} SubstParticleGpuUniforms;
+
+// Particle state that lives entirely in GL buffers.  Each update reads one
+// buffer and captures the new state into the other, and the particles are
+// drawn straight out of whichever buffer holds the latest state.
+typedef struct {
+  int slot_count;
+  int current_buffer;
+  GLuint state_buffers[2];
+  GLuint update_arrays[2];
+  GLuint render_arrays[2];
+
+  // Every emitted particle gets the next spawn index and the slot at that
+  // index modulo slot_count, replacing the oldest particle once all slots
+  // have been used
+  uint32_t spawn_index;
+  int slots_used;
+} SubstParticleGpu;
+
+// The emitter settings for one GPU update
+typedef struct {
+  float time_delta;
+
+  // How many particles came due during time_delta, how long ago the first
+  // one did and the time between each of them
+  int emit_count;
+  float first_age;
+  float spawn_interval;
+
+  uint32_t seed;
+  float origin_x, origin_y;
+  float geometry;
+  float size_range[2];
+  float lifetime_range[2];
+  float vel_x_range[2];
+  float vel_y_range[2];
+} SubstParticleGpuStep;
+
+SubstParticleGpu *subst_particle_gpu_create(int slot_count);
+void subst_particle_gpu_free(SubstParticleGpu *gpu);
+
+void subst_particle_gpu_update(SubstParticleGpu *gpu,
+                               const SubstParticleGpuStep *step);
+void subst_particle_gpu_render(SubstParticleGpu *gpu, SubstRenderer *renderer,
+                               const SubstColor *color_table,
+                               const float *size_table);
+
+#endif
@@ -1,5 +1,6 @@
 #include <cglm/cglm.h>
 
+#include "log.h"
 #include "physics.h"
 
 Value physics_make_sphere_msc(VM *vm, int arg_count, Value *args) {
@@ -30,6 +31,64 @@ Value physics_sphere_center_y_set_msc(VM *vm, int arg_count, Value *args) {
   return args[1];
 }
 
+void subst_box_init(SubstBox *box, float x, float y, float width,
+                    float height) {
+  box->bounds[0][0] = x;
+  box->bounds[0][1] = y;
+  box->bounds[0][2] = 0.f;
+  box->bounds[1][0] = x + width;
+  box->bounds[1][1] = y + height;
+  box->bounds[1][2] = 0.f;
+}
+
+bool subst_box_circle_intersect(SubstBox *box, float x, float y,
+                                float radius) {
+  // The bundled glm_aabb_sphere measures from the wrong corner when the
+  // center is below the box's minimum, so clamp to the nearest point instead
+  float dx = x - glm_clamp(x, box->bounds[0][0], box->bounds[1][0]);
+  float dy = y - glm_clamp(y, box->bounds[0][1], box->bounds[1][1]);
+  return dx * dx + dy * dy <= radius * radius;
+}
+
+Value physics_make_box_msc(VM *vm, int arg_count, Value *args) {
+  if (arg_count != 4) {
+    subst_log("Function requires 4 parameters.");
+  }
+
+  SubstBox *box = malloc(sizeof(SubstBox));
+  subst_box_init(box, AS_NUMBER(args[0]), AS_NUMBER(args[1]),
+                 AS_NUMBER(args[2]), AS_NUMBER(args[3]));
+
+  return OBJECT_VAL(mesche_object_make_pointer(vm, box, true));
+}
+
+Value physics_box_intersect_msc(VM *vm, int arg_count, Value *args) {
+  SubstBox *box1 = (SubstBox *)AS_POINTER(args[0])->ptr;
+  SubstBox *box2 = (SubstBox *)AS_POINTER(args[1])->ptr;
+  return BOOL_VAL(glm_aabb_aabb(box1->bounds, box2->bounds));
+}
+
+Value physics_box_sphere_intersect_msc(VM *vm, int arg_count, Value *args) {
+  SubstBox *box = (SubstBox *)AS_POINTER(args[0])->ptr;
+  SubstSphere *sphere = (SubstSphere *)AS_POINTER(args[1])->ptr;
+  return BOOL_VAL(subst_box_circle_intersect(
+      box, sphere->center_x, sphere->center_y, sphere->radius));
+}
+
+Value physics_box_position_set_msc(VM *vm, int arg_count, Value *args) {
+  if (arg_count != 3) {
+    subst_log("Function requires 3 parameters.");
+  }
+
+  // Moves the min corner and keeps the size
+  SubstBox *box = (SubstBox *)AS_POINTER(args[0])->ptr;
+  float x = AS_NUMBER(args[1]), y = AS_NUMBER(args[2]);
+  subst_box_init(box, x, y, box->bounds[1][0] - box->bounds[0][0],
+                 box->bounds[1][1] - box->bounds[0][1]);
+
+  return TRUE_VAL;
+}
+
 void subst_physics_module_init(VM *vm) {
   mesche_vm_define_native_funcs(
       vm, "substratic physics",
@@ -38,5 +97,9 @@ void subst_physics_module_init(VM *vm) {
           {"sphere-intersect?", physics_sphere_intersect_msc, true},
           {"sphere-center-x-set!", physics_sphere_center_x_set_msc, true},
           {"sphere-center-y-set!", physics_sphere_center_y_set_msc, true},
+          {"make-box", physics_make_box_msc, true},
+          {"box-intersect?", physics_box_intersect_msc, true},
+          {"box-sphere-intersect?", physics_box_sphere_intersect_msc, true},
+          {"box-position-set!", physics_box_position_set_msc, true},
           {NULL, NULL, false}});
 }
@@ -1,6 +1,7 @@
 #ifndef __subst_physics_h
 #define __subst_physics_h
 
+#include <cglm/cglm.h>
 #include <mesche.h>
 
 typedef struct {
@@ -10,6 +11,22 @@ typedef struct {
   float radius;
 } SubstSphere;
 
+// Min and max corners in the layout cglm's box.h functions expect, z is
+// always 0
+typedef struct {
+  vec3 bounds[2];
+} SubstBox;
+
+typedef enum {
+  SUBST_COLLISION_SHAPE_SPHERE,
+  SUBST_COLLISION_SHAPE_BOX,
+} SubstCollisionShape;
+
+void subst_box_init(SubstBox *box, float x, float y, float width,
+                    float height);
+bool subst_box_circle_intersect(SubstBox *box, float x, float y,
+                                float radius);
+
 void subst_physics_module_init(VM *vm);
 
 #endif
@@ -0,0 +1,444 @@
+#include <glad/glad.h>
+#include <mesche.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "log.h"
+#include "profiler.h"
+
+typedef struct {
+  uint16_t zone;
+  uint8_t depth;
+  uint64_t start_ns;
+} SubstProfilerOpenZone;
+
+typedef struct {
+  GLuint query;
+  uint16_t zone;
+  uint32_t frame;
+  uint64_t start_ns;
+} SubstProfilerQuery;
+
+static struct {
+  bool is_enabled;
+  uint64_t base_ns;
+  uint32_t frame;
+  uint64_t frame_start_ns;
+  uint64_t last_frame_ns;
+
+  uint32_t zone_count;
+  SubstProfilerZone zones[SUBST_PROFILER_ZONE_MAX];
+
+  SubstProfilerOpenZone stack[SUBST_PROFILER_STACK_DEPTH];
+  uint32_t stack_depth;
+
+  SubstProfilerEvent *events;
+  uint32_t event_next;
+  uint32_t event_count;
+
+  // GPU zones can't overlap so a nested zone pauses the one around it
+  uint16_t gpu_stack[SUBST_PROFILER_STACK_DEPTH];
+  uint32_t gpu_depth;
+  SubstProfilerQuery queries[SUBST_PROFILER_GPU_QUERY_COUNT];
+  uint32_t query_next;
+  uint32_t query_oldest;
+  uint32_t query_count;
+} profiler;
+
+static uint64_t profiler_time_ns(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+// Literal names are matched by pointer first.  Script strings never are
+// since they can be collected and their address reused for another name.
+static uint16_t profiler_zone_find(const char *name, bool is_literal,
+                                   bool create) {
+  if (is_literal) {
+    for (uint32_t i = 0; i < profiler.zone_count; i++) {
+      if (profiler.zones[i].literal_name == name) {
+        return i;
+      }
+    }
+  }
+
+  for (uint32_t i = 0; i < profiler.zone_count; i++) {
+    SubstProfilerZone *zone = &profiler.zones[i];
+    if (strcmp(zone->name, name) == 0) {
+      if (is_literal && zone->literal_name == NULL) {
+        zone->literal_name = name;
+      }
+      return i;
+    }
+  }
+
+  if (!create || profiler.zone_count == SUBST_PROFILER_ZONE_MAX) {
+    return UINT16_MAX;
+  }
+
+  // Keep our own copy since script strings can be collected
+  SubstProfilerZone *zone = &profiler.zones[profiler.zone_count];
+  memset(zone, 0, sizeof(SubstProfilerZone));
+  zone->name = strdup(name);
+  zone->literal_name = is_literal ? name : NULL;
+
+  return profiler.zone_count++;
+}
+
+static void profiler_event_add(uint16_t zone, uint8_t depth, uint32_t frame,
+                               uint64_t start_ns, uint64_t duration_ns,
+                               bool is_gpu) {
+  SubstProfilerEvent *event = &profiler.events[profiler.event_next];
+  event->start_ns = start_ns - profiler.base_ns;
+  event->duration_ns = duration_ns;
+  event->frame = frame;
+  event->zone = zone;
+  event->depth = depth;
+  event->is_gpu = is_gpu;
+
+  profiler.event_next =
+      (profiler.event_next + 1) % SUBST_PROFILER_EVENT_CAPACITY;
+  if (profiler.event_count < SUBST_PROFILER_EVENT_CAPACITY) {
+    profiler.event_count++;
+  }
+
+  if (is_gpu) {
+    profiler.zones[zone].gpu_ns += duration_ns;
+  } else {
+    profiler.zones[zone].cpu_ns += duration_ns;
+  }
+}
+
+#ifndef __EMSCRIPTEN__
+
+static void profiler_query_resolve(void) {
+  SubstProfilerQuery *query = &profiler.queries[profiler.query_oldest];
+  GLuint64 elapsed_ns = 0;
+
+  glGetQueryObjectui64v(query->query, GL_QUERY_RESULT, &elapsed_ns);
+  profiler_event_add(query->zone, 0, query->frame, query->start_ns,
+                     elapsed_ns, true);
+
+  profiler.query_oldest =
+      (profiler.query_oldest + 1) % SUBST_PROFILER_GPU_QUERY_COUNT;
+  profiler.query_count--;
+}
+
+static void profiler_query_start(uint16_t zone) {
+  // Every query is in flight so wait for the oldest one
+  if (profiler.query_count == SUBST_PROFILER_GPU_QUERY_COUNT) {
+    profiler_query_resolve();
+  }
+
+  SubstProfilerQuery *query = &profiler.queries[profiler.query_next];
+  if (query->query == 0) {
+    glGenQueries(1, &query->query);
+  }
+
+  // GPU work is placed on the CPU timeline where it was submitted
+  query->zone = zone;
+  query->frame = profiler.frame;
+  query->start_ns = profiler_time_ns();
+  glBeginQuery(GL_TIME_ELAPSED, query->query);
+
+  profiler.query_next =
+      (profiler.query_next + 1) % SUBST_PROFILER_GPU_QUERY_COUNT;
+  profiler.query_count++;
+}
+
+static void profiler_queries_collect(void) {
+  // Results come back in order so stop at the first one that isn't ready,
+  // skipping the newest query if it's still running
+  while (profiler.query_count > (profiler.gpu_depth > 0 ? 1 : 0)) {
+    SubstProfilerQuery *query = &profiler.queries[profiler.query_oldest];
+    GLint is_available = 0;
+    glGetQueryObjectiv(query->query, GL_QUERY_RESULT_AVAILABLE,
+                       &is_available);
+    if (!is_available) {
+      break;
+    }
+
+    profiler_query_resolve();
+  }
+}
+
+#endif
+
+void subst_profiler_enable(bool is_enabled) {
+  if (is_enabled == profiler.is_enabled) {
+    return;
+  }
+
+  if (is_enabled) {
+    if (profiler.events == NULL) {
+      profiler.events =
+          malloc(sizeof(SubstProfilerEvent) * SUBST_PROFILER_EVENT_CAPACITY);
+      profiler.base_ns = profiler_time_ns();
+    }
+
+    profiler.frame_start_ns = profiler_time_ns();
+  } else {
+    // Drop zones that are still open, they'll never be closed
+    profiler.stack_depth = 0;
+    if (profiler.gpu_depth > 0) {
+#ifndef __EMSCRIPTEN__
+      glEndQuery(GL_TIME_ELAPSED);
+#endif
+      profiler.gpu_depth = 0;
+    }
+  }
+
+  profiler.is_enabled = is_enabled;
+}
+
+bool subst_profiler_is_enabled(void) { return profiler.is_enabled; }
+
+static void profiler_zone_begin(const char *name, bool is_literal) {
+  if (!profiler.is_enabled ||
+      profiler.stack_depth == SUBST_PROFILER_STACK_DEPTH) {
+    return;
+  }
+
+  SubstProfilerOpenZone *open_zone = &profiler.stack[profiler.stack_depth];
+  open_zone->zone = profiler_zone_find(name, is_literal, true);
+  open_zone->depth = profiler.stack_depth;
+  profiler.stack_depth++;
+
+  // Take the time last so that the bookkeeping isn't counted
+  open_zone->start_ns = profiler_time_ns();
+}
+
+void subst_profiler_zone_begin(const char *name) {
+  profiler_zone_begin(name, true);
+}
+
+void subst_profiler_zone_end(void) {
+  uint64_t end_ns = profiler_time_ns();
+
+  if (!profiler.is_enabled || profiler.stack_depth == 0) {
+    return;
+  }
+
+  profiler.stack_depth--;
+  SubstProfilerOpenZone *open_zone = &profiler.stack[profiler.stack_depth];
+  if (open_zone->zone != UINT16_MAX) {
+    profiler_event_add(open_zone->zone, open_zone->depth, profiler.frame,
+                       open_zone->start_ns, end_ns - open_zone->start_ns,
+                       false);
+  }
+}
+
+static void profiler_gpu_begin(const char *name, bool is_literal) {
+  if (!profiler.is_enabled ||
+      profiler.gpu_depth == SUBST_PROFILER_STACK_DEPTH) {
+    return;
+  }
+
+  uint16_t zone = profiler_zone_find(name, is_literal, true);
+  if (zone == UINT16_MAX) {
+    return;
+  }
+
+#ifndef __EMSCRIPTEN__
+  // Pause the enclosing zone, it picks up again when this one ends
+  if (profiler.gpu_depth > 0) {
+    glEndQuery(GL_TIME_ELAPSED);
+  }
+
+  profiler_query_start(zone);
+#endif
+
+  profiler.gpu_stack[profiler.gpu_depth] = zone;
+  profiler.gpu_depth++;
+}
+
+void subst_profiler_gpu_begin(const char *name) {
+  profiler_gpu_begin(name, true);
+}
+
+void subst_profiler_gpu_end(void) {
+  if (!profiler.is_enabled || profiler.gpu_depth == 0) {
+    return;
+  }
+
+  profiler.gpu_depth--;
+
+#ifndef __EMSCRIPTEN__
+  glEndQuery(GL_TIME_ELAPSED);
+  if (profiler.gpu_depth > 0) {
+    profiler_query_start(profiler.gpu_stack[profiler.gpu_depth - 1]);
+  }
+#endif
+}
+
+void subst_profiler_frame_end(void) {
+  if (!profiler.is_enabled) {
+    return;
+  }
+
+#ifndef __EMSCRIPTEN__
+  // GPU times land in whichever frame they arrive in
+  profiler_queries_collect();
+#endif
+
+  uint64_t now_ns = profiler_time_ns();
+  profiler.last_frame_ns = now_ns - profiler.frame_start_ns;
+  profiler.frame_start_ns = now_ns;
+  profiler.frame++;
+
+  for (uint32_t i = 0; i < profiler.zone_count; i++) {
+    SubstProfilerZone *zone = &profiler.zones[i];
+    zone->last_cpu_ns = zone->cpu_ns;
+    zone->last_gpu_ns = zone->gpu_ns;
+    zone->cpu_ns = 0;
+    zone->gpu_ns = 0;
+  }
+}
+
+double subst_profiler_zone_time(const char *name) {
+  uint16_t zone = profiler_zone_find(name, false, false);
+  return zone == UINT16_MAX ? 0.0 : profiler.zones[zone].last_cpu_ns / 1e6;
+}
+
+double subst_profiler_zone_gpu_time(const char *name) {
+  uint16_t zone = profiler_zone_find(name, false, false);
+  return zone == UINT16_MAX ? 0.0 : profiler.zones[zone].last_gpu_ns / 1e6;
+}
+
+double subst_profiler_frame_time(void) { return profiler.last_frame_ns / 1e6; }
+
+// Zone names can come from scripts so anything that would end the JSON
+// string early is escaped
+static void profiler_json_string_write(FILE *file, const char *string) {
+  fputc('"', file);
+  for (const unsigned char *c = (const unsigned char *)string; *c; c++) {
+    if (*c == '"' || *c == '\\') {
+      fputc('\\', file);
+      fputc(*c, file);
+    } else if (*c < 0x20) {
+      fprintf(file, "\\u%04x", *c);
+    } else {
+      fputc(*c, file);
+    }
+  }
+  fputc('"', file);
+}
+
+bool subst_profiler_trace_save(const char *file_path) {
+  FILE *file = fopen(file_path, "w");
+  if (file == NULL) {
+    subst_log("Could not open trace file for writing: %s\n", file_path);
+    return false;
+  }
+
+  // Write the Chrome trace event format with CPU and GPU on separate rows
+  fprintf(file, "{\"traceEvents\":[\n");
+  fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":0,"
+                "\"args\":{\"name\":\"CPU\"}},\n");
+  fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":1,"
+                "\"args\":{\"name\":\"GPU\"}}");
+
+  uint32_t first = (profiler.event_next + SUBST_PROFILER_EVENT_CAPACITY -
+                    profiler.event_count) %
+                   SUBST_PROFILER_EVENT_CAPACITY;
+  for (uint32_t i = 0; i < profiler.event_count; i++) {
+    SubstProfilerEvent *event =
+        &profiler.events[(first + i) % SUBST_PROFILER_EVENT_CAPACITY];
+    fprintf(file, ",\n{\"name\":");
+    profiler_json_string_write(file, profiler.zones[event->zone].name);
+    fprintf(file,
+            ",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+            "\"pid\":0,\"tid\":%d,\"args\":{\"frame\":%u}}",
+            event->is_gpu ? "gpu" : "cpu", event->start_ns / 1e3,
+            event->duration_ns / 1e3, event->is_gpu ? 1 : 0, event->frame);
+  }
+
+  fprintf(file, "\n]}\n");
+  fclose(file);
+
+  return true;
+}
+
+Value subst_profiler_enable_msc(VM *vm, int arg_count, Value *args) {
+  if (arg_count != 1) {
+    subst_log("Function requires 1 parameter.");
+  }
+
+  subst_profiler_enable(!IS_FALSE(args[0]));
+  return UNSPECIFIED_VAL;
+}
+
+Value subst_profiler_zone_begin_msc(VM *vm, int arg_count, Value *args) {
+  if (arg_count != 1) {
+    subst_log("Function requires 1 parameter.");
+  }
+
+  profiler_zone_begin(AS_CSTRING(args[0]), false);
+  return UNSPECIFIED_VAL;
+}
+
+Value subst_profiler_zone_end_msc(VM *vm, int arg_count, Value *args) {
+  subst_profiler_zone_end();
+  return UNSPECIFIED_VAL;
+}
+
+Value subst_profiler_gpu_begin_msc(VM *vm, int arg_count, Value *args) {
+  if (arg_count != 1) {
+    subst_log("Function requires 1 parameter.");
+  }
+
+  profiler_gpu_begin(AS_CSTRING(args[0]), false);
+  return UNSPECIFIED_VAL;
+}
+
+Value subst_profiler_gpu_end_msc(VM *vm, int arg_count, Value *args) {
+  subst_profiler_gpu_end();
+  return UNSPECIFIED_VAL;
+}
+
+Value subst_profiler_zone_time_msc(VM *vm, int arg_count, Value *args) {
+  if (arg_count != 1) {
+    subst_log("Function requires 1 parameter.");
+  }
+
+  return NUMBER_VAL(subst_profiler_zone_time(AS_CSTRING(args[0])));
+}
+
+Value subst_profiler_zone_gpu_time_msc(VM *vm, int arg_count, Value *args) {
+  if (arg_count != 1) {
+    subst_log("Function requires 1 parameter.");
+  }
+
+  return NUMBER_VAL(subst_profiler_zone_gpu_time(AS_CSTRING(args[0])));
+}
+
+Value subst_profiler_frame_time_msc(VM *vm, int arg_count, Value *args) {
+  return NUMBER_VAL(subst_profiler_frame_time());
+}
+
+Value subst_profiler_trace_save_msc(VM *vm, int arg_count, Value *args) {
+  if (arg_count != 1) {
+    subst_log("Function requires 1 parameter.");
+  }
+
+  return BOOL_VAL(subst_profiler_trace_save(AS_CSTRING(args[0])));
+}
+
+void subst_profiler_module_init(VM *vm) {
+  mesche_vm_define_native_funcs(
+      vm, "substratic profiler",
+      (MescheNativeFuncDetails[]){
+          {"profiler-enable!", subst_profiler_enable_msc, true},
+          {"profiler-zone-begin", subst_profiler_zone_begin_msc, true},
+          {"profiler-zone-end", subst_profiler_zone_end_msc, true},
+          {"profiler-gpu-begin", subst_profiler_gpu_begin_msc, true},
+          {"profiler-gpu-end", subst_profiler_gpu_end_msc, true},
+          {"profiler-zone-time", subst_profiler_zone_time_msc, true},
+          {"profiler-zone-gpu-time", subst_profiler_zone_gpu_time_msc, true},
+          {"profiler-frame-time", subst_profiler_frame_time_msc, true},
+          {"profiler-trace-save", subst_profiler_trace_save_msc, true},
+          {NULL, NULL, false}});
+}
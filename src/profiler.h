@@ -0,0 +1,58 @@
+#ifndef __subst_profiler_h
+#define __subst_profiler_h
+
+#include <inttypes.h>
+#include <mesche.h>
+#include <stdbool.h>
+
+// Completed zones are kept in a ring buffer so the newest ones can always be
+// written out as a trace
+#define SUBST_PROFILER_EVENT_CAPACITY 65536
+#define SUBST_PROFILER_ZONE_MAX 64
+#define SUBST_PROFILER_STACK_DEPTH 32
+
+// Timer queries take a few frames to come back so several are kept in
+// flight at once
+#define SUBST_PROFILER_GPU_QUERY_COUNT 64
+
+typedef struct {
+  uint64_t start_ns;
+  uint64_t duration_ns;
+  uint32_t frame;
+  uint16_t zone;
+  uint8_t depth;
+  bool is_gpu;
+} SubstProfilerEvent;
+
+typedef struct {
+  const char *name;
+  // The caller's own pointer for zones begun from C, where names are string
+  // literals, so that they can be found without comparing strings
+  const char *literal_name;
+
+  // Time spent in the zone during the current and the last complete frame
+  uint64_t cpu_ns;
+  uint64_t gpu_ns;
+  uint64_t last_cpu_ns;
+  uint64_t last_gpu_ns;
+} SubstProfilerZone;
+
+void subst_profiler_enable(bool is_enabled);
+bool subst_profiler_is_enabled(void);
+
+// Names passed from C have to live as long as the program, string literals
+// are the usual choice
+void subst_profiler_zone_begin(const char *name);
+void subst_profiler_zone_end(void);
+void subst_profiler_gpu_begin(const char *name);
+void subst_profiler_gpu_end(void);
+void subst_profiler_frame_end(void);
+
+double subst_profiler_zone_time(const char *name);
+double subst_profiler_zone_gpu_time(const char *name);
+double subst_profiler_frame_time(void);
+bool subst_profiler_trace_save(const char *file_path);
+
+void subst_profiler_module_init(VM *vm);
+
+#endif
@@ -0,0 +1,86 @@
+#include <string.h>
+
+#include "random.h"
+
+static inline uint32_t random_rotl(uint32_t x, int k) {
+  return (x << k) | (x >> (32 - k));
+}
+
+static uint64_t random_splitmix64(uint64_t *x) {
+  uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+void subst_random_seed(SubstRandom *random, uint64_t seed) {
+  // Spread the seed over every lane, xoshiro must never be all zeroes
+  for (int lane = 0; lane < SUBST_RANDOM_LANES; lane++) {
+    for (int i = 0; i < 4; i += 2) {
+      uint64_t value = random_splitmix64(&seed);
+      random->state[i][lane] = (uint32_t)value;
+      random->state[i + 1][lane] = (uint32_t)(value >> 32);
+    }
+  }
+}
+
+// Turns the top 24 bits into a float in [0, 1)
+static inline float random_to_float(uint32_t x) {
+  return (x >> 8) * (1.f / 16777216.f);
+}
+
+uint32_t subst_random_next(SubstRandom *random) {
+  uint32_t *s0 = &random->state[0][0], *s1 = &random->state[1][0];
+  uint32_t *s2 = &random->state[2][0], *s3 = &random->state[3][0];
+  uint32_t result = *s0 + *s3;
+  uint32_t t = *s1 << 9;
+
+  *s2 ^= *s0;
+  *s3 ^= *s1;
+  *s1 ^= *s2;
+  *s0 ^= *s3;
+  *s2 ^= t;
+  *s3 = random_rotl(*s3, 11);
+
+  return result;
+}
+
+float subst_random_float(SubstRandom *random) {
+  return random_to_float(subst_random_next(random));
+}
+
+float subst_random_range(SubstRandom *random, float min, float max) {
+  return min + (max - min) * subst_random_float(random);
+}
+
+void subst_random_fill(SubstRandom *random, float *dest, int count, float min,
+                       float max) {
+  uint32_t *s0 = random->state[0], *s1 = random->state[1];
+  uint32_t *s2 = random->state[2], *s3 = random->state[3];
+  float block[SUBST_RANDOM_LANES];
+  float range = max - min;
+
+  for (int i = 0; i < count; i += SUBST_RANDOM_LANES) {
+    // Step every lane at once, this loop has no dependencies between lanes
+    for (int lane = 0; lane < SUBST_RANDOM_LANES; lane++) {
+      uint32_t result = s0[lane] + s3[lane];
+      uint32_t t = s1[lane] << 9;
+
+      s2[lane] ^= s0[lane];
+      s3[lane] ^= s1[lane];
+      s1[lane] ^= s2[lane];
+      s0[lane] ^= s3[lane];
+      s2[lane] ^= t;
+      s3[lane] = random_rotl(s3[lane], 11);
+
+      block[lane] = min + range * random_to_float(result);
+    }
+
+    int length = count - i;
+    if (length > SUBST_RANDOM_LANES) {
+      length = SUBST_RANDOM_LANES;
+    }
+
+    memcpy(&dest[i], block, length * sizeof(float));
+  }
+}
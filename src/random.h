@@ -0,0 +1,22 @@
+#ifndef __subst_random_h
+#define __subst_random_h
+
+#include <inttypes.h>
+
+// Number of independent xoshiro128+ streams stepped side by side by the bulk
+// fill so that the compiler can vectorize it
+#define SUBST_RANDOM_LANES 8
+
+typedef struct {
+  uint32_t state[4][SUBST_RANDOM_LANES];
+} SubstRandom;
+
+void subst_random_seed(SubstRandom *random, uint64_t seed);
+
+uint32_t subst_random_next(SubstRandom *random);
+float subst_random_float(SubstRandom *random);
+float subst_random_range(SubstRandom *random, float min, float max);
+void subst_random_fill(SubstRandom *random, float *dest, int count, float min,
+                       float max);
+
+#endif
@@ -0,0 +1,208 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "raycast.h"
+
+// Directions shorter than this on an axis are treated as parallel to it
+#define CAST_PARALLEL_EPSILON 1e-8f
+
+void subst_cast_init(SubstCast *cast, float x, float y, float direction_x,
+                     float direction_y, float max_distance, float radius) {
+  float length = sqrtf(direction_x * direction_x + direction_y * direction_y);
+
+  cast->origin_x = x;
+  cast->origin_y = y;
+  if (length > 0) {
+    cast->direction_x = direction_x / length;
+    cast->direction_y = direction_y / length;
+    cast->max_distance = max_distance;
+  } else {
+    cast->direction_x = 1.f;
+    cast->direction_y = 0.f;
+    cast->max_distance = 0.f;
+  }
+  cast->radius = radius > 0 ? radius : 0;
+  cast->ignore_id = UINT32_MAX;
+}
+
+void subst_cast_segment_init(SubstCast *cast, float start_x, float start_y,
+                             float end_x, float end_y, float radius) {
+  float delta_x = end_x - start_x, delta_y = end_y - start_y;
+  subst_cast_init(cast, start_x, start_y, delta_x, delta_y,
+                  sqrtf(delta_x * delta_x + delta_y * delta_y), radius);
+}
+
+// Narrows the enter and exit distances down to the span where the cast lies
+// between min and max along one axis, and records the axis when it is the
+// last one to be entered
+static inline bool cast_slab(float origin, float direction, float min,
+                             float max, int axis, float *enter, float *exit,
+                             int *enter_axis) {
+  if (fabsf(direction) < CAST_PARALLEL_EPSILON) {
+    // Parallel casts are either always inside of the slab or never
+    return origin >= min && origin <= max;
+  }
+
+  float inverse = 1.f / direction;
+  float near = (min - origin) * inverse;
+  float far = (max - origin) * inverse;
+  if (near > far) {
+    float swap = near;
+    near = far;
+    far = swap;
+  }
+
+  if (near > *enter) {
+    *enter = near;
+    *enter_axis = axis;
+  }
+  if (far < *exit) {
+    *exit = far;
+  }
+
+  return *enter <= *exit;
+}
+
+static bool cast_box_enter(const SubstCast *cast, float min_x, float min_y,
+                           float max_x, float max_y, float *enter,
+                           float *exit, int *enter_axis) {
+  *enter = -INFINITY;
+  *exit = INFINITY;
+  *enter_axis = -1;
+  if (!cast_slab(cast->origin_x, cast->direction_x, min_x, max_x, 0, enter,
+                 exit, enter_axis) ||
+      !cast_slab(cast->origin_y, cast->direction_y, min_y, max_y, 1, enter,
+                 exit, enter_axis)) {
+    return false;
+  }
+
+  return *exit >= 0 && *enter <= cast->max_distance;
+}
+
+bool subst_cast_bounds(const SubstCast *cast, float min_x, float min_y,
+                       float max_x, float max_y, float *enter, float *exit) {
+  int enter_axis;
+  return cast_box_enter(cast, min_x, min_y, max_x, max_y, enter, exit,
+                        &enter_axis);
+}
+
+static inline void cast_hit_inside(const SubstCast *cast, SubstCastHit *hit) {
+  hit->distance = 0;
+  hit->normal_x = -cast->direction_x;
+  hit->normal_y = -cast->direction_y;
+}
+
+// Tests the line of the cast against a circle that already includes the
+// cast's own radius
+static bool cast_circle(const SubstCast *cast, float x, float y, float radius,
+                        SubstCastHit *hit) {
+  float offset_x = cast->origin_x - x, offset_y = cast->origin_y - y;
+  float along =
+      offset_x * cast->direction_x + offset_y * cast->direction_y;
+  float outside = offset_x * offset_x + offset_y * offset_y - radius * radius;
+  if (outside <= 0) {
+    cast_hit_inside(cast, hit);
+    return true;
+  }
+
+  // Starting outside and heading away can never touch it
+  float discriminant = along * along - outside;
+  if (along >= 0 || discriminant < 0 || radius <= 0) {
+    return false;
+  }
+
+  float distance = -along - sqrtf(discriminant);
+  if (distance > cast->max_distance) {
+    return false;
+  }
+
+  // Normalized by its own length rather than the radius since small circles
+  // hit from far away lose too much precision
+  float normal_x = offset_x + cast->direction_x * distance;
+  float normal_y = offset_y + cast->direction_y * distance;
+  float length = sqrtf(normal_x * normal_x + normal_y * normal_y);
+  if (length <= 0) {
+    cast_hit_inside(cast, hit);
+    return true;
+  }
+
+  hit->distance = distance;
+  hit->normal_x = normal_x / length;
+  hit->normal_y = normal_y / length;
+  return true;
+}
+
+bool subst_cast_sphere(const SubstCast *cast, float x, float y, float radius,
+                       SubstCastHit *hit) {
+  return cast_circle(cast, x, y, radius + cast->radius, hit);
+}
+
+bool subst_cast_box(const SubstCast *cast, float min_x, float min_y,
+                    float max_x, float max_y, SubstCastHit *hit) {
+  // A swept circle hits the box wherever its center reaches the box grown by
+  // the radius with rounded corners
+  float radius = cast->radius, enter, exit;
+  int enter_axis;
+  if (!cast_box_enter(cast, min_x - radius, min_y - radius, max_x + radius,
+                      max_y + radius, &enter, &exit, &enter_axis)) {
+    return false;
+  }
+
+  float distance = enter > 0 ? enter : 0;
+  if (radius > 0) {
+    // Reaching the grown box beside a corner means the cast either hits that
+    // corner's circle or misses the box entirely, it can't get around the
+    // circle to either of the neighbouring faces
+    float x = cast->origin_x + cast->direction_x * distance;
+    float y = cast->origin_y + cast->direction_y * distance;
+    if ((x < min_x || x > max_x) && (y < min_y || y > max_y)) {
+      return cast_circle(cast, x < min_x ? min_x : max_x,
+                         y < min_y ? min_y : max_y, radius, hit);
+    }
+  }
+
+  if (enter <= 0) {
+    cast_hit_inside(cast, hit);
+  } else {
+    hit->distance = enter;
+    hit->normal_x =
+        enter_axis == 0 ? (cast->direction_x > 0 ? -1.f : 1.f) : 0.f;
+    hit->normal_y =
+        enter_axis == 1 ? (cast->direction_y > 0 ? -1.f : 1.f) : 0.f;
+  }
+
+  return true;
+}
+
+void subst_cast_hits_init(SubstCastHits *hits) {
+  memset(hits, 0, sizeof(SubstCastHits));
+}
+
+void subst_cast_hits_free(SubstCastHits *hits) {
+  free(hits->hits);
+  memset(hits, 0, sizeof(SubstCastHits));
+}
+
+void subst_cast_hits_add(SubstCastHits *hits, const SubstCastHit *hit) {
+  if (hits->count == hits->capacity) {
+    hits->capacity = hits->capacity == 0 ? 16 : hits->capacity * 2;
+    hits->hits = realloc(hits->hits, sizeof(SubstCastHit) * hits->capacity);
+  }
+
+  hits->hits[hits->count++] = *hit;
+}
+
+static int cast_hit_compare(const void *a, const void *b) {
+  float distance_a = ((const SubstCastHit *)a)->distance;
+  float distance_b = ((const SubstCastHit *)b)->distance;
+  return (distance_a > distance_b) - (distance_a < distance_b);
+}
+
+void subst_cast_hits_sort(SubstCastHits *hits) {
+  if (hits->count < 2) {
+    return;
+  }
+
+  qsort(hits->hits, hits->count, sizeof(SubstCastHit), cast_hit_compare);
+}
@@ -0,0 +1,57 @@
+#ifndef __subst_raycast_h
+#define __subst_raycast_h
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+// A ray, segment or swept circle travelling from its origin along a unit
+// direction.  Rays that never stop have a max distance of INFINITY and a
+// radius of 0 casts a thin line.  The collider with ignore_id is skipped so
+// that a caster can look out from inside of its own collider.
+typedef struct {
+  float origin_x, origin_y;
+  float direction_x, direction_y;
+  float max_distance;
+  float radius;
+  uint32_t ignore_id;
+} SubstCast;
+
+// How far the cast travelled before touching a collider and the collider's
+// surface normal at that spot.  Casts that start out touching a collider hit
+// it at distance 0 with the normal facing back along the cast.
+typedef struct {
+  uint32_t id;
+  float distance;
+  float normal_x, normal_y;
+} SubstCastHit;
+
+typedef struct {
+  uint32_t count;
+  uint32_t capacity;
+  SubstCastHit *hits;
+} SubstCastHits;
+
+// A zero direction or a segment whose ends meet only tests the origin
+void subst_cast_init(SubstCast *cast, float x, float y, float direction_x,
+                     float direction_y, float max_distance, float radius);
+void subst_cast_segment_init(SubstCast *cast, float start_x, float start_y,
+                             float end_x, float end_y, float radius);
+
+// Finds the distances at which the cast enters and leaves an axis aligned
+// box, returns false when it misses it within its max distance
+bool subst_cast_bounds(const SubstCast *cast, float min_x, float min_y,
+                       float max_x, float max_y, float *enter, float *exit);
+
+// Exact tests against a single collider, hit->id is left to the caller
+bool subst_cast_sphere(const SubstCast *cast, float x, float y, float radius,
+                       SubstCastHit *hit);
+bool subst_cast_box(const SubstCast *cast, float min_x, float min_y,
+                    float max_x, float max_y, SubstCastHit *hit);
+
+void subst_cast_hits_init(SubstCastHits *hits);
+void subst_cast_hits_free(SubstCastHits *hits);
+void subst_cast_hits_add(SubstCastHits *hits, const SubstCastHit *hit);
+// Orders the hits from nearest to farthest
+void subst_cast_hits_sort(SubstCastHits *hits);
+
+#endif
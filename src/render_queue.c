@@ -0,0 +1,129 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "render_queue.h"
+#include "util.h"
+
+#define RENDER_QUEUE_INITIAL_CAPACITY 1024
+
+SubstRenderQueue *subst_render_queue_create(void) {
+  SubstRenderQueue *queue = malloc(sizeof(SubstRenderQueue));
+  queue->count = 0;
+  queue->capacity = RENDER_QUEUE_INITIAL_CAPACITY;
+  queue->commands = malloc(sizeof(SubstRenderCommand) * queue->capacity);
+  queue->items = malloc(sizeof(SubstRenderSortItem) * queue->capacity);
+  queue->sort_buffer = malloc(sizeof(SubstRenderSortItem) * queue->capacity);
+
+  return queue;
+}
+
+void subst_render_queue_free(SubstRenderQueue *queue) {
+  free(queue->commands);
+  free(queue->items);
+  free(queue->sort_buffer);
+  free(queue);
+}
+
+uint64_t subst_render_queue_key_ordered(uint8_t layer, uint64_t sequence) {
+  return ((uint64_t)layer << SUBST_RENDER_KEY_LAYER_SHIFT) |
+         (sequence & ((1ULL << SUBST_RENDER_KEY_LAYER_SHIFT) - 1));
+}
+
+static uint32_t render_queue_depth_bits(float depth) {
+  uint32_t bits;
+  memcpy(&bits, &depth, sizeof(bits));
+
+  // Map the float onto an unsigned integer with the same ordering
+  return (bits & 0x80000000) ? ~bits : bits | 0x80000000;
+}
+
+uint64_t subst_render_queue_key_sorted(uint8_t layer, SubstShader *shader,
+                                       GLuint texture_id, float depth) {
+  uint64_t shader_id = shader ? shader->id & 0xFF : 0;
+  uint64_t texture = texture_id & 0xFFFFFF;
+  uint64_t depth_key = render_queue_depth_bits(depth) >> 8;
+
+  return ((uint64_t)layer << SUBST_RENDER_KEY_LAYER_SHIFT) |
+         (shader_id << SUBST_RENDER_KEY_SHADER_SHIFT) |
+         (texture << SUBST_RENDER_KEY_TEXTURE_SHIFT) | depth_key;
+}
+
+void subst_render_queue_quad_add(SubstRenderQueue *queue, uint64_t key,
+                                 SubstShader *shader, GLuint texture_id,
+                                 const SubstBatchVertex *quad) {
+  if (queue->count == queue->capacity) {
+    queue->capacity *= 2;
+    queue->commands = realloc(queue->commands,
+                              sizeof(SubstRenderCommand) * queue->capacity);
+    queue->items =
+        realloc(queue->items, sizeof(SubstRenderSortItem) * queue->capacity);
+    queue->sort_buffer = realloc(queue->sort_buffer,
+                                 sizeof(SubstRenderSortItem) * queue->capacity);
+  }
+
+  SubstRenderCommand *command = &queue->commands[queue->count];
+  command->shader = shader;
+  command->texture_id = texture_id;
+  memcpy(command->quad, quad, sizeof(SubstBatchVertex) * 4);
+
+  queue->items[queue->count].key = key;
+  queue->items[queue->count].command_index = queue->count;
+  queue->count++;
+}
+
+void subst_render_queue_sort(SubstRenderQueue *queue) {
+  uint32_t counts[256];
+  SubstRenderSortItem *source = queue->items;
+  SubstRenderSortItem *destination = queue->sort_buffer;
+
+  // Least significant digit radix sort, one byte per pass.  Each pass is
+  // stable so commands with equal keys keep their submission order.
+  for (int shift = 0; shift < 64; shift += 8) {
+    memset(counts, 0, sizeof(counts));
+    for (uint32_t i = 0; i < queue->count; i++) {
+      counts[(source[i].key >> shift) & 0xFF]++;
+    }
+
+    // Skip the pass if every key has the same digit
+    if (queue->count == 0 ||
+        counts[(source[0].key >> shift) & 0xFF] == queue->count) {
+      continue;
+    }
+
+    // Turn the counts into starting offsets
+    uint32_t offset = 0;
+    for (int digit = 0; digit < 256; digit++) {
+      uint32_t count = counts[digit];
+      counts[digit] = offset;
+      offset += count;
+    }
+
+    for (uint32_t i = 0; i < queue->count; i++) {
+      destination[counts[(source[i].key >> shift) & 0xFF]++] = source[i];
+    }
+
+    SubstRenderSortItem *swap = source;
+    source = destination;
+    destination = swap;
+  }
+
+  // Keep the sorted items in the primary array
+  if (source != queue->items) {
+    queue->sort_buffer = queue->items;
+    queue->items = source;
+  }
+}
+
+void subst_render_queue_submit(SubstRenderQueue *queue, SubstBatch *batch) {
+  subst_render_queue_sort(queue);
+
+  // Sorted commands with the same shader and texture merge into one run
+  for (uint32_t i = 0; i < queue->count; i++) {
+    SubstRenderCommand *command =
+        &queue->commands[queue->items[i].command_index];
+    subst_batch_quad_add(batch, command->shader, command->texture_id,
+                         command->quad);
+  }
+
+  queue->count = 0;
+}
@@ -0,0 +1,50 @@
+#ifndef __subst_render_queue_h
+#define __subst_render_queue_h
+
+#include <glad/glad.h>
+#include <inttypes.h>
+
+#include "batch.h"
+#include "shader.h"
+
+// Sort keys are laid out from most to least significant as:
+//
+//   ordered layers: layer (8) | submission order (56)
+//   sorted layers:  layer (8) | shader (8) | texture (24) | depth (24)
+#define SUBST_RENDER_KEY_LAYER_SHIFT 56
+#define SUBST_RENDER_KEY_SHADER_SHIFT 48
+#define SUBST_RENDER_KEY_TEXTURE_SHIFT 24
+
+typedef struct {
+  SubstShader *shader;
+  GLuint texture_id;
+  SubstBatchVertex quad[4];
+} SubstRenderCommand;
+
+typedef struct {
+  uint64_t key;
+  uint32_t command_index;
+} SubstRenderSortItem;
+
+typedef struct {
+  uint32_t count;
+  uint32_t capacity;
+  SubstRenderCommand *commands;
+  SubstRenderSortItem *items;
+  SubstRenderSortItem *sort_buffer;
+} SubstRenderQueue;
+
+SubstRenderQueue *subst_render_queue_create(void);
+void subst_render_queue_free(SubstRenderQueue *queue);
+
+uint64_t subst_render_queue_key_ordered(uint8_t layer, uint64_t sequence);
+uint64_t subst_render_queue_key_sorted(uint8_t layer, SubstShader *shader,
+                                       GLuint texture_id, float depth);
+
+void subst_render_queue_quad_add(SubstRenderQueue *queue, uint64_t key,
+                                 SubstShader *shader, GLuint texture_id,
+                                 const SubstBatchVertex *quad);
+void subst_render_queue_sort(SubstRenderQueue *queue);
+void subst_render_queue_submit(SubstRenderQueue *queue, SubstBatch *batch);
+
+#endif
@@ -0,0 +1,63 @@
+#include <glad/glad.h>
+#include <string.h>
+
+#include "render_state.h"
+
+// Mirrors the bits of GL state that the renderer changes most often so that
+// redundant binds can be skipped.  Any code that changes these bindings
+// without going through this file must call subst_render_state_reset!
+static struct {
+  GLuint program;
+  GLuint vertex_array;
+  uint32_t active_texture_unit;
+  GLuint textures[SUBST_RENDER_STATE_TEXTURE_UNITS];
+} render_state;
+
+void subst_render_state_program_use(GLuint program) {
+  if (render_state.program != program) {
+    glUseProgram(program);
+    render_state.program = program;
+  }
+}
+
+void subst_render_state_vertex_array_bind(GLuint vertex_array) {
+  if (render_state.vertex_array != vertex_array) {
+    glBindVertexArray(vertex_array);
+    render_state.vertex_array = vertex_array;
+  }
+}
+
+void subst_render_state_texture_bind(uint32_t unit, GLuint texture_id) {
+  if (render_state.textures[unit] == texture_id) {
+    return;
+  }
+
+  if (render_state.active_texture_unit != unit) {
+    glActiveTexture(GL_TEXTURE0 + unit);
+    render_state.active_texture_unit = unit;
+  }
+
+  glBindTexture(GL_TEXTURE_2D, texture_id);
+  render_state.textures[unit] = texture_id;
+}
+
+void subst_render_state_texture_forget(GLuint texture_id) {
+  // Deleted textures are unbound by GL and their names may be reused
+  for (int i = 0; i < SUBST_RENDER_STATE_TEXTURE_UNITS; i++) {
+    if (render_state.textures[i] == texture_id) {
+      render_state.textures[i] = 0;
+    }
+  }
+}
+
+void subst_render_state_reset(void) {
+  // Put GL back into the state that the cache assumes
+  glUseProgram(0);
+  glBindVertexArray(0);
+  for (int i = SUBST_RENDER_STATE_TEXTURE_UNITS - 1; i >= 0; i--) {
+    glActiveTexture(GL_TEXTURE0 + i);
+    glBindTexture(GL_TEXTURE_2D, 0);
+  }
+
+  memset(&render_state, 0, sizeof(render_state));
+}
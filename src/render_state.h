@@ -0,0 +1,15 @@
+#ifndef __subst_render_state_h
+#define __subst_render_state_h
+
+#include <glad/glad.h>
+#include <inttypes.h>
+
+#define SUBST_RENDER_STATE_TEXTURE_UNITS 8
+
+void subst_render_state_program_use(GLuint program);
+void subst_render_state_vertex_array_bind(GLuint vertex_array);
+void subst_render_state_texture_bind(uint32_t unit, GLuint texture_id);
+void subst_render_state_texture_forget(GLuint texture_id);
+void subst_render_state_reset(void);
+
+#endif
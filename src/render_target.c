@@ -0,0 +1,121 @@
+#include <glad/glad.h>
+#include <mesche.h>
+#include <stdlib.h>
+
+#include "log.h"
+#include "render_state.h"
+#include "render_target.h"
+#include "renderer.h"
+#include "util.h"
+
+SubstRenderTarget *subst_render_target_create(uint32_t width, uint32_t height,
+                                              SubstTextureOptions *options) {
+  GLuint texture_id;
+  SubstRenderTarget *target = malloc(sizeof(SubstRenderTarget));
+
+  // Create the texture that will receive the rendered pixels
+  glGenTextures(1, &texture_id);
+  subst_render_state_texture_bind(0, texture_id);
+  if (options && options->use_smoothing == false) {
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  } else {
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  }
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA,
+               GL_UNSIGNED_BYTE, NULL);
+  subst_render_state_texture_bind(0, 0);
+
+  subst_texture_init(&target->texture, texture_id, width, height);
+
+  // Attach the texture to a new framebuffer
+  GLint previous_framebuffer;
+  glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous_framebuffer);
+  glGenFramebuffers(1, &target->framebuffer_id);
+  glBindFramebuffer(GL_FRAMEBUFFER, target->framebuffer_id);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                         texture_id, 0);
+
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+    PANIC("Render target framebuffer is incomplete!\n");
+  }
+
+  // Start out fully transparent
+  glClearColor(0.f, 0.f, 0.f, 0.f);
+  glClear(GL_COLOR_BUFFER_BIT);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, previous_framebuffer);
+
+  return target;
+}
+
+void subst_render_target_free(SubstRenderTarget *target) {
+  subst_render_state_texture_forget(target->texture.texture_id);
+  glDeleteFramebuffers(1, &target->framebuffer_id);
+  glDeleteTextures(1, &target->texture.texture_id);
+  free(target);
+}
+
+void render_target_free_func(MescheMemory *mem, void *obj) {
+  subst_render_target_free((SubstRenderTarget *)obj);
+}
+
+const ObjectPointerType SubstRenderTargetType = {
+    .name = "render-target", .free_func = render_target_free_func};
+
+Value subst_render_target_create_msc(VM *vm, int arg_count, Value *args) {
+  if (arg_count != 4) {
+    subst_log("Function requires 4 parameters.");
+  }
+
+  SubstRenderer *renderer = (SubstRenderer *)AS_POINTER(args[0])->ptr;
+  uint32_t width = AS_NUMBER(args[1]);
+  uint32_t height = AS_NUMBER(args[2]);
+  SubstTextureOptions options = {.use_smoothing = !IS_FALSE(args[3])};
+
+  // Queued draws must not land in the new framebuffer
+  subst_renderer_flush(renderer);
+
+  SubstRenderTarget *target =
+      subst_render_target_create(width, height, &options);
+
+  return OBJECT_VAL(
+      mesche_object_make_pointer_type(vm, target, &SubstRenderTargetType));
+}
+
+Value subst_render_target_begin_msc(VM *vm, int arg_count, Value *args) {
+  if (arg_count != 2) {
+    subst_log("Function requires 2 parameters.");
+  }
+
+  SubstRenderer *renderer = (SubstRenderer *)AS_POINTER(args[0])->ptr;
+  SubstRenderTarget *target = (SubstRenderTarget *)AS_POINTER(args[1])->ptr;
+  subst_renderer_render_target_begin(renderer, target);
+
+  return TRUE_VAL;
+}
+
+Value subst_render_target_end_msc(VM *vm, int arg_count, Value *args) {
+  if (arg_count != 1) {
+    subst_log("Function requires 1 parameter.");
+  }
+
+  SubstRenderer *renderer = (SubstRenderer *)AS_POINTER(args[0])->ptr;
+  subst_renderer_render_target_end(renderer);
+
+  return TRUE_VAL;
+}
+
+void subst_render_target_module_init(VM *vm) {
+  mesche_vm_define_native_funcs(
+      vm, "substratic renderer",
+      (MescheNativeFuncDetails[]){
+          {"render-target-create-internal", subst_render_target_create_msc,
+           true},
+          {"render-target-begin", subst_render_target_begin_msc, true},
+          {"render-target-end", subst_render_target_end_msc, true},
+          {NULL, NULL, false}});
+}
@@ -0,0 +1,24 @@
+#ifndef __subst_render_target_h
+#define __subst_render_target_h
+
+#include <glad/glad.h>
+#include <mesche.h>
+
+#include "texture.h"
+
+#define SUBST_RENDER_TARGET_MAX_DEPTH 8
+
+typedef struct {
+  // This must come first so that a render target can be drawn anywhere a
+  // SubstTexture is expected
+  SubstTexture texture;
+  GLuint framebuffer_id;
+} SubstRenderTarget;
+
+SubstRenderTarget *subst_render_target_create(uint32_t width, uint32_t height,
+                                              SubstTextureOptions *options);
+void subst_render_target_free(SubstRenderTarget *target);
+
+void subst_render_target_module_init(VM *vm);
+
+#endif
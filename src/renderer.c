@@ -3,30 +3,99 @@
 #include <cglm/cglm.h>
 #include <glad/glad.h>
 #include <inttypes.h>
+#include <stddef.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "log.h"
+#include "profiler.h"
+#include "render_state.h"
 #include "renderer.h"
 #include "util.h"
 
 uint8_t subst_renderer_initialized = 0;
 
-static char output_image_path[1024];
+static struct {
+  SubstShader *shader;
+  GLuint vertex_array;
+  GLuint vertex_buffer;
+  GLuint element_buffer;
+  GLuint instance_buffer;
+  uint32_t capacity;
+  bool is_mapped;
+} rect_instancer;
+
+static void subst_renderer_view_apply(SubstRenderer *renderer) {
+  mat4 view, inverse_view;
+
+  if (renderer->camera) {
+    subst_camera_view_matrix(renderer->camera, renderer->screen_size,
+                             renderer->scale, view);
+    renderer->camera_version = renderer->camera->version;
+  } else {
+    glm_mat4_identity(view);
+    glm_scale(view, (vec3){renderer->scale, renderer->scale, 1.f});
+  }
+
+  glm_mat4_copy(view, renderer->view_matrix);
+
+  // Render targets have their own matrices which get restored when the last
+  // one ends
+  if (renderer->render_target_depth > 0) {
+    return;
+  }
+
+  // Bring the screen rect back through the view to find the visible area
+  vec3 screen_box[2] = {{0.f, 0.f, -1.f},
+                        {renderer->screen_size[0], renderer->screen_size[1],
+                         1.f}};
+  glm_mat4_inv(view, inverse_view);
+  glm_aabb_transform(screen_box, inverse_view, renderer->cull_box);
+
+  // Queued draws were recorded against the old matrices
+  if (memcmp(renderer->screen_matrix, renderer->batch->projection_matrix,
+             sizeof(mat4)) != 0 ||
+      memcmp(view, renderer->batch->view_matrix, sizeof(mat4)) != 0) {
+    subst_renderer_flush(renderer);
+    subst_batch_matrices_set(renderer->batch, renderer->screen_matrix, view);
+  }
+}
+
+static void subst_renderer_camera_sync(SubstRenderer *renderer) {
+  if (renderer->camera &&
+      renderer->camera->version != renderer->camera_version) {
+    subst_renderer_view_apply(renderer);
+  }
+}
 
 static void subst_renderer_window_size_update(SubstRenderer *renderer) {
   // Get the current framebuffer size
   int width, height;
-  glfwGetFramebufferSize(renderer->window->glfwWindow, &width, &height);
+  if (renderer->window->is_headless) {
+    // The offscreen framebuffer is always the requested window size
+    width = renderer->window->width;
+    height = renderer->window->height;
+  } else {
+    glfwGetFramebufferSize(renderer->window->glfwWindow, &width, &height);
+  }
+
+  // Queued draws were recorded against the old viewport and projection
+  subst_renderer_flush(renderer);
 
   renderer->window->width = width;
   renderer->window->height = height;
   renderer->screen_size[0] = width;
   renderer->screen_size[1] = height;
 
-  // Update the viewport and recalculate projection matrix
-  glViewport(0, 0, width, height);
+  // Update the viewport and recalculate projection matrix.  An active render
+  // target keeps its own viewport until the last one ends.
+  if (renderer->render_target_depth == 0) {
+    glViewport(0, 0, width, height);
+  }
   glm_ortho(0.f, renderer->screen_size[0], renderer->screen_size[1], 0.f, -1.f,
             1.f, renderer->screen_matrix);
+  subst_renderer_view_apply(renderer);
 
   // Window is no longer resizing
   renderer->window->is_resizing = false;
@@ -49,6 +118,26 @@ static void subst_renderer_window_size_callback(GLFWwindow *glfwWindow,
   subst_renderer_window_size_update(renderer);
 }
 
+static void subst_renderer_offscreen_create(SubstRenderer *renderer) {
+  glGenRenderbuffers(1, &renderer->framebuffer_color_buffer);
+  glBindRenderbuffer(GL_RENDERBUFFER, renderer->framebuffer_color_buffer);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, renderer->window->width,
+                        renderer->window->height);
+
+  glGenFramebuffers(1, &renderer->framebuffer_id);
+  glBindFramebuffer(GL_FRAMEBUFFER, renderer->framebuffer_id);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                            GL_RENDERBUFFER,
+                            renderer->framebuffer_color_buffer);
+
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+    PANIC("Offscreen framebuffer is incomplete!\n");
+  }
+
+  subst_log("Rendering offscreen at %dx%d\n", renderer->window->width,
+            renderer->window->height);
+}
+
 SubstRenderer *subst_renderer_create(SubstWindow *window) {
   SubstRenderer *renderer = malloc(sizeof(SubstRenderer));
 
@@ -86,85 +175,337 @@ SubstRenderer *subst_renderer_create(SubstWindow *window) {
 
   subst_log("OpenGL Version %d.%d loaded\n", GLVersion.major, GLVersion.minor);
 
+  // Create the sprite batch that all quad draws go through
+  renderer->batch = subst_batch_create();
+  renderer->scale = 1.f;
+  renderer->camera = NULL;
+  renderer->camera_version = 0;
+
+  // Every layer keeps submission order until it's marked as sorted
+  renderer->queue = subst_render_queue_create();
+  renderer->layer = 0;
+  renderer->queue_sequence = 0;
+  memset(renderer->sorted_layers, 0, sizeof(renderer->sorted_layers));
+
+  // Headless windows have no visible surface so draw into our own
+  renderer->framebuffer_id = 0;
+  renderer->framebuffer_color_buffer = 0;
+  if (window->is_headless) {
+    subst_renderer_offscreen_create(renderer);
+  }
+
+  renderer->render_target_depth = 0;
+  renderer->capture = NULL;
+  renderer->capture_path = NULL;
+  renderer->capture_frame_count = 0;
+  renderer->capture_frame_index = 0;
+
   // Run the initial size update
   subst_renderer_window_size_update(renderer);
 
   return renderer;
 }
 
+static void subst_renderer_quad_add(SubstRenderer *renderer,
+                                    SubstShader *shader, GLuint texture_id,
+                                    float x, float y, float left, float top,
+                                    float right, float bottom, float u0,
+                                    float v0, float u1, float v1,
+                                    SubstDrawArgs *args, const float *color) {
+  SubstBatchVertex quad[4];
+  vec3 quad_box[2];
+  float scale_x = 1.f, scale_y = 1.f;
+  float rotation_cos = 1.f, rotation_sin = 0.f;
+
+  subst_renderer_camera_sync(renderer);
+
+  if (args && (args->flags & SubstDrawScaled) == SubstDrawScaled) {
+    scale_x = args->scale_x;
+    scale_y = args->scale_y;
+  }
+
+  if (args && (args->flags & SubstDrawRotated) == SubstDrawRotated) {
+    rotation_cos = cosf(glm_rad(args->rotation));
+    rotation_sin = sinf(glm_rad(args->rotation));
+  }
+
+  // Corners in local space with their texture coordinates
+  const float corners[4][4] = {
+      {left, top, u0, v0},
+      {right, top, u1, v0},
+      {right, bottom, u1, v1},
+      {left, bottom, u0, v1},
+  };
+
+  // Bake the model transform (scale, then rotate, then translate) into the
+  // vertex positions so that consecutive quads can share a draw call
+  for (int i = 0; i < 4; i++) {
+    float local_x = corners[i][0] * scale_x;
+    float local_y = corners[i][1] * scale_y;
+    quad[i].x = x + local_x * rotation_cos - local_y * rotation_sin;
+    quad[i].y = y + local_x * rotation_sin + local_y * rotation_cos;
+    quad[i].u = corners[i][2];
+    quad[i].v = corners[i][3];
+    quad[i].r = color[0];
+    quad[i].g = color[1];
+    quad[i].b = color[2];
+    quad[i].a = color[3];
+  }
+
+  // Skip quads that can't be seen before they cost anything on the GPU
+  glm_aabb_invalidate(quad_box);
+  for (int i = 0; i < 4; i++) {
+    glm_aabb_merge(quad_box, (vec3[2]){{quad[i].x, quad[i].y, 0.f},
+                                       {quad[i].x, quad[i].y, 0.f}},
+                   quad_box);
+  }
+
+  if (!glm_aabb_aabb(quad_box, renderer->cull_box)) {
+    renderer->batch->stats.sprites_culled++;
+    return;
+  }
+
+  uint8_t layer = renderer->layer;
+  uint64_t key;
+  if (renderer->sorted_layers[layer / 8] & (1 << (layer % 8))) {
+    key = subst_render_queue_key_sorted(layer, shader, texture_id,
+                                        args ? args->depth : 0.f);
+  } else {
+    key = subst_render_queue_key_ordered(layer, renderer->queue_sequence++);
+  }
+
+  subst_render_queue_quad_add(renderer->queue, key, shader, texture_id, quad);
+}
+
 void subst_renderer_draw_rect_fill(SubstRenderer *renderer, float x, float y,
                                    float w, float h, vec4 color) {
-  static GLuint shader_program = 0;
-  static GLuint rect_vertex_array = 0;
-  static GLuint rect_vertex_buffer = 0;
-  static GLuint rect_element_buffer = 0;
-
-  if (shader_program == 0) {
-    const SubstShaderFile shader_files[] = {
-        {GL_VERTEX_SHADER, DefaultVertexShaderText},
-        {GL_FRAGMENT_SHADER, DefaultFragmentShaderText},
-    };
-    shader_program = subst_shader_compile(shader_files, 2);
-  }
-
-  // Use the shader
-  glUseProgram(shader_program);
-
-  if (rect_vertex_array == 0) {
-    glGenVertexArrays(1, &rect_vertex_array);
-    glGenBuffers(1, &rect_vertex_buffer);
-    glGenBuffers(1, &rect_element_buffer);
-
-    float vertices[] = {
-        // Positions
-        0.5f,  0.5f,  // top right
-        0.5f,  -0.5f, // bottom right
-        -0.5f, -0.5f, // bottom left
-        -0.5f, 0.5f,  // top left
-    };
-
-    unsigned int indices[] = {
-        0, 1, 2, // first triangle
-        2, 3, 0  // second triangle
-    };
-
-    glBindVertexArray(rect_vertex_array);
-
-    glBindBuffer(GL_ARRAY_BUFFER, rect_vertex_buffer);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, rect_element_buffer);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices,
-                 GL_STATIC_DRAW);
-
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), 0);
-    glEnableVertexAttribArray(0);
+  // Rects use the batch's white texture so they don't break up sprite runs
+  subst_renderer_quad_add(renderer, NULL, 0, x, y, 0.f, 0.f, w, h, 0.f, 0.f,
+                          1.f, 1.f, NULL, color);
+}
+
+void subst_renderer_flush(SubstRenderer *renderer) {
+  // Anything that touches GL state outside of the batch has to see every
+  // quad recorded before it, so the queue is sorted and submitted here
+  subst_render_queue_submit(renderer->queue, renderer->batch);
+  subst_batch_flush(renderer->batch);
+}
+
+void subst_renderer_camera_set(SubstRenderer *renderer, SubstCamera *camera) {
+  // Retain the new camera before releasing the old one in case they match
+  if (camera) {
+    subst_camera_retain(camera);
+  }
+  if (renderer->camera) {
+    subst_camera_release(renderer->camera);
+  }
+
+  renderer->camera = camera;
+  subst_renderer_view_apply(renderer);
+}
+
+bool subst_renderer_box_visible(SubstRenderer *renderer, vec3 box[2]) {
+  subst_renderer_camera_sync(renderer);
+  return glm_aabb_aabb(box, renderer->cull_box);
+}
+
+float subst_renderer_pixel_scale(SubstRenderer *renderer) {
+  // How many pixels one unit along the x axis covers with the current view
+  subst_renderer_camera_sync(renderer);
+  return glm_vec3_norm(renderer->batch->view_matrix[0]);
+}
+
+void subst_renderer_layer_set(SubstRenderer *renderer, uint8_t layer) {
+  renderer->layer = layer;
+}
+
+void subst_renderer_layer_sorted_set(SubstRenderer *renderer, uint8_t layer,
+                                     bool is_sorted) {
+  if (is_sorted) {
+    renderer->sorted_layers[layer / 8] |= 1 << (layer % 8);
+  } else {
+    renderer->sorted_layers[layer / 8] &= ~(1 << (layer % 8));
+  }
+}
+
+static void subst_renderer_framebuffer_apply(SubstRenderer *renderer) {
+  if (renderer->render_target_depth > 0) {
+    SubstRenderTarget *target =
+        renderer->render_targets[renderer->render_target_depth - 1];
+    mat4 projection, view;
+
+    // Flip the projection so that the top of the drawing lands at the top of
+    // the texture when it gets sampled later.  Target drawing is done in
+    // target pixels so the renderer's view matrix doesn't apply.
+    glBindFramebuffer(GL_FRAMEBUFFER, target->framebuffer_id);
+    glViewport(0, 0, target->texture.width, target->texture.height);
+    glm_ortho(0.f, target->texture.width, 0.f, target->texture.height, -1.f,
+              1.f, projection);
+    glm_mat4_identity(view);
+    subst_batch_matrices_set(renderer->batch, projection, view);
+
+    glm_vec3_copy((vec3){0.f, 0.f, -1.f}, renderer->cull_box[0]);
+    glm_vec3_copy((vec3){target->texture.width, target->texture.height, 1.f},
+                  renderer->cull_box[1]);
   } else {
-    glBindVertexArray(rect_vertex_array);
+    glBindFramebuffer(GL_FRAMEBUFFER, renderer->framebuffer_id);
+    glViewport(0, 0, renderer->screen_size[0], renderer->screen_size[1]);
+    subst_renderer_view_apply(renderer);
+  }
+}
+
+void subst_renderer_render_target_begin(SubstRenderer *renderer,
+                                        SubstRenderTarget *target) {
+  if (renderer->render_target_depth == SUBST_RENDER_TARGET_MAX_DEPTH) {
+    PANIC("Render targets can only be nested %d deep!\n",
+          SUBST_RENDER_TARGET_MAX_DEPTH);
+  }
+
+  // Draws queued so far belong to the previous framebuffer
+  subst_renderer_flush(renderer);
+
+  renderer->render_targets[renderer->render_target_depth] = target;
+  renderer->render_target_depth++;
+  subst_renderer_framebuffer_apply(renderer);
+  subst_profiler_gpu_begin("render-target");
+}
+
+void subst_renderer_render_target_end(SubstRenderer *renderer) {
+  if (renderer->render_target_depth == 0) {
+    subst_log("No render target to end!\n");
+    return;
+  }
+
+  // Everything queued so far belongs to the target that is ending
+  subst_renderer_flush(renderer);
+  subst_profiler_gpu_end();
+
+  renderer->render_target_depth--;
+  subst_renderer_framebuffer_apply(renderer);
+}
+
+static void subst_renderer_rect_instancer_init(void) {
+  const SubstShaderFile shader_files[] = {
+      {GL_VERTEX_SHADER, InstancedRectVertexShaderText},
+      {GL_FRAGMENT_SHADER, InstancedRectFragmentShaderText},
+  };
+  rect_instancer.shader = subst_shader_compile(shader_files, 2);
+
+  // The shared quad spans 0,0 to 1,1 and gets placed by each instance's rect
+  float vertices[] = {
+      // Positions
+      1.f, 1.f, // bottom right
+      1.f, 0.f, // top right
+      0.f, 0.f, // top left
+      0.f, 1.f, // bottom left
+  };
+
+  unsigned int indices[] = {
+      0, 1, 2, // first triangle
+      2, 3, 0  // second triangle
+  };
+
+  glGenVertexArrays(1, &rect_instancer.vertex_array);
+  glGenBuffers(1, &rect_instancer.vertex_buffer);
+  glGenBuffers(1, &rect_instancer.element_buffer);
+  glGenBuffers(1, &rect_instancer.instance_buffer);
+
+  subst_render_state_vertex_array_bind(rect_instancer.vertex_array);
+
+  glBindBuffer(GL_ARRAY_BUFFER, rect_instancer.vertex_buffer);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), 0);
+
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, rect_instancer.element_buffer);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices,
+               GL_STATIC_DRAW);
+
+  // Per-instance attributes advance once per rect instead of once per vertex
+  glBindBuffer(GL_ARRAY_BUFFER, rect_instancer.instance_buffer);
+  glEnableVertexAttribArray(1);
+  glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(SubstRectInstance),
+                        (const void *)offsetof(SubstRectInstance, x));
+  glVertexAttribDivisor(1, 1);
+
+  glEnableVertexAttribArray(2);
+  glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(SubstRectInstance),
+                        (const void *)offsetof(SubstRectInstance, color));
+  glVertexAttribDivisor(2, 1);
+}
+
+SubstRectInstance *subst_renderer_rect_instances_begin(SubstRenderer *renderer,
+                                                       uint32_t max_count) {
+  if (rect_instancer.vertex_array == 0) {
+    subst_renderer_rect_instancer_init();
+  }
+
+  if (max_count == 0) {
+    return NULL;
   }
 
-  // Model matrix is scaled to size and translated
-  mat4 model;
-  glm_translate_make(model, (vec3){x + (w / 2.f), y + (h / 2.f), 0.f});
-  glm_scale(model, (vec3){w, h, 0.f});
+  // Grow the instance buffer to fit the largest request seen so far
+  glBindBuffer(GL_ARRAY_BUFFER, rect_instancer.instance_buffer);
+  if (max_count > rect_instancer.capacity) {
+    rect_instancer.capacity = max_count;
+  }
 
-  // Set the uniforms
-  glUniformMatrix4fv(glGetUniformLocation(shader_program, "projection"), 1,
-                     GL_FALSE, (float *)renderer->screen_matrix);
-  glUniformMatrix4fv(glGetUniformLocation(shader_program, "view"), 1, GL_FALSE,
-                     (float *)renderer->view_matrix);
-  glUniformMatrix4fv(glGetUniformLocation(shader_program, "model"), 1, GL_FALSE,
-                     (float *)model);
-  glUniform4fv(glGetUniformLocation(shader_program, "color"), 1,
-               (float *)color);
+  // Orphan the old storage and write the instances straight into the new one
+  glBufferData(GL_ARRAY_BUFFER,
+               sizeof(SubstRectInstance) * rect_instancer.capacity, NULL,
+               GL_STREAM_DRAW);
+
+  SubstRectInstance *instances = glMapBufferRange(
+      GL_ARRAY_BUFFER, 0, sizeof(SubstRectInstance) * max_count,
+      GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+  if (instances == NULL) {
+    subst_log("Could not map rect instance buffer for %u instances\n",
+              max_count);
+    rect_instancer.is_mapped = false;
+    return NULL;
+  }
 
-  // Draw all 6 indices in the element buffer
-  glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+  rect_instancer.is_mapped = true;
+  return instances;
+}
+
+void subst_renderer_rect_instances_end(SubstRenderer *renderer,
+                                       uint32_t count) {
+  SubstShader *shader = rect_instancer.shader;
+
+  if (rect_instancer.is_mapped) {
+    glBindBuffer(GL_ARRAY_BUFFER, rect_instancer.instance_buffer);
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+    rect_instancer.is_mapped = false;
+  }
+
+  if (count == 0) {
+    return;
+  }
+
+  // Instances must land on top of anything drawn before them
+  subst_renderer_camera_sync(renderer);
+  subst_renderer_flush(renderer);
+
+  subst_render_state_program_use(shader->program);
+  subst_render_state_vertex_array_bind(rect_instancer.vertex_array);
+
+  // Use the batch's copy of the matrices so that they stay in sync
+  subst_shader_matrices_apply(shader, renderer->batch->projection_matrix,
+                              renderer->batch->view_matrix,
+                              renderer->batch->matrix_version);
+
+  // Draw every rect with a single call
+  glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0, count);
+
+  renderer->batch->stats.sprites_submitted += count;
+  renderer->batch->stats.draws_issued++;
 }
 
 void subst_renderer_draw_args_init(SubstDrawArgs *args, float scale) {
   args->flags = 0;
-  args->shader_program = 0;
+  args->depth = 0.f;
+  args->shader = NULL;
   if (scale != 0) {
     args->scale_x = scale;
     args->scale_y = scale;
@@ -197,68 +538,12 @@ void subst_renderer_draw_args_center(SubstDrawArgs *args, bool centered) {
 void subst_renderer_draw_texture_ex(SubstRenderer *renderer,
                                     SubstTexture *texture, float x, float y,
                                     SubstDrawArgs *args) {
-  GLuint shader_program = 0;
-  static GLuint default_shader_program = 0;
-  static GLuint rect_vertex_array = 0;
-  static GLuint rect_vertex_buffer = 0;
-  static GLuint rect_element_buffer = 0;
+  SubstShader *shader = NULL;
+  const vec4 color = {1.f, 1.f, 1.f, 1.f};
 
+  // The batch falls back to the default texture shader when this is NULL
   if (args != NULL) {
-    shader_program = args->shader_program;
-  }
-
-  // Use the default texture shader if one isn't specified
-  if (shader_program == 0) {
-    if (default_shader_program == 0) {
-      const SubstShaderFile shader_files[] = {
-          {GL_VERTEX_SHADER, TexturedVertexShaderText},
-          {GL_FRAGMENT_SHADER, TexturedFragmentShaderText},
-      };
-      default_shader_program = subst_shader_compile(shader_files, 2);
-    }
-
-    shader_program = default_shader_program;
-  }
-
-  // Use the shader
-  glUseProgram(shader_program);
-
-  if (rect_vertex_array == 0) {
-    glGenVertexArrays(1, &rect_vertex_array);
-    glGenBuffers(1, &rect_vertex_buffer);
-    glGenBuffers(1, &rect_element_buffer);
-
-    // Texture coordinates are 0,0 for bottom left and 1,1 for top right
-    float vertices[] = {
-        // Positions   // Texture
-        0.5f,  0.5f,  1.f, 1.f, // top right
-        0.5f,  -0.5f, 1.f, 0.f, // bottom right
-        -0.5f, -0.5f, 0.f, 0.f, // bottom left
-        -0.5f, 0.5f,  0.f, 1.f, // top left
-    };
-
-    unsigned int indices[] = {
-        0, 1, 2, // first triangle
-        2, 3, 0  // second triangle
-    };
-
-    glBindVertexArray(rect_vertex_array);
-
-    glBindBuffer(GL_ARRAY_BUFFER, rect_vertex_buffer);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, rect_element_buffer);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices,
-                 GL_STATIC_DRAW);
-
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), 0);
-
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float),
-                          (const void *)(2 * sizeof(float)));
-  } else {
-    glBindVertexArray(rect_vertex_array);
+    shader = args->shader;
   }
 
   // Adjust position if texture shouldn't be drawn centered
@@ -267,49 +552,18 @@ void subst_renderer_draw_texture_ex(SubstRenderer *renderer,
     y += texture->height / 2.f;
   }
 
-  float scale_x = 1.f, scale_y = 1.f;
-  if (args && (args->flags & SubstDrawScaled) == SubstDrawScaled) {
-    scale_x = args->scale_x;
-    scale_y = args->scale_y;
-  }
-
-  // Model matrix is scaled to size and translated
-  mat4 model;
-  glm_translate_make(model, (vec3){x, y, 0.f});
-
-  // Rotate if requested
-  if (args && (args->flags & SubstDrawRotated) == SubstDrawRotated) {
-    glm_rotate(model, glm_rad(args->rotation), (vec3){0.f, 0.f, 1.f});
-  }
-
-  // Scale as the last thing we do
-  glm_scale(model,
-            (vec3){texture->width * scale_x, texture->height * scale_y, 0.f});
-
-  mat4 view;
-  glm_mat4_identity(view);
-
-  // Set the uniforms
-  vec4 color = {1.f, 1.f, 1.f, 1.f};
-  glUniformMatrix4fv(glGetUniformLocation(shader_program, "projection"), 1,
-                     GL_FALSE, (float *)renderer->screen_matrix);
-  glUniformMatrix4fv(glGetUniformLocation(shader_program, "view"), 1, GL_FALSE,
-                     (float *)renderer->view_matrix);
-  glUniformMatrix4fv(glGetUniformLocation(shader_program, "model"), 1, GL_FALSE,
-                     (float *)model);
-  glUniform4fv(glGetUniformLocation(shader_program, "color"), 1,
-               (float *)color);
-
-  // Bind the texture
-  glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_2D, texture->texture_id);
-  glUniform1i(glGetUniformLocation(shader_program, "tex0"), 0);
-
-  // Draw all 6 indices in the element buffer
-  glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-
-  // Reset the texture
-  glBindTexture(GL_TEXTURE_2D, 0);
+  // Texture coordinates cover the texture's region of its GL texture
+  float texture_u = (float)texture->region_x / texture->page_width;
+  float texture_v = (float)texture->region_y / texture->page_height;
+  float region_width = (float)texture->width / texture->page_width;
+  float region_height = (float)texture->height / texture->page_height;
+
+  float half_width = texture->width / 2.f;
+  float half_height = texture->height / 2.f;
+  subst_renderer_quad_add(renderer, shader, texture->texture_id, x, y,
+                          -half_width, -half_height, half_width, half_height,
+                          texture_u, texture_v, texture_u + region_width,
+                          texture_v + region_height, args, color);
 }
 
 void subst_renderer_draw_texture_region_ex(SubstRenderer *renderer,
@@ -317,128 +571,35 @@ void subst_renderer_draw_texture_region_ex(SubstRenderer *renderer,
                                            float y, float width, float height,
                                            float texture_x, float texture_y,
                                            SubstDrawArgs *args) {
-  GLuint shader_program = 0;
-  static GLuint default_shader_program = 0;
-  static GLuint rect_vertex_array = 0;
-  static GLuint rect_vertex_buffer = 0;
-  static GLuint rect_element_buffer = 0;
+  SubstShader *shader = NULL;
+  const vec4 color = {1.f, 1.f, 1.f, 1.f};
 
   if (args != NULL) {
-    shader_program = args->shader_program;
+    shader = args->shader;
   }
 
-  // Use the default texture shader if one isn't specified
-  if (shader_program == 0) {
-    if (default_shader_program == 0) {
-      const SubstShaderFile shader_files[] = {
-          {GL_VERTEX_SHADER, TexturedVertexShaderText},
-          {GL_FRAGMENT_SHADER, TexturedFragmentShaderText},
-      };
-      default_shader_program = subst_shader_compile(shader_files, 2);
-    }
-
-    shader_program = default_shader_program;
-  }
-
-  // Use the shader
-  glUseProgram(shader_program);
-
-  if (rect_vertex_array == 0) {
-    glGenVertexArrays(1, &rect_vertex_array);
-    glGenBuffers(1, &rect_vertex_buffer);
-    glGenBuffers(1, &rect_element_buffer);
-
-    glBindVertexArray(rect_vertex_array);
-
-    unsigned int indices[] = {
-        0, 1, 2, // first triangle
-        2, 3, 0  // second triangle
-    };
-
-    glBindBuffer(GL_ARRAY_BUFFER, rect_vertex_buffer);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 16, NULL, GL_STATIC_DRAW);
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, rect_element_buffer);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices,
-                 GL_STATIC_DRAW);
-
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), 0);
-
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float),
-                          (const void *)(2 * sizeof(float)));
-  } else {
-    glBindVertexArray(rect_vertex_array);
-  }
-
-  // Calculate the texture coordinates
-  float texture_u = texture_x / texture->width;
-  float texture_v = texture_y / texture->height;
-  float region_width = width / texture->width;
-  float region_height = height / texture->height;
-
-  // Texture coordinates are 0,0 for bottom left and 1,1 for top right
-  // clang-format off
-  float vertices[] = {
-      // Positions   // Texture
-      width, height, texture_u + region_width, texture_v + region_height, // top right
-      width, 0,      texture_u + region_width, texture_v,                 // bottom right
-      0, 0,          texture_u, texture_v,                                // bottom left
-      0, height,     texture_u, texture_v + region_height,                // top left
-  };
-  glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), &vertices);
-  // clang-format on
-
-  // Adjust position if texture shouldn't be drawn centered
-
-  float scale_x = 1.f, scale_y = 1.f;
-  if (args && (args->flags & SubstDrawScaled) == SubstDrawScaled) {
-    scale_x = args->scale_x;
-    scale_y = args->scale_y;
-  }
+  // Calculate the texture coordinates relative to the texture's region
+  float texture_u = (texture->region_x + texture_x) / texture->page_width;
+  float texture_v = (texture->region_y + texture_y) / texture->page_height;
+  float region_width = width / texture->page_width;
+  float region_height = height / texture->page_height;
 
+  // Adjust position if texture should be drawn centered
   if (args && (args->flags & SubstDrawCentered) == SubstDrawCentered) {
+    float scale_x = 1.f, scale_y = 1.f;
+    if ((args->flags & SubstDrawScaled) == SubstDrawScaled) {
+      scale_x = args->scale_x;
+      scale_y = args->scale_y;
+    }
+
     x -= width / 2.f * scale_x;
     y -= height / 2.f * scale_y;
   }
 
-  // Model matrix is scaled to size and translated
-  mat4 model;
-  glm_translate_make(model, (vec3){x, y, 0.f});
-
-  // Rotate if requested
-  if (args && (args->flags & SubstDrawRotated) == SubstDrawRotated) {
-    glm_rotate(model, glm_rad(args->rotation), (vec3){0.f, 0.f, 1.f});
-  }
-
-  // Scale as the last thing we do
-  glm_scale(model, (vec3){scale_x, scale_y, 0.f});
-
-  mat4 view;
-  glm_mat4_identity(view);
-
-  // Set the uniforms
-  vec4 color = {1.f, 1.f, 1.f, 1.f};
-  glUniformMatrix4fv(glGetUniformLocation(shader_program, "projection"), 1,
-                     GL_FALSE, (float *)renderer->screen_matrix);
-  glUniformMatrix4fv(glGetUniformLocation(shader_program, "view"), 1, GL_FALSE,
-                     (float *)renderer->view_matrix);
-  glUniformMatrix4fv(glGetUniformLocation(shader_program, "model"), 1, GL_FALSE,
-                     (float *)model);
-  glUniform4fv(glGetUniformLocation(shader_program, "color"), 1,
-               (float *)color);
-
-  // Bind the texture
-  glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_2D, texture->texture_id);
-  glUniform1i(glGetUniformLocation(shader_program, "tex0"), 0);
-
-  // Draw all 6 indices in the element buffer
-  glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-
-  // Reset the texture
-  glBindTexture(GL_TEXTURE_2D, 0);
+  subst_renderer_quad_add(renderer, shader, texture->texture_id, x, y,
+                          0.f, 0.f, width, height, texture_u, texture_v,
+                          texture_u + region_width, texture_v + region_height,
+                          args, color);
 }
 
 void subst_renderer_draw_texture(SubstRenderer *renderer, SubstTexture *texture,
@@ -448,56 +609,79 @@ void subst_renderer_draw_texture(SubstRenderer *renderer, SubstTexture *texture,
 
 void subst_renderer_save_to_png(SubstRenderer *renderer,
                                 const char *output_file_path) {
-  int i = 0;
-  unsigned char *screen_bytes = NULL;
-  unsigned char *image_bytes = NULL;
-  size_t image_row_length = 4 * renderer->window->width;
-  size_t image_data_size =
-      sizeof(*image_bytes) * image_row_length * renderer->window->height;
-
-  /* subst_log("Rendering window of size %u / %u to file: %s\n",
-   * renderer->window->width, renderer->window->height, */
-  /*          output_file_path); */
-
-  // Allocate storage for the screen bytes
-  // TODO: reduce memory allocation requirements
-  screen_bytes = malloc(image_data_size);
-  image_bytes = malloc(image_data_size);
+  // Make sure all queued draws have reached the framebuffer
+  subst_renderer_flush(renderer);
 
   // TODO: Switch context to this window
 
-  // Store the screen contents to a byte array
-  glReadPixels(0, 0, renderer->window->width, renderer->window->height, GL_RGBA,
-               GL_UNSIGNED_BYTE, screen_bytes);
-
-  // Flip the rows of the byte array because OpenGL's coordinate system is
-  // flipped
-  for (i = 0; i < renderer->window->height; i++) {
-    memcpy(&image_bytes[image_row_length * i],
-           &screen_bytes[image_row_length *
-                         ((int)renderer->window->height - (i + 1))],
-           sizeof(*image_bytes) * image_row_length);
+  // The pixels are read back asynchronously and written to the file by a
+  // worker thread once they arrive, so this doesn't stall the frame
+  if (renderer->capture == NULL) {
+    renderer->capture = subst_capture_create();
   }
 
-  // Save image data to a PNG file
-  subst_texture_png_save(output_file_path, image_bytes, renderer->window->width,
-                         renderer->window->height);
-
-  // Clean up the memory
-  free(image_bytes);
-  free(screen_bytes);
+  subst_capture_frame_request(renderer->capture, renderer->window->width,
+                              renderer->window->height, output_file_path);
 }
 
 void subst_renderer_end(void) { glfwTerminate(); }
 
+void subst_renderer_render_to_file(SubstRenderer *renderer,
+                                   const char *output_file_path,
+                                   uint32_t frame_count) {
+  free(renderer->capture_path);
+  renderer->capture_path = strdup(output_file_path);
+  renderer->capture_frame_count = frame_count;
+  renderer->capture_frame_index = 0;
+}
+
+static void subst_renderer_capture_frame(SubstRenderer *renderer) {
+  char frame_path[1024];
+  const char *output_path = renderer->capture_path;
+
+  // Sequences get the frame number inserted before the file extension
+  if (renderer->capture_frame_count > 1) {
+    const char *extension = strrchr(renderer->capture_path, '.');
+    int stem_length = extension ? extension - renderer->capture_path
+                                : (int)strlen(renderer->capture_path);
+    snprintf(frame_path, sizeof(frame_path), "%.*s-%04d%s", stem_length,
+             renderer->capture_path, renderer->capture_frame_index,
+             extension ? extension : "");
+    output_path = frame_path;
+  }
+
+  subst_renderer_save_to_png(renderer, output_path);
+  renderer->capture_frame_index++;
+
+  if (renderer->capture_frame_index == renderer->capture_frame_count) {
+    free(renderer->capture_path);
+    renderer->capture_path = NULL;
+    renderer->capture_frame_count = 0;
+
+    // Make sure every file has been written before anyone looks for them
+    subst_capture_flush(renderer->capture);
+
+    // There's nobody to close a headless window so finish the loop here
+    if (renderer->window->is_headless) {
+      glfwSetWindowShouldClose(renderer->window->glfwWindow, GLFW_TRUE);
+    }
+  }
+}
+
 Value subst_renderer_func_render_to_file(VM *vm, int arg_count, Value *args) {
-  if (arg_count != 1) {
-    subst_log("Function requires a path to the output file.");
+  if (arg_count != 3) {
+    subst_log("Function requires 3 parameters.");
   }
 
-  char *file_path = AS_CSTRING(args[0]);
+  ObjectPointer *ptr = AS_POINTER(args[0]);
+  SubstRenderer *renderer = (SubstRenderer *)ptr->ptr;
+  char *file_path = AS_CSTRING(args[1]);
+  uint32_t frame_count = IS_NUMBER(args[2]) ? AS_NUMBER(args[2]) : 1;
+
   subst_log("Received request to save image: %s\n", file_path);
-  memcpy(output_image_path, file_path, strlen(file_path));
+  subst_renderer_render_to_file(renderer, file_path, frame_count);
+
+  return TRUE_VAL;
 }
 
 Value subst_renderer_create_msc(VM *vm, int arg_count, Value *args) {
@@ -515,8 +699,8 @@ Value subst_renderer_create_msc(VM *vm, int arg_count, Value *args) {
 }
 
 Value subst_renderer_clear_msc(VM *vm, int arg_count, Value *args) {
-  if (arg_count != 4) {
-    subst_log("Function requires 4 parameters.");
+  if (arg_count != 5) {
+    subst_log("Function requires 5 parameters.");
   }
 
   ObjectPointer *ptr = AS_POINTER(args[0]);
@@ -525,7 +709,16 @@ Value subst_renderer_clear_msc(VM *vm, int arg_count, Value *args) {
   int g = AS_NUMBER(args[2]);
   int b = AS_NUMBER(args[3]);
 
-  glClearColor(r / 255.0, g / 255.0, b / 255.0, 1.0);
+  // Render targets holding cached layers are cleared to transparent
+  int a = 255;
+  if (IS_NUMBER(args[4])) {
+    a = AS_NUMBER(args[4]);
+  }
+
+  // Draws recorded before the clear would otherwise land on top of it
+  subst_renderer_flush(renderer);
+
+  glClearColor(r / 255.0, g / 255.0, b / 255.0, a / 255.0);
   glClear(GL_COLOR_BUFFER_BIT);
 
   return TRUE_VAL;
@@ -535,8 +728,34 @@ Value subst_renderer_swap_buffers_msc(VM *vm, int arg_count, Value *args) {
   ObjectPointer *ptr = AS_POINTER(args[0]);
   SubstRenderer *renderer = (SubstRenderer *)ptr->ptr;
 
-  // Swap the render buffers
-  glfwSwapBuffers(renderer->window->glfwWindow);
+  subst_profiler_zone_begin("swap");
+
+  // Submit any remaining draws and close out the frame's statistics
+  subst_renderer_flush(renderer);
+  subst_batch_frame_end(renderer->batch);
+  renderer->queue_sequence = 0;
+  subst_profiler_gpu_end();
+
+  // Save the finished frame if requested
+  if (renderer->capture_frame_count > 0) {
+    subst_renderer_capture_frame(renderer);
+  }
+
+  // Hand off any frame readbacks that have finished since the last swap
+  if (renderer->capture) {
+    subst_capture_update(renderer->capture);
+  }
+
+  // Swap the render buffers, headless renderers have nothing to present
+  if (!renderer->window->is_headless) {
+    glfwSwapBuffers(renderer->window->glfwWindow);
+  }
+
+  subst_profiler_zone_end();
+  subst_profiler_frame_end();
+
+  // Time the GPU work for the next frame's drawing to the screen
+  subst_profiler_gpu_begin("screen");
 
   return TRUE_VAL;
 }
@@ -544,12 +763,13 @@ Value subst_renderer_swap_buffers_msc(VM *vm, int arg_count, Value *args) {
 Value subst_renderer_scale_set_msc(VM *vm, int arg_count, Value *args) {
   ObjectPointer *ptr = AS_POINTER(args[0]);
   SubstRenderer *renderer = (SubstRenderer *)ptr->ptr;
+
+  // Queued draws were recorded with the old scale
+  subst_renderer_flush(renderer);
   renderer->scale = AS_NUMBER(args[1]);
 
-  // Apply the scale to the view matrix after resetting it
-  glm_mat4_identity(renderer->view_matrix);
-  glm_scale(renderer->view_matrix,
-            (vec3){renderer->scale, renderer->scale, 1.f});
+  // Rebuild the view matrix with the new scale
+  subst_renderer_view_apply(renderer);
 
   return UNSPECIFIED_VAL;
 }
@@ -580,6 +800,9 @@ Value subst_renderer_draw_texture_msc(VM *vm, int arg_count, Value *args) {
   SubstDrawArgs draw_args;
   subst_renderer_draw_args_init(&draw_args, scale);
   subst_renderer_draw_args_center(&draw_args, centered);
+  if (arg_count > 6 && IS_NUMBER(args[6])) {
+    draw_args.depth = AS_NUMBER(args[6]);
+  }
   subst_renderer_draw_texture_ex(renderer, texture, x, y, &draw_args);
 
   return TRUE_VAL;
@@ -602,12 +825,73 @@ Value subst_renderer_draw_texture_region_msc(VM *vm, int arg_count,
   SubstDrawArgs draw_args;
   subst_renderer_draw_args_init(&draw_args, scale);
   subst_renderer_draw_args_center(&draw_args, centered);
+  if (arg_count > 10 && IS_NUMBER(args[10])) {
+    draw_args.depth = AS_NUMBER(args[10]);
+  }
   subst_renderer_draw_texture_region_ex(renderer, texture, x, y, width, height,
                                         texture_x, texture_y, &draw_args);
 
   return TRUE_VAL;
 }
 
+Value subst_renderer_stats_draws_msc(VM *vm, int arg_count, Value *args) {
+  ObjectPointer *ptr = AS_POINTER(args[0]);
+  SubstRenderer *renderer = (SubstRenderer *)ptr->ptr;
+  return NUMBER_VAL(renderer->batch->last_frame_stats.draws_issued);
+}
+
+Value subst_renderer_stats_sprites_msc(VM *vm, int arg_count, Value *args) {
+  ObjectPointer *ptr = AS_POINTER(args[0]);
+  SubstRenderer *renderer = (SubstRenderer *)ptr->ptr;
+  return NUMBER_VAL(renderer->batch->last_frame_stats.sprites_submitted);
+}
+
+Value subst_renderer_stats_culled_msc(VM *vm, int arg_count, Value *args) {
+  ObjectPointer *ptr = AS_POINTER(args[0]);
+  SubstRenderer *renderer = (SubstRenderer *)ptr->ptr;
+  return NUMBER_VAL(renderer->batch->last_frame_stats.sprites_culled);
+}
+
+Value subst_renderer_camera_set_msc(VM *vm, int arg_count, Value *args) {
+  if (arg_count != 2) {
+    subst_log("Function requires 2 parameters.");
+  }
+
+  SubstRenderer *renderer = (SubstRenderer *)AS_POINTER(args[0])->ptr;
+  SubstCamera *camera = NULL;
+  if (!IS_FALSE(args[1])) {
+    camera = (SubstCamera *)AS_POINTER(args[1])->ptr;
+  }
+
+  subst_renderer_camera_set(renderer, camera);
+
+  return UNSPECIFIED_VAL;
+}
+
+Value subst_renderer_layer_set_msc(VM *vm, int arg_count, Value *args) {
+  if (arg_count != 2) {
+    subst_log("Function requires 2 parameters.");
+  }
+
+  SubstRenderer *renderer = (SubstRenderer *)AS_POINTER(args[0])->ptr;
+  subst_renderer_layer_set(renderer, AS_NUMBER(args[1]));
+
+  return UNSPECIFIED_VAL;
+}
+
+Value subst_renderer_layer_sorted_set_msc(VM *vm, int arg_count,
+                                          Value *args) {
+  if (arg_count != 3) {
+    subst_log("Function requires 3 parameters.");
+  }
+
+  SubstRenderer *renderer = (SubstRenderer *)AS_POINTER(args[0])->ptr;
+  subst_renderer_layer_sorted_set(renderer, AS_NUMBER(args[1]),
+                                  !IS_FALSE(args[2]));
+
+  return UNSPECIFIED_VAL;
+}
+
 Value subst_renderer_rgb_msc(VM *vm, int arg_count, Value *args) {
   SubstColor *color = malloc(sizeof(SubstColor));
   color->r = AS_NUMBER(args[0]) / 255.0;
@@ -657,14 +941,23 @@ void subst_renderer_module_init(VM *vm) {
       vm, "substratic renderer",
       (MescheNativeFuncDetails[]){
           {"renderer-create", subst_renderer_create_msc, true},
-          {"renderer-clear", subst_renderer_clear_msc, true},
+          {"renderer-clear-internal", subst_renderer_clear_msc, true},
           {"renderer-swap-buffers", subst_renderer_swap_buffers_msc, true},
+          {"renderer-render-to-file-internal",
+           subst_renderer_func_render_to_file, true},
           {"renderer-scale-set!", subst_renderer_scale_set_msc, true},
           {"renderer-draw-rect", subst_renderer_draw_rect_msc, true},
           {"renderer-draw-texture-internal", subst_renderer_draw_texture_msc,
            true},
           {"renderer-draw-texture-region-internal",
            subst_renderer_draw_texture_region_msc, true},
+          {"renderer-stats-draws", subst_renderer_stats_draws_msc, true},
+          {"renderer-stats-sprites", subst_renderer_stats_sprites_msc, true},
+          {"renderer-stats-culled", subst_renderer_stats_culled_msc, true},
+          {"renderer-camera-set!", subst_renderer_camera_set_msc, true},
+          {"renderer-layer-set!", subst_renderer_layer_set_msc, true},
+          {"renderer-layer-sorted-set!", subst_renderer_layer_sorted_set_msc,
+           true},
           {"rgb", subst_renderer_rgb_msc, true},
           {"rgba", subst_renderer_rgba_msc, true},
           {"color-r", subst_renderer_color_r_msc, true},
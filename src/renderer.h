@@ -5,6 +5,11 @@
 #include <glad/glad.h>
 #include <mesche.h>
 
+#include "batch.h"
+#include "camera.h"
+#include "capture.h"
+#include "render_queue.h"
+#include "render_target.h"
 #include "shader.h"
 #include "texture.h"
 #include "window.h"
@@ -16,6 +21,39 @@ typedef struct {
   mat4 screen_matrix;
   mat4 view_matrix;
   float scale;
+  SubstBatch *batch;
+
+  // Optional camera that drives the view matrix, retained while it is set
+  SubstCamera *camera;
+  uint32_t camera_version;
+
+  // Bounds of the visible area in draw coordinates, quads that fall
+  // outside of it are dropped before they are queued
+  vec3 cull_box[2];
+
+  // Quads are recorded here and sorted by key before they reach the batch.
+  // Layers are drawn in order and are either kept in submission order or
+  // sorted by shader, texture and depth to reduce state changes.
+  SubstRenderQueue *queue;
+  uint8_t layer;
+  uint8_t sorted_layers[32];
+  uint64_t queue_sequence;
+
+  // Headless renderers draw into this framebuffer instead of the window's
+  GLuint framebuffer_id;
+  GLuint framebuffer_color_buffer;
+
+  // Render targets currently being drawn into, innermost last
+  SubstRenderTarget *render_targets[SUBST_RENDER_TARGET_MAX_DEPTH];
+  uint32_t render_target_depth;
+
+  // Asynchronous framebuffer readback, created on first use
+  SubstCapture *capture;
+
+  // Frames left to save after each swap and the path to save them to
+  char *capture_path;
+  uint32_t capture_frame_count;
+  uint32_t capture_frame_index;
 } SubstRenderer;
 
 typedef enum {
@@ -29,7 +67,8 @@ typedef struct SubstDrawArgs {
   float scale_x, scale_y;
   float rotation;
   uint8_t flags;
-  GLuint shader_program;
+  float depth;
+  SubstShader *shader;
 } SubstDrawArgs;
 
 typedef struct {
@@ -39,7 +78,14 @@ typedef struct {
   float a;
 } SubstColor;
 
+typedef struct {
+  float x, y;
+  float width, height;
+  SubstColor color;
+} SubstRectInstance;
+
 int subst_renderer_init(void);
+SubstRenderer *subst_renderer_create(SubstWindow *window);
 void subst_renderer_end(void);
 
 void subst_renderer_loop_start(SubstRenderer *renderer, MescheRepl *repl);
@@ -55,14 +101,46 @@ void subst_renderer_draw_texture_ex(SubstRenderer *renderer,
                                     SubstTexture *texture, float x, float y,
                                     SubstDrawArgs *args);
 
+void subst_renderer_draw_texture_region_ex(SubstRenderer *renderer,
+                                           SubstTexture *texture, float x,
+                                           float y, float width, float height,
+                                           float texture_x, float texture_y,
+                                           SubstDrawArgs *args);
+
 void subst_renderer_draw_rect_fill(SubstRenderer *renderer, float x, float y,
                                    float w, float h, vec4 color);
+void subst_renderer_flush(SubstRenderer *renderer);
+
+void subst_renderer_camera_set(SubstRenderer *renderer, SubstCamera *camera);
+bool subst_renderer_box_visible(SubstRenderer *renderer, vec3 box[2]);
+float subst_renderer_pixel_scale(SubstRenderer *renderer);
+
+void subst_renderer_layer_set(SubstRenderer *renderer, uint8_t layer);
+void subst_renderer_layer_sorted_set(SubstRenderer *renderer, uint8_t layer,
+                                     bool is_sorted);
+
+void subst_renderer_render_target_begin(SubstRenderer *renderer,
+                                        SubstRenderTarget *target);
+void subst_renderer_render_target_end(SubstRenderer *renderer);
+
+// Returns NULL when there is nothing to draw or the instance buffer can't be
+// mapped, in which case there is nothing to end
+SubstRectInstance *subst_renderer_rect_instances_begin(SubstRenderer *renderer,
+                                                       uint32_t max_count);
+void subst_renderer_rect_instances_end(SubstRenderer *renderer,
+                                       uint32_t count);
 
 void subst_renderer_module_init(VM *vm);
 Value subst_renderer_create_msc(VM *vm, int arg_count, Value *args);
 Value subst_renderer_clear_msc(VM *vm, int arg_count, Value *args);
 Value subst_renderer_swap_buffers_msc(VM *vm, int arg_count, Value *args);
 
+void subst_renderer_save_to_png(SubstRenderer *renderer,
+                                const char *output_file_path);
+void subst_renderer_render_to_file(SubstRenderer *renderer,
+                                   const char *output_file_path,
+                                   uint32_t frame_count);
+
 Value subst_renderer_func_render_to_file(VM *vm, int arg_count, Value *args);
 Value subst_renderer_draw_texture_msc(VM *vm, int arg_count, Value *args);
 
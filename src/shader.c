@@ -1,3 +1,4 @@
+#include "render_state.h"
 #include "shader.h"
 #include "util.h"
 
@@ -22,31 +23,151 @@ const char *DefaultFragmentShaderText =
 
 const char *TexturedVertexShaderText = GLSL(
 #ifdef __EMSCRIPTEN__
-    in vec2 position; in vec2 tex_uv;
+    in vec2 position; in vec2 tex_uv; in vec4 tex_color;
 #else
     layout(location = 0) in vec2 position; layout(location = 1) in vec2 tex_uv;
+    layout(location = 2) in vec4 tex_color;
 #endif
 
     uniform mat4 model; uniform mat4 view; uniform mat4 projection;
 
-    out vec2 tex_coords;
+    out vec2 tex_coords; out vec4 vertex_color;
 
     void main() {
       tex_coords = tex_uv;
+      vertex_color = tex_color;
       gl_Position = projection * view * model * vec4(position, 0.0, 1.0);
     });
 
 const char *TexturedFragmentShaderText = GLSL(
-    precision highp float; in vec2 tex_coords;
+    precision highp float; in vec2 tex_coords; in vec4 vertex_color;
 
-    sampler2D tex0; vec4 color = vec4(1.0, 1.0, 1.0, 1.0); out vec4 out_color;
+    uniform sampler2D tex0; out vec4 out_color;
 
-    void main() { out_color = texture(tex0, tex_coords) * color; });
+    void main() { out_color = texture(tex0, tex_coords) * vertex_color; });
 
-GLuint subst_shader_compile(const SubstShaderFile *shader_files,
-                            uint32_t shader_count) {
+const char *InstancedRectVertexShaderText = GLSL(
+#ifdef __EMSCRIPTEN__
+    in vec2 a_vec; in vec4 instance_rect; in vec4 instance_color;
+#else
+    layout(location = 0) in vec2 a_vec;
+    layout(location = 1) in vec4 instance_rect;
+    layout(location = 2) in vec4 instance_color;
+#endif
+
+    uniform mat4 view; uniform mat4 projection;
+
+    out vec4 vertex_color;
+
+    void main() {
+      vertex_color = instance_color;
+      vec2 position = instance_rect.xy + a_vec * instance_rect.zw;
+      gl_Position = projection * view * vec4(position, 0.0, 1.0);
+    });
+
+const char *InstancedRectFragmentShaderText =
+    GLSL(precision highp float; in vec4 vertex_color; out vec4 out_color;
+         void main() { out_color = vertex_color; });
+
+// Advances particle state for transform feedback.  Slots from emit_offset
+// onward (wrapping around) are respawned with state derived from a hash of
+// their spawn index, every other slot just moves along its velocity.
+const char *GpuParticleUpdateVertexShaderText = GLSL(
+#ifdef __EMSCRIPTEN__
+    in vec4 state0; in vec4 state1;
+#else
+    layout(location = 0) in vec4 state0; layout(location = 1) in vec4 state1;
+#endif
+
+    out vec4 out_state0; out vec4 out_state1;
+
+    uniform float time_delta; uniform int slot_count; uniform int emit_offset;
+    uniform int emit_count; uniform uint spawn_index; uniform uint seed;
+    uniform float first_age; uniform float spawn_interval;
+    uniform vec2 origin; uniform float geometry; uniform vec2 size_range;
+    uniform vec2 lifetime_range; uniform vec2 vel_x_range;
+    uniform vec2 vel_y_range;
+
+    uint hash(uint x) {
+      uint state = x * 747796405u + 2891336453u;
+      uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+      return (word >> 22u) ^ word;
+    }
+
+    float random(uint index, uint field, vec2 range) {
+      uint bits = hash(index ^ hash(seed + field));
+      return mix(range.x, range.y, float(bits >> 8u) / 16777216.0);
+    }
+
+    void main() {
+      int spawn_slot = gl_VertexID - emit_offset;
+      if (spawn_slot < 0) {
+        spawn_slot += slot_count;
+      }
+
+      if (spawn_slot < emit_count) {
+        uint index = spawn_index + uint(spawn_slot);
+        float age = first_age - float(spawn_slot) * spawn_interval;
+        vec2 velocity = vec2(random(index, 2u, vel_x_range),
+                             random(index, 3u, vel_y_range));
+        vec2 offset = vec2(random(index, 0u, vec2(0.0, geometry)),
+                           random(index, 1u, vec2(0.0, geometry)));
+
+        out_state0 = vec4(origin + offset + velocity * age, velocity);
+        float lifetime = random(index, 5u, lifetime_range);
+        out_state1 = vec4(random(index, 4u, size_range), lifetime - age,
+                          lifetime, 0.0);
+      } else {
+        out_state0 = vec4(state0.xy + state0.zw * time_delta, state0.zw);
+        out_state1 = vec4(state1.x, state1.y - time_delta, state1.z, 0.0);
+      }
+    });
+
+// Transform feedback doesn't rasterize anything but ES still wants a
+// fragment stage in every program
+const char *GpuParticleUpdateFragmentShaderText =
+    GLSL(precision highp float; out vec4 out_color;
+         void main() { out_color = vec4(0.0); });
+
+const char *GpuParticleVertexShaderText = GLSL(
+#ifdef __EMSCRIPTEN__
+    in vec2 a_vec; in vec4 state0; in vec4 state1;
+#else
+    layout(location = 0) in vec2 a_vec; layout(location = 1) in vec4 state0;
+    layout(location = 2) in vec4 state1;
+#endif
+
+    // Over-lifetime curves, sized to match SUBST_PARTICLE_CURVE_SAMPLES
+    uniform mat4 view; uniform mat4 projection; uniform vec4 color_table[32];
+    uniform float size_table[32];
+
+    out vec4 vertex_color;
+
+    void main() {
+      float age = state1.z > 0.0 ? 1.0 - state1.y / state1.z : 0.0;
+      int curve_index = int(clamp(age, 0.0, 1.0) * 31.0 + 0.5);
+
+      // Dead particles collapse to a point so that they cover nothing
+      float size = state1.y > 0.0 ? state1.x * size_table[curve_index] : 0.0;
+      vertex_color = color_table[curve_index];
+      vec2 position = state0.xy + a_vec * size;
+      gl_Position = projection * view * vec4(position, 0.0, 1.0);
+    });
+
+static uint16_t subst_shader_next_id = 0;
+
+SubstShader *subst_shader_compile(const SubstShaderFile *shader_files,
+                                  uint32_t shader_count) {
+  return subst_shader_compile_feedback(shader_files, shader_count, NULL, 0);
+}
+
+SubstShader *subst_shader_compile_feedback(const SubstShaderFile *shader_files,
+                                           uint32_t shader_count,
+                                           const char **varyings,
+                                           uint32_t varying_count) {
   GLuint shader_id = 0;
   GLuint shader_program;
+  SubstShader *shader;
   shader_program = glCreateProgram();
 
   // Compile the shader files
@@ -66,10 +187,60 @@ GLuint subst_shader_compile(const SubstShaderFile *shader_files,
     glAttachShader(shader_program, shader_id);
   }
 
+  // Capture the requested outputs into buffers instead of rasterizing them
+  if (varying_count > 0) {
+    glTransformFeedbackVaryings(shader_program, varying_count, varyings,
+                                GL_INTERLEAVED_ATTRIBS);
+  }
+
   // Link the full program
   glLinkProgram(shader_program);
 
-  return shader_program;
+  // Look up the standard uniforms, any of which may be missing (-1)
+  shader = malloc(sizeof(SubstShader));
+  shader->program = shader_program;
+  shader->id = ++subst_shader_next_id;
+  shader->projection_location =
+      glGetUniformLocation(shader_program, "projection");
+  shader->view_location = glGetUniformLocation(shader_program, "view");
+  shader->model_location = glGetUniformLocation(shader_program, "model");
+  shader->color_location = glGetUniformLocation(shader_program, "color");
+  shader->tex0_location = glGetUniformLocation(shader_program, "tex0");
+  shader->matrix_version = 0;
+
+  // Set the uniforms that never change between draws
+  mat4 model;
+  vec4 color = {1.f, 1.f, 1.f, 1.f};
+  glm_mat4_identity(model);
+  subst_render_state_program_use(shader_program);
+  glUniformMatrix4fv(shader->model_location, 1, GL_FALSE, (float *)model);
+  glUniform4fv(shader->color_location, 1, (float *)color);
+  glUniform1i(shader->tex0_location, 0);
+
+  return shader;
+}
+
+void subst_shader_free(SubstShader *shader) {
+  if (shader != NULL) {
+    // Don't let the state cache hold on to a name that GL may reuse
+    subst_render_state_program_use(0);
+    glDeleteProgram(shader->program);
+    free(shader);
+  }
+}
+
+void subst_shader_matrices_apply(SubstShader *shader, mat4 projection,
+                                 mat4 view, uint32_t matrix_version) {
+  // The shader must already be in use.  Skip the upload if it already has
+  // the current matrices.
+  if (shader->matrix_version == matrix_version) {
+    return;
+  }
+
+  glUniformMatrix4fv(shader->projection_location, 1, GL_FALSE,
+                     (float *)projection);
+  glUniformMatrix4fv(shader->view_location, 1, GL_FALSE, (float *)view);
+  shader->matrix_version = matrix_version;
 }
 
 void subst_graphics_shader_mat4_set(unsigned int shader_program_id,
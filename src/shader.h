@@ -1,6 +1,7 @@
 #ifndef __subst_shader_h
 #define __subst_shader_h
 
+#include <cglm/cglm.h>
 #include <glad/glad.h>
 #include <inttypes.h>
 
@@ -8,14 +9,43 @@ extern const char *DefaultVertexShaderText;
 extern const char *DefaultFragmentShaderText;
 extern const char *TexturedVertexShaderText;
 extern const char *TexturedFragmentShaderText;
+extern const char *InstancedRectVertexShaderText;
+extern const char *InstancedRectFragmentShaderText;
+extern const char *GpuParticleUpdateVertexShaderText;
+extern const char *GpuParticleUpdateFragmentShaderText;
+extern const char *GpuParticleVertexShaderText;
 
 typedef struct {
   GLenum shader_type;
   const char *shader_text;
 } SubstShaderFile;
 
-GLuint subst_shader_compile(const SubstShaderFile *shader_files,
-                            uint32_t shader_count);
+typedef struct {
+  GLuint program;
+
+  // Small number that identifies the shader in render queue sort keys
+  uint16_t id;
+
+  // Uniform locations are resolved once when the shader is compiled
+  GLint projection_location;
+  GLint view_location;
+  GLint model_location;
+  GLint color_location;
+  GLint tex0_location;
+
+  // The renderer matrix version last uploaded to this shader
+  uint32_t matrix_version;
+} SubstShader;
+
+SubstShader *subst_shader_compile(const SubstShaderFile *shader_files,
+                                  uint32_t shader_count);
+SubstShader *subst_shader_compile_feedback(const SubstShaderFile *shader_files,
+                                           uint32_t shader_count,
+                                           const char **varyings,
+                                           uint32_t varying_count);
+void subst_shader_free(SubstShader *shader);
+void subst_shader_matrices_apply(SubstShader *shader, mat4 projection,
+                                 mat4 view, uint32_t matrix_version);
 
 #ifdef __EMSCRIPTEN__
 #define GLSL(src) "#version 300 es\n" #src
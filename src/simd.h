@@ -0,0 +1,256 @@
+#ifndef __subst_simd_h
+#define __subst_simd_h
+
+#include <cglm/simd/intrin.h>
+#include <math.h>
+#include <stdlib.h>
+
+// A thin wrapper over whichever float vector type cglm detected for the
+// target so that batch loops can be written once.  Arrays passed to
+// subst_simd_load and subst_simd_store must be SUBST_SIMD_ALIGN aligned and
+// padded to a multiple of SUBST_SIMD_WIDTH floats.
+#define SUBST_SIMD_ALIGN 32
+
+#if defined(CGLM_AVX_FP)
+
+#define SUBST_SIMD_WIDTH 8
+typedef __m256 SubstSimdFloat;
+typedef __m256 SubstSimdMask;
+
+static inline SubstSimdFloat subst_simd_load(const float *p) {
+  return _mm256_load_ps(p);
+}
+static inline void subst_simd_store(float *p, SubstSimdFloat v) {
+  _mm256_store_ps(p, v);
+}
+static inline SubstSimdFloat subst_simd_set1(float f) {
+  return _mm256_set1_ps(f);
+}
+static inline SubstSimdFloat subst_simd_add(SubstSimdFloat a,
+                                            SubstSimdFloat b) {
+  return _mm256_add_ps(a, b);
+}
+static inline SubstSimdFloat subst_simd_sub(SubstSimdFloat a,
+                                            SubstSimdFloat b) {
+  return _mm256_sub_ps(a, b);
+}
+static inline SubstSimdFloat subst_simd_mul(SubstSimdFloat a,
+                                            SubstSimdFloat b) {
+  return _mm256_mul_ps(a, b);
+}
+static inline SubstSimdFloat subst_simd_div(SubstSimdFloat a,
+                                            SubstSimdFloat b) {
+  return _mm256_div_ps(a, b);
+}
+static inline SubstSimdFloat subst_simd_sqrt(SubstSimdFloat a) {
+  return _mm256_sqrt_ps(a);
+}
+static inline SubstSimdFloat subst_simd_min(SubstSimdFloat a,
+                                            SubstSimdFloat b) {
+  return _mm256_min_ps(a, b);
+}
+static inline SubstSimdFloat subst_simd_max(SubstSimdFloat a,
+                                            SubstSimdFloat b) {
+  return _mm256_max_ps(a, b);
+}
+static inline SubstSimdMask subst_simd_less(SubstSimdFloat a,
+                                            SubstSimdFloat b) {
+  return _mm256_cmp_ps(a, b, _CMP_LT_OQ);
+}
+// Takes a where the mask is set and b everywhere else
+static inline SubstSimdFloat
+subst_simd_select(SubstSimdMask mask, SubstSimdFloat a, SubstSimdFloat b) {
+  return _mm256_blendv_ps(b, a, mask);
+}
+// Packs the mask into an int with one bit per lane
+static inline int subst_simd_mask_bits(SubstSimdMask mask) {
+  return _mm256_movemask_ps(mask);
+}
+
+#elif defined(CGLM_SSE_FP)
+
+#define SUBST_SIMD_WIDTH 4
+typedef __m128 SubstSimdFloat;
+typedef __m128 SubstSimdMask;
+
+static inline SubstSimdFloat subst_simd_load(const float *p) {
+  return _mm_load_ps(p);
+}
+static inline void subst_simd_store(float *p, SubstSimdFloat v) {
+  _mm_store_ps(p, v);
+}
+static inline SubstSimdFloat subst_simd_set1(float f) { return _mm_set1_ps(f); }
+static inline SubstSimdFloat subst_simd_add(SubstSimdFloat a,
+                                            SubstSimdFloat b) {
+  return _mm_add_ps(a, b);
+}
+static inline SubstSimdFloat subst_simd_sub(SubstSimdFloat a,
+                                            SubstSimdFloat b) {
+  return _mm_sub_ps(a, b);
+}
+static inline SubstSimdFloat subst_simd_mul(SubstSimdFloat a,
+                                            SubstSimdFloat b) {
+  return _mm_mul_ps(a, b);
+}
+static inline SubstSimdFloat subst_simd_div(SubstSimdFloat a,
+                                            SubstSimdFloat b) {
+  return _mm_div_ps(a, b);
+}
+static inline SubstSimdFloat subst_simd_sqrt(SubstSimdFloat a) {
+  return _mm_sqrt_ps(a);
+}
+static inline SubstSimdFloat subst_simd_min(SubstSimdFloat a,
+                                            SubstSimdFloat b) {
+  return _mm_min_ps(a, b);
+}
+static inline SubstSimdFloat subst_simd_max(SubstSimdFloat a,
+                                            SubstSimdFloat b) {
+  return _mm_max_ps(a, b);
+}
+static inline SubstSimdMask subst_simd_less(SubstSimdFloat a,
+                                            SubstSimdFloat b) {
+  return _mm_cmplt_ps(a, b);
+}
+// Takes a where the mask is set and b everywhere else
+static inline SubstSimdFloat
+subst_simd_select(SubstSimdMask mask, SubstSimdFloat a, SubstSimdFloat b) {
+  return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+// Packs the mask into an int with one bit per lane
+static inline int subst_simd_mask_bits(SubstSimdMask mask) {
+  return _mm_movemask_ps(mask);
+}
+
+#elif defined(CGLM_NEON_FP) && defined(__aarch64__)
+
+// 32-bit ARM lacks vector division and square root so it uses the scalar
+// fallback instead
+#define SUBST_SIMD_WIDTH 4
+typedef float32x4_t SubstSimdFloat;
+typedef uint32x4_t SubstSimdMask;
+
+static inline SubstSimdFloat subst_simd_load(const float *p) {
+  return vld1q_f32(p);
+}
+static inline void subst_simd_store(float *p, SubstSimdFloat v) {
+  vst1q_f32(p, v);
+}
+static inline SubstSimdFloat subst_simd_set1(float f) {
+  return vdupq_n_f32(f);
+}
+static inline SubstSimdFloat subst_simd_add(SubstSimdFloat a,
+                                            SubstSimdFloat b) {
+  return vaddq_f32(a, b);
+}
+static inline SubstSimdFloat subst_simd_sub(SubstSimdFloat a,
+                                            SubstSimdFloat b) {
+  return vsubq_f32(a, b);
+}
+static inline SubstSimdFloat subst_simd_mul(SubstSimdFloat a,
+                                            SubstSimdFloat b) {
+  return vmulq_f32(a, b);
+}
+static inline SubstSimdFloat subst_simd_div(SubstSimdFloat a,
+                                            SubstSimdFloat b) {
+  return vdivq_f32(a, b);
+}
+static inline SubstSimdFloat subst_simd_sqrt(SubstSimdFloat a) {
+  return vsqrtq_f32(a);
+}
+static inline SubstSimdFloat subst_simd_min(SubstSimdFloat a,
+                                            SubstSimdFloat b) {
+  return vminq_f32(a, b);
+}
+static inline SubstSimdFloat subst_simd_max(SubstSimdFloat a,
+                                            SubstSimdFloat b) {
+  return vmaxq_f32(a, b);
+}
+static inline SubstSimdMask subst_simd_less(SubstSimdFloat a,
+                                            SubstSimdFloat b) {
+  return vcltq_f32(a, b);
+}
+// Takes a where the mask is set and b everywhere else
+static inline SubstSimdFloat
+subst_simd_select(SubstSimdMask mask, SubstSimdFloat a, SubstSimdFloat b) {
+  return vbslq_f32(mask, a, b);
+}
+// Packs the mask into an int with one bit per lane
+static inline int subst_simd_mask_bits(SubstSimdMask mask) {
+  const int32x4_t shifts = {0, 1, 2, 3};
+  return vaddvq_u32(vshlq_u32(vshrq_n_u32(mask, 31), shifts));
+}
+
+#else
+
+// No vector unit, the compiler is left to do what it can with plain loops
+#define SUBST_SIMD_WIDTH 1
+typedef float SubstSimdFloat;
+typedef int SubstSimdMask;
+
+static inline SubstSimdFloat subst_simd_load(const float *p) { return *p; }
+static inline void subst_simd_store(float *p, SubstSimdFloat v) { *p = v; }
+static inline SubstSimdFloat subst_simd_set1(float f) { return f; }
+static inline SubstSimdFloat subst_simd_add(SubstSimdFloat a,
+                                            SubstSimdFloat b) {
+  return a + b;
+}
+static inline SubstSimdFloat subst_simd_sub(SubstSimdFloat a,
+                                            SubstSimdFloat b) {
+  return a - b;
+}
+static inline SubstSimdFloat subst_simd_mul(SubstSimdFloat a,
+                                            SubstSimdFloat b) {
+  return a * b;
+}
+static inline SubstSimdFloat subst_simd_div(SubstSimdFloat a,
+                                            SubstSimdFloat b) {
+  return a / b;
+}
+static inline SubstSimdFloat subst_simd_sqrt(SubstSimdFloat a) {
+  return sqrtf(a);
+}
+static inline SubstSimdFloat subst_simd_min(SubstSimdFloat a,
+                                            SubstSimdFloat b) {
+  return a < b ? a : b;
+}
+static inline SubstSimdFloat subst_simd_max(SubstSimdFloat a,
+                                            SubstSimdFloat b) {
+  return a > b ? a : b;
+}
+static inline SubstSimdMask subst_simd_less(SubstSimdFloat a,
+                                            SubstSimdFloat b) {
+  return a < b;
+}
+// Takes a where the mask is set and b everywhere else
+static inline SubstSimdFloat
+subst_simd_select(SubstSimdMask mask, SubstSimdFloat a, SubstSimdFloat b) {
+  return mask ? a : b;
+}
+// Packs the mask into an int with one bit per lane
+static inline int subst_simd_mask_bits(SubstSimdMask mask) { return mask; }
+
+#endif
+
+// Computes a * b + c
+static inline SubstSimdFloat subst_simd_madd(SubstSimdFloat a,
+                                             SubstSimdFloat b,
+                                             SubstSimdFloat c) {
+  return subst_simd_add(subst_simd_mul(a, b), c);
+}
+
+static inline SubstSimdFloat subst_simd_abs(SubstSimdFloat a) {
+  return subst_simd_max(a, subst_simd_sub(subst_simd_set1(0.f), a));
+}
+
+// Rounds a float count up so whole vectors can always be loaded
+static inline size_t subst_simd_padded_count(size_t count) {
+  size_t lanes = SUBST_SIMD_ALIGN / sizeof(float);
+  return (count + lanes - 1) / lanes * lanes;
+}
+
+static inline float *subst_simd_floats_alloc(size_t count) {
+  return aligned_alloc(SUBST_SIMD_ALIGN,
+                       subst_simd_padded_count(count) * sizeof(float));
+}
+
+#endif
@@ -8,20 +8,30 @@
 
 #include "file.h"
 #include "log.h"
+#include "render_state.h"
 #include "texture.h"
 
-SubstTexture *subst_texture_png_load(char *file_path,
-                                     SubstTextureOptions *options) {
+void subst_texture_init(SubstTexture *texture, uint32_t texture_id,
+                        uint32_t width, uint32_t height) {
+  texture->width = width;
+  texture->height = height;
+  texture->texture_id = texture_id;
+  texture->region_x = 0;
+  texture->region_y = 0;
+  texture->page_width = width;
+  texture->page_height = height;
+}
+
+unsigned char *subst_texture_png_decode(char *file_path, uint32_t *width,
+                                        uint32_t *height) {
   FILE *png;
   int ret = 0;
-  int fmt = SPNG_FMT_PNG;
-  unsigned int texture_id = 0;
+  int fmt = SPNG_FMT_RGBA8;
   spng_ctx *ctx = NULL;
   size_t image_data_size = 0;
   const size_t limit = 1024 * 1024 * 64;
   struct spng_ihdr header;
   unsigned char *image_bytes = NULL;
-  SubstTexture *texture = NULL;
 
   png = subst_file_open(file_path, "rb");
   ctx = spng_ctx_new(0);
@@ -53,14 +63,30 @@ SubstTexture *subst_texture_png_load(char *file_path,
   image_bytes = malloc(image_data_size);
 
   // Decode the image data
-  ret = spng_decode_image(ctx, image_bytes, image_data_size, SPNG_FMT_RGBA8, 0);
+  ret = spng_decode_image(ctx, image_bytes, image_data_size, fmt, 0);
   if (ret) {
     subst_log("Error decoding PNG file data: %s\n", spng_strerror(ret));
   }
 
+  *width = header.width;
+  *height = header.height;
+
+  // Free the SPNG context and close the file
+  spng_ctx_free(ctx);
+  fclose(png);
+
+  return image_bytes;
+}
+
+SubstTexture *subst_texture_create(const unsigned char *image_data,
+                                   uint32_t width, uint32_t height,
+                                   SubstTextureOptions *options) {
+  unsigned int texture_id = 0;
+  SubstTexture *texture = NULL;
+
   // Create the texture in video memory
   glGenTextures(1, &texture_id);
-  glBindTexture(GL_TEXTURE_2D, texture_id);
+  subst_render_state_texture_bind(0, texture_id);
   if (options && options->use_smoothing == false) {
     glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
                     GL_NEAREST); // GL_NEAREST = no smoothing
@@ -72,27 +98,36 @@ SubstTexture *subst_texture_png_load(char *file_path,
                     GL_LINEAR_MIPMAP_LINEAR);
   }
 
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, header.width, header.height, 0,
-               GL_RGBA, GL_UNSIGNED_BYTE, image_bytes);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA,
+               GL_UNSIGNED_BYTE, image_data);
 
   // TODO: Add options for smoothing and mipmaps here
   glGenerateTextureMipmap(texture_id);
 
   // Unbind the current texture to unblock future renders
-  glBindTexture(GL_TEXTURE_2D, 0);
+  subst_render_state_texture_bind(0, 0);
 
   // Allocate the actual SubstTexture
   texture = malloc(sizeof(SubstTexture));
-  texture->width = header.width;
-  texture->height = header.height;
-  texture->texture_id = texture_id;
+  subst_texture_init(texture, texture_id, width, height);
 
-  /* subst_log("The texture \"%s\" is %dx%d\n", file_path, header.width, */
-  /*           header.height); */
+  return texture;
+}
 
-  // Free the image data and SPNG context
+SubstTexture *subst_texture_png_load(char *file_path,
+                                     SubstTextureOptions *options) {
+  uint32_t width, height;
+  unsigned char *image_bytes = NULL;
+  SubstTexture *texture = NULL;
+
+  image_bytes = subst_texture_png_decode(file_path, &width, &height);
+  texture = subst_texture_create(image_bytes, width, height, options);
+
+  /* subst_log("The texture \"%s\" is %dx%d\n", file_path, width, */
+  /*           height); */
+
+  // Free the image data
   free(image_bytes);
-  spng_ctx_free(ctx);
 
   return texture;
 }
@@ -136,7 +171,7 @@ void subst_texture_png_save(const char *file_path,
     subst_log("Error encoding PNG data: %s\n", spng_strerror(ret));
   }
 
-  // TODO: Clean up context, etc
+  spng_ctx_free(ctx);
 
   fflush(out_file);
   fclose(out_file);
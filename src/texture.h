@@ -8,12 +8,26 @@ typedef struct {
   uint32_t width;
   uint32_t height;
   uint32_t texture_id;
+
+  // The area of the GL texture that this texture covers.  This is the whole
+  // GL texture unless the texture lives on an atlas page.
+  uint32_t region_x;
+  uint32_t region_y;
+  uint32_t page_width;
+  uint32_t page_height;
 } SubstTexture;
 
 typedef struct {
   bool use_smoothing;
 } SubstTextureOptions;
 
+void subst_texture_init(SubstTexture *texture, uint32_t texture_id,
+                        uint32_t width, uint32_t height);
+unsigned char *subst_texture_png_decode(char *file_path, uint32_t *width,
+                                        uint32_t *height);
+SubstTexture *subst_texture_create(const unsigned char *image_data,
+                                   uint32_t width, uint32_t height,
+                                   SubstTextureOptions *options);
 SubstTexture *subst_texture_png_load(char *file_path,
                                      SubstTextureOptions *options);
 void subst_texture_png_save(const char *file_path,
@@ -0,0 +1,144 @@
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "thread_pool.h"
+#include "util.h"
+
+#ifndef __EMSCRIPTEN__
+
+static void thread_pool_work(SubstThreadPool *pool) {
+  // Indices are handed out one at a time so uneven work still balances
+  int index;
+  while ((index = atomic_fetch_add(&pool->next_index, 1)) < pool->count) {
+    pool->func(pool->context, index);
+  }
+}
+
+static void *thread_pool_worker_main(void *data) {
+  SubstThreadPool *pool = (SubstThreadPool *)data;
+  uint32_t generation = 0;
+
+  pthread_mutex_lock(&pool->mutex);
+  while (true) {
+    while (pool->generation == generation && !pool->is_stopping) {
+      pthread_cond_wait(&pool->work_ready, &pool->mutex);
+    }
+
+    if (pool->is_stopping) {
+      break;
+    }
+
+    generation = pool->generation;
+    pthread_mutex_unlock(&pool->mutex);
+    thread_pool_work(pool);
+    pthread_mutex_lock(&pool->mutex);
+
+    pool->busy_workers--;
+    if (pool->busy_workers == 0) {
+      pthread_cond_signal(&pool->work_done);
+    }
+  }
+  pthread_mutex_unlock(&pool->mutex);
+
+  return NULL;
+}
+
+#endif
+
+SubstThreadPool *subst_thread_pool_create(int thread_count) {
+  SubstThreadPool *pool = malloc(sizeof(SubstThreadPool));
+  pool->thread_count = thread_count;
+
+#ifndef __EMSCRIPTEN__
+  pool->is_stopping = false;
+  pool->generation = 0;
+  pool->busy_workers = 0;
+  pool->count = 0;
+  atomic_init(&pool->next_index, 0);
+
+  pthread_mutex_init(&pool->mutex, NULL);
+  pthread_cond_init(&pool->work_ready, NULL);
+  pthread_cond_init(&pool->work_done, NULL);
+
+  pool->threads = malloc(sizeof(pthread_t) * thread_count);
+  for (int i = 0; i < thread_count; i++) {
+    if (pthread_create(&pool->threads[i], NULL, thread_pool_worker_main,
+                       pool) != 0) {
+      PANIC("Could not start thread pool worker!\n");
+    }
+  }
+#endif
+
+  return pool;
+}
+
+void subst_thread_pool_free(SubstThreadPool *pool) {
+#ifndef __EMSCRIPTEN__
+  pthread_mutex_lock(&pool->mutex);
+  pool->is_stopping = true;
+  pthread_cond_broadcast(&pool->work_ready);
+  pthread_mutex_unlock(&pool->mutex);
+
+  for (int i = 0; i < pool->thread_count; i++) {
+    pthread_join(pool->threads[i], NULL);
+  }
+
+  pthread_cond_destroy(&pool->work_done);
+  pthread_cond_destroy(&pool->work_ready);
+  pthread_mutex_destroy(&pool->mutex);
+  free(pool->threads);
+#endif
+
+  free(pool);
+}
+
+int subst_thread_pool_default_size(void) {
+#ifdef __EMSCRIPTEN__
+  return 0;
+#else
+  // Leave a core for the calling thread, which also takes part in each run
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  if (cores < 2) {
+    return 0;
+  }
+
+  return cores - 1 > 8 ? 8 : cores - 1;
+#endif
+}
+
+void subst_thread_pool_run(SubstThreadPool *pool, SubstThreadPoolFunc func,
+                           void *context, int count) {
+#ifdef __EMSCRIPTEN__
+  for (int i = 0; i < count; i++) {
+    func(context, i);
+  }
+#else
+  // Small runs aren't worth waking anyone up for
+  if (pool->thread_count == 0 || count < 2) {
+    for (int i = 0; i < count; i++) {
+      func(context, i);
+    }
+    return;
+  }
+
+  pthread_mutex_lock(&pool->mutex);
+  pool->func = func;
+  pool->context = context;
+  pool->count = count;
+  atomic_store(&pool->next_index, 0);
+  pool->busy_workers = pool->thread_count;
+  pool->generation++;
+  pthread_cond_broadcast(&pool->work_ready);
+  pthread_mutex_unlock(&pool->mutex);
+
+  // Help out instead of waiting idle
+  thread_pool_work(pool);
+
+  // Wait for the workers to finish their last items
+  pthread_mutex_lock(&pool->mutex);
+  while (pool->busy_workers > 0) {
+    pthread_cond_wait(&pool->work_done, &pool->mutex);
+  }
+  pthread_mutex_unlock(&pool->mutex);
+#endif
+}
@@ -0,0 +1,43 @@
+#ifndef __subst_thread_pool_h
+#define __subst_thread_pool_h
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#ifndef __EMSCRIPTEN__
+#include <pthread.h>
+#include <stdatomic.h>
+#endif
+
+// Called once for every index in [0, count) of a parallel run
+typedef void (*SubstThreadPoolFunc)(void *context, int index);
+
+typedef struct {
+  int thread_count;
+
+#ifndef __EMSCRIPTEN__
+  pthread_t *threads;
+  pthread_mutex_t mutex;
+  pthread_cond_t work_ready;
+  pthread_cond_t work_done;
+  bool is_stopping;
+
+  // The run currently in progress, workers notice a new one when the
+  // generation changes
+  uint32_t generation;
+  SubstThreadPoolFunc func;
+  void *context;
+  int count;
+  atomic_int next_index;
+  int busy_workers;
+#endif
+} SubstThreadPool;
+
+SubstThreadPool *subst_thread_pool_create(int thread_count);
+void subst_thread_pool_free(SubstThreadPool *pool);
+
+int subst_thread_pool_default_size(void);
+void subst_thread_pool_run(SubstThreadPool *pool, SubstThreadPoolFunc func,
+                           void *context, int count);
+
+#endif
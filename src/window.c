@@ -1,4 +1,5 @@
 #include <glad/glad.h>
+#include <stdbool.h>
 #include <stdlib.h>
 
 #include "log.h"
@@ -8,9 +9,22 @@ static void glfw_error_callback(int error, const char *description) {
   subst_log("GLFW error %d: %s\n", error, description);
 }
 
-SubstWindow *subst_window_create(int width, int height, const char *title) {
+SubstWindow *subst_window_create_ex(int width, int height, const char *title,
+                                    bool headless) {
   SubstWindow *window;
   GLFWwindow *glfwWindow;
+  bool use_osmesa = false;
+
+#if !defined(__EMSCRIPTEN__) && defined(GLFW_PLATFORM_NULL)
+  // Without a display server a headless window can still be created on
+  // GLFW's null platform, which renders with OSMesa entirely in software
+  if (headless && getenv("DISPLAY") == NULL &&
+      getenv("WAYLAND_DISPLAY") == NULL &&
+      glfwPlatformSupported(GLFW_PLATFORM_NULL)) {
+    glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+    use_osmesa = true;
+  }
+#endif
 
   if (!glfwInit()) {
     subst_log("GLFW failed to init!\n");
@@ -23,10 +37,18 @@ SubstWindow *subst_window_create(int width, int height, const char *title) {
   glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
   glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
 #else
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
-  /* glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE); */
-  /* glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_FALSE); */
+  if (use_osmesa) {
+    // Software renderers generally only expose newer versions via core
+    glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+  } else {
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
+    /* glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE); */
+    /* glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_FALSE); */
+  }
 #endif
 
 #ifdef __APPLE__
@@ -42,7 +64,7 @@ SubstWindow *subst_window_create(int width, int height, const char *title) {
   glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
 
   // Enable anti-aliasing
-  glfwWindowHint(GLFW_SAMPLES, 4);
+  glfwWindowHint(GLFW_SAMPLES, headless ? 0 : 4);
 
   // Make sure we're notified about errors
   glfwSetErrorCallback(glfw_error_callback);
@@ -57,12 +79,17 @@ SubstWindow *subst_window_create(int width, int height, const char *title) {
   window = malloc(sizeof(SubstWindow));
   window->glfwWindow = glfwWindow;
   window->width = width;
-  window->height = width;
+  window->height = height;
   window->is_resizing = false;
+  window->is_headless = headless;
 
   return window;
 }
 
+SubstWindow *subst_window_create(int width, int height, const char *title) {
+  return subst_window_create_ex(width, height, title, false);
+}
+
 void subst_window_size_set(SubstWindow *window, int width, int height) {
   window->is_resizing = true;
   glfwSetWindowSize(window->glfwWindow, width, height);
@@ -70,12 +97,15 @@ void subst_window_size_set(SubstWindow *window, int width, int height) {
 
 void subst_window_show(SubstWindow *window) {
   if (window && window->glfwWindow) {
-    glfwShowWindow(window->glfwWindow);
+    // Headless windows are never shown and shouldn't wait for vsync
+    if (!window->is_headless) {
+      glfwShowWindow(window->glfwWindow);
+    }
 
     // TODO: Is there a more appropriate place for these?
 
     // Set the swap interval to prevent tearing
-    glfwSwapInterval(1);
+    glfwSwapInterval(window->is_headless ? 0 : 1);
 
     // Enable blending
     glEnable(GL_BLEND);
@@ -116,6 +146,22 @@ Value subst_window_create_msc(VM *vm, int arg_count, Value *args) {
   return OBJECT_VAL(mesche_object_make_pointer(vm, window, true));
 }
 
+Value subst_window_create_headless_msc(VM *vm, int arg_count, Value *args) {
+  if (arg_count != 2) {
+    subst_log("Function requires 2 number parameters.");
+  }
+
+  int width = AS_NUMBER(args[0]);
+  int height = AS_NUMBER(args[1]);
+
+  // Create the window
+  SubstWindow *window =
+      subst_window_create_ex(width, height, "Substratic (headless)", true);
+  window->mesche_mem = (MescheMemory *)vm;
+
+  return OBJECT_VAL(mesche_object_make_pointer(vm, window, true));
+}
+
 Value subst_window_show_msc(VM *vm, int arg_count, Value *args) {
   ObjectPointer *ptr = AS_POINTER(args[0]);
   subst_window_show((SubstWindow *)ptr->ptr);
@@ -145,6 +191,7 @@ void subst_window_module_init(VM *vm) {
       vm, "substratic window",
       (MescheNativeFuncDetails[]){
           {"window-create", subst_window_create_msc, true},
+          {"window-create-headless", subst_window_create_headless_msc, true},
           {"window-show", subst_window_show_msc, true},
           {"window-width", subst_window_width_msc, true},
           {"window-height", subst_window_height_msc, true},
@@ -10,17 +10,21 @@
 typedef struct {
   int width, height;
   bool is_resizing;
+  bool is_headless;
   GLFWwindow *glfwWindow;
   MescheMemory *mesche_mem;
   SubstInputState *input_state;
 } SubstWindow;
 
 SubstWindow *subst_window_create(int width, int height, const char *title);
+SubstWindow *subst_window_create_ex(int width, int height, const char *title,
+                                    bool headless);
 void subst_window_show(SubstWindow *window);
 void subst_window_destroy(SubstWindow *window);
 
 void subst_window_module_init(VM *vm);
 Value subst_window_create_msc(VM *vm, int arg_count, Value *args);
+Value subst_window_create_headless_msc(VM *vm, int arg_count, Value *args);
 Value subst_window_show_msc(VM *vm, int arg_count, Value *args);
 Value subst_window_needs_close_p_msc(VM *vm, int arg_count, Value *args);
 